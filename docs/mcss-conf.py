@@ -19,6 +19,7 @@ LINKS_NAVBAR1 = [
             (
                 '<a href="example_display_values.html">Displaying Values to a Screen</a>',
             ),
+            ('<a href="example_low_power.html">Sleeping Between Readings</a>',),
         ],
     ),
     (
@@ -179,6 +179,8 @@ void setup() {
 
     // Start up the sensor
     sensor.begin(model, modbusAddress, &modbusSerial, DEREPin);
+    // Let the library calculate the gap between modbus frames from the baud rate
+    sensor.setBaudRate(9600);
 
     // Start the OLED
     // cspell:ignore SSD1306_SWITCHCAPVCC
@@ -235,7 +237,6 @@ void setup() {
         Serial.println();
         // Restart the sensor
         sensor.begin(model, modbusAddress, &modbusSerial, DEREPin);
-        delay(1500);
     };
 
     // Get the sensor serial number
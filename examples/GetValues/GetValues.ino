@@ -199,6 +199,8 @@ void setup() {
 
     // Start up the Yosemitech sensor
     sensor.begin(model, modbusAddress, &modbusSerial, DEREPin);
+    // Let the library calculate the gap between modbus frames from the baud rate
+    sensor.setBaudRate(modbusBaud);
 
 // Turn on debugging
 #ifdef YM_DEBUG
@@ -239,7 +241,6 @@ void setup() {
         Serial.println(prettyprintAddressHex(modbusAddress));
         // Restart the sensor with the discovered address
         sensor.begin(model, modbusAddress, &modbusSerial, DEREPin);
-        delay(1500);
     };
 
     // Get the sensor serial number
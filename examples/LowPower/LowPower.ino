@@ -0,0 +1,158 @@
+/** =========================================================================
+ * @example{lineno} LowPower.ino
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ * @copyright Stroud Water Research Center
+ * @license This example is published under the BSD-3 license.
+ *
+ * @brief This takes a reading from a sensor at a logging interval, sleeping the
+ * board through every wait, and reports how long the board was awake and asleep in
+ * each interval.
+ *
+ * The library waits through a yosemitechSleepClock, and so does the sketch: for
+ * the sensor to warm up, to stabilize, and for the next interval.
+ *
+ * @m_examplenavigation{example_low_power,}
+ * @m_footernavigation
+ * ======================================================================= */
+
+// ==========================================================================
+//  Include the libraries required for any data logger
+// ==========================================================================
+#include <Arduino.h>
+#include <YosemitechModbus.h>
+#include <YosemitechClock.h>
+
+#if defined(__AVR__)
+#include <avr/sleep.h>
+#endif
+
+
+// ==========================================================================
+//  Sensor Settings
+// ==========================================================================
+// Define the sensor type
+yosemitechModel model = Y511;  // The sensor model number
+
+// Define the sensor's modbus address, or SlaveID
+byte modbusAddress = 0x01;  // Yosemitech ships sensors with default ID 0x01
+
+// The Modbus baud rate the sensor uses
+int32_t modbusBaud = 9600;  // 9600 is the default baud rate for most sensors
+
+// Time in milliseconds after powering up for the slave device to respond
+#define WARM_UP_TIME 1500
+
+// Time in milliseconds for readings to stabilize, including a brush cycle
+#define STABILIZATION_TIME 22000
+
+// Time in milliseconds between the start of each reading
+#define LOGGING_INTERVAL 60000UL
+
+
+// ==========================================================================
+//  Data Logger Options
+// ==========================================================================
+const int32_t serialBaud = 115200;  // Baud rate for serial monitor
+
+// Define pin number variables
+const int sensorPwrPin  = 10;  // The pin sending power to the sensor
+const int adapterPwrPin = 22;  // The pin sending power to the RS485 adapter
+const int DEREPin       = -1;  // The pin controlling Receive Enable and Driver Enable
+                               // on the RS485 adapter, if applicable (else, -1)
+
+// Use the second hardware serial port for modbus; a byte arriving on it wakes the
+// board
+#define modbusSerial Serial1
+
+
+// ==========================================================================
+//  Sleeping
+// ==========================================================================
+// Puts the board to sleep until the next interrupt: a byte arriving, or the timer
+// behind millis(), which keeps running.  The library never asks for a sleep longer
+// than it needs, so this doesn't have to keep track of the time itself.
+void idleSleep(uint32_t) {
+#if defined(__AVR__)
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_mode();
+#elif defined(ARDUINO_ARCH_SAMD)
+    __WFI();
+#endif
+}
+
+// The clock the library and this sketch wait with
+yosemitechSleepClock sleepClock(idleSleep);
+
+// Construct the Yosemitech modbus instance
+yosemitech sensor;
+
+
+// ==========================================================================
+//  Arduino Setup Function
+// ==========================================================================
+void setup() {
+    // Set various pins as needed
+    if (DEREPin >= 0) { pinMode(DEREPin, OUTPUT); }
+    if (sensorPwrPin >= 0) {
+        pinMode(sensorPwrPin, OUTPUT);
+        digitalWrite(sensorPwrPin, HIGH);
+    }
+    if (adapterPwrPin >= 0) {
+        pinMode(adapterPwrPin, OUTPUT);
+        digitalWrite(adapterPwrPin, HIGH);
+    }
+
+    Serial.begin(serialBaud);
+    modbusSerial.begin(modbusBaud);
+
+    // Start up the Yosemitech sensor, waiting on the sleeping clock
+    sensor.begin(model, modbusAddress, &modbusSerial, DEREPin);
+    sensor.setBaudRate(modbusBaud);
+    sensor.setClock(sleepClock);
+
+    Serial.print(F("\nYosemitech "));
+    Serial.print(sensor.getModel());
+    Serial.print(F(" sensor for "));
+    Serial.println(sensor.getParameter());
+
+    // Allow the sensor and converter to warm up
+    sleepClock.delay(WARM_UP_TIME);
+
+    Serial.println(F("Time(ms)  Awake(ms)  Asleep(ms)  Values"));
+}
+
+
+// ==========================================================================
+//  Arduino Loop Function
+// ==========================================================================
+void loop() {
+    uint32_t start = sleepClock.millis();
+    sleepClock.startCycle();
+
+    // Take one reading
+    yosemitechReading reading;
+    sensor.startMeasurement();
+    sleepClock.delay(STABILIZATION_TIME);
+    bool success = sensor.getReading(reading);
+    sensor.stopMeasurement();
+
+    // Sleep through the rest of the interval
+    uint32_t elapsed = sleepClock.millis() - start;
+    if (elapsed < LOGGING_INTERVAL) sleepClock.delay(LOGGING_INTERVAL - elapsed);
+
+    // Report the reading and the time awake and asleep for the whole interval
+    Serial.print(reading.time);
+    Serial.print(F("  "));
+    Serial.print(sleepClock.getAwake());
+    Serial.print(F("  "));
+    Serial.print(sleepClock.getAsleep());
+    if (success) {
+        for (uint8_t i = 0; i < reading.numValues; i++) {
+            Serial.print(F("  "));
+            Serial.print(reading.values[i], 4);
+        }
+    } else {
+        Serial.print(F("  Failed to get a reading!"));
+    }
+    Serial.println();
+}
@@ -0,0 +1,219 @@
+/*****************************************************************************
+AdaptiveReplay.cpp
+
+A command line tool, for a Linux or macOS computer, that replays series of
+readings through a yosemitechAdaptiveSampler, to see how many transactions it
+would save over polling at a fixed interval before it goes out on a logger.
+
+Each series is a record of a value at least as often as the fastest polling
+interval, like readings a station logged.  The sampler keeps time with a
+yosemitechVirtualClock that follows the readings, and each time it is due it
+takes the reading of that moment, so it only sees the readings it would have
+polled.  With no files, it replays two made up days of turbidity from a Y511
+every 10 seconds: a baseline that only has sensor noise, and a storm, where the
+turbidity rises from 5 to about 300 NTU in half an hour and settles back over
+the next six.
+
+It prints, for each series, the polls a fixed rate at the fastest interval
+would take, the polls the sampler took and the transactions it saved, and the
+furthest the last polled value fell behind the series.
+
+Usage:
+    AdaptiveReplay [-m min] [-M max] [-r rate] [-v variance] [-c channel]
+                   [readings.csv ...]
+
+    -m min       the fastest polling interval, in seconds (10)
+    -M max       the slowest polling interval, in seconds (900)
+    -r rate      the rate of change of the value, in its units a second,
+                 that speeds polling up (0.05)
+    -v variance  the running variance of the value that speeds polling up, or
+                 0 to only use the rate of change (0)
+    -c channel   the value to watch, counting from 0 (0)
+
+The readings are a line each, with the time in milliseconds, the error code
+and each value, separated by commas, like DeadbandReplay reads; any line that
+doesn't start with a number, like a header, is skipped.
+See ReadMe.md for how to build this.
+*****************************************************************************/
+
+// ---------------------------------------------------------------------------
+// Include the base required libraries
+// ---------------------------------------------------------------------------
+// The standard library comes first, before Arduino.h can define min() and max()
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <Arduino.h>
+#include <YosemitechAdaptiveSampler.h>
+#include <YosemitechClock.h>
+#include <YosemitechModbus.h>
+
+// Makes up two days of turbidity every 10 s: sensor noise, and with a storm, a rise
+// to about 300 NTU in half an hour on the first afternoon that settles over six hours
+static void makeReadings(std::vector<yosemitechReading>& readings, bool storm) {
+    srand(1);
+    const double start = 14 * 3600.0;  // the storm starts at 2 pm
+    for (uint32_t time = 0; time < 2 * 86400000UL; time += 10000) {
+        double            seconds = time / 1000.0;
+        double            value   = 5 + (rand() % 5 - 2) * 0.05;
+        yosemitechReading reading;
+        memset(&reading, 0, sizeof(reading));
+        if (storm && seconds >= start) {
+            double since = seconds - start;
+            // A smooth rise to the peak, then an exponential fall back to the baseline
+            if (since < 1800) {
+                value += 295 * (1 - cos(since / 1800 * M_PI)) / 2;
+            } else {
+                value += 295 * exp(-(since - 1800) / 7200);
+            }
+        }
+        reading.time      = time;
+        reading.numValues = 2;
+        reading.values[0] = roundf(value * 100) / 100;
+        reading.values[1] = 15;  // the temperature the Y511 also gives
+        readings.push_back(reading);
+    }
+}
+
+// Reads a file of readings, a line each
+static bool readReadings(const char* path, std::vector<yosemitechReading>& readings) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return false;
+    }
+    char line[512];
+    int  lineNumber = 0;
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        lineNumber++;
+        if (!isdigit((unsigned char)line[0])) continue;
+        yosemitechReading reading;
+        memset(&reading, 0, sizeof(reading));
+        char* next        = line;
+        reading.time      = strtoul(next, &next, 10);
+        reading.errorCode = *next == ',' ? (byte)strtoul(next + 1, &next, 10) : 0;
+        while (*next == ',' && reading.numValues < YM_MAX_VALUES) {
+            char* end   = nullptr;
+            float value = strtof(next + 1, &end);
+            if (end == next + 1) break;
+            reading.values[reading.numValues++] = value;
+            next                                = end;
+        }
+        if (reading.numValues == 0) {
+            fprintf(stderr, "%s line %d has no values\n", path, lineNumber);
+            fclose(file);
+            return false;
+        }
+        readings.push_back(reading);
+    }
+    fclose(file);
+    if (readings.size() < 2) {
+        fprintf(stderr, "%s has too few readings to replay\n", path);
+        return false;
+    }
+    return true;
+}
+
+// Replays a series through a sampler, polling it whenever it is due, and prints a row
+static void replay(const char* name, const std::vector<yosemitechReading>& readings,
+                   uint32_t minInterval, uint32_t maxInterval, float rate,
+                   float variance, uint8_t channel) {
+    // The sampler never talks to the sensor; it only uses the sensor's clock
+    yosemitechVirtualClock clock((uint64_t)readings[0].time * 1000);
+    yosemitech             sensor;
+    sensor.setClock(clock);
+    yosemitechAdaptiveSampler sampler(sensor, minInterval, maxInterval);
+    sampler.setThresholds(rate, variance);
+    sampler.setChannel(channel);
+
+    // The furthest the last value polled fell behind the series
+    float  polled = 0;
+    double behind = 0;
+    for (size_t k = 0; k < readings.size(); k++) {
+        const yosemitechReading& reading = readings[k];
+        // A reading out of order is taken as happening at the same time as the last
+        uint64_t now = (uint64_t)reading.time * 1000;
+        if (now > clock.getTime()) clock.advance(now - clock.getTime());
+        if (sampler.due()) {
+            sampler.update(reading);
+            polled = reading.values[channel];
+        }
+        double gap = fabs(reading.values[channel] - polled);
+        if (gap > behind) behind = gap;
+    }
+
+    uint32_t fixedRate = sampler.getReadings() + sampler.getSaved();
+    double   hours     = (readings.back().time - readings[0].time) / 3600000.0;
+    printf("| %-16s | %7.1f | %10u | %10u | %8u | %6.1f%% | %11.2f |\n", name, hours,
+           fixedRate, sampler.getReadings(), sampler.getSaved(),
+           100.0 * sampler.getSaved() / fixedRate, behind);
+}
+
+static void usage(const char* name) {
+    fprintf(stderr,
+            "Usage: %s [-m min] [-M max] [-r rate] [-v variance] [-c channel]\n"
+            "                      [readings.csv ...]\n",
+            name);
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t minInterval = 10;
+    uint32_t maxInterval = 900;
+    float    rate        = 0.05f;
+    float    variance    = 0;
+    int      channel     = 0;
+    int      arg         = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (arg + 1 >= argc) break;
+        if (strcmp(argv[arg], "-m") == 0) {
+            minInterval = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-M") == 0) {
+            maxInterval = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-r") == 0) {
+            rate = atof(argv[++arg]);
+        } else if (strcmp(argv[arg], "-v") == 0) {
+            variance = atof(argv[++arg]);
+        } else if (strcmp(argv[arg], "-c") == 0) {
+            channel = atoi(argv[++arg]);
+        } else {
+            break;
+        }
+    }
+    if ((arg < argc && argv[arg][0] == '-') || minInterval == 0 ||
+        maxInterval < minInterval || channel < 0 || channel >= YM_MAX_VALUES) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    printf("Polling every %u to %u s, faster at a rate of change of %g a second",
+           minInterval, maxInterval, rate);
+    if (variance > 0) printf(" or a variance of %g", variance);
+    printf("\n\n");
+    printf("| %-16s | %7s | %10s | %10s | %8s | %7s | %11s |\n", "Series", "Hours",
+           "Fixed rate", "Adaptive", "Saved", "Share", "Most behind");
+    printf("| ---------------- | ------- | ---------- | ---------- | -------- "
+           "| ------- | ----------- |\n");
+    if (arg == argc) {
+        std::vector<yosemitechReading> baseline, storm;
+        makeReadings(baseline, false);
+        makeReadings(storm, true);
+        replay("baseline", baseline, minInterval * 1000, maxInterval * 1000, rate,
+               variance, channel);
+        replay("storm", storm, minInterval * 1000, maxInterval * 1000, rate, variance,
+               channel);
+        return 0;
+    }
+    for (; arg < argc; arg++) {
+        std::vector<yosemitechReading> readings;
+        if (!readReadings(argv[arg], readings)) return 2;
+        const char* name = strrchr(argv[arg], '/');
+        replay(name != nullptr ? name + 1 : argv[arg], readings, minInterval * 1000,
+               maxInterval * 1000, rate, variance, channel);
+    }
+    return 0;
+}
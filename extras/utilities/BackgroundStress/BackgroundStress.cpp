@@ -0,0 +1,189 @@
+/*****************************************************************************
+BackgroundStress.cpp
+
+A command line tool, for a Linux or macOS computer, that checks that the readers
+of a yosemitechBackground never get a torn reading while its poller writes.
+
+One thread publishes readings as fast as it can, as the polling context does,
+and several others read the latest one over and over with read(), getValue()
+and getTemperatureValue().  Every field of reading k is k, so a reader can tell
+when it has been handed half of one reading and half of another, and each
+reader checks that the readings it gets never go backwards.  For comparison it
+then does the same with a reading that is just copied in and out, with nothing
+to guard it, to show how often a reader catches it half written.
+
+Usage:
+    BackgroundStress [-n readings] [-t readers]
+
+    -n readings  how many readings to publish (2000000)
+    -t readers   how many reader threads (3)
+
+It exits with 1 if any reading from the yosemitechBackground was torn or out of
+order.  See ReadMe.md for how to build this.
+*****************************************************************************/
+
+// ---------------------------------------------------------------------------
+// Include the base required libraries
+// ---------------------------------------------------------------------------
+// The standard library comes first, before Arduino.h can define min() and max()
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <Arduino.h>
+#include <YosemitechBackground.h>
+
+typedef std::chrono::steady_clock benchClock;
+
+// The most readings there can be, before the values can't hold every count exactly
+#define STRESS_MAX_READINGS 16000000UL
+
+// What one reader saw
+struct readerCounts {
+    uint64_t reads;     // readings copied out
+    uint64_t torn;      // readings with fields from two different readings
+    uint64_t backward;  // readings older than the one before
+};
+
+// The unguarded latest reading, written and read with plain copies
+static yosemitechReading plainReading;
+
+// Fills in reading k, with k in every field
+static void makeReading(yosemitechReading& reading, uint32_t k) {
+    reading.time      = k;
+    reading.slaveID   = k & 0xFF;
+    reading.numValues = YM_MAX_VALUES;
+    reading.errorCode = 0;
+    for (uint8_t i = 0; i < YM_MAX_VALUES; i++) reading.values[i] = (float)k;
+}
+
+// Checks a reading is all of one reading, and counts it
+static void check(const yosemitechReading& reading, uint32_t& last,
+                  readerCounts& counts) {
+    counts.reads++;
+    uint32_t k    = reading.time;
+    bool     torn = reading.slaveID != (k & 0xFF) ||
+        reading.numValues != YM_MAX_VALUES;
+    for (uint8_t i = 0; i < YM_MAX_VALUES; i++) {
+        if (reading.values[i] != (float)k) torn = true;
+    }
+    if (torn) {
+        counts.torn++;
+        return;
+    }
+    if (k < last) counts.backward++;
+    last = k;
+}
+
+// Reads the latest reading over and over until the writer is done
+static void reader(yosemitechBackground* background, const std::atomic<bool>* done,
+                   readerCounts* counts) {
+    yosemitechReading reading;
+    uint32_t          last = 0;
+    uint32_t          turn = 0;
+    memset(counts, 0, sizeof(*counts));
+    while (!done->load(std::memory_order_acquire)) {
+        if (background != NULL) {
+            // Every fourth time, get the values one at a time instead
+            if (++turn % 4 == 0) {
+                float value       = background->getValue();
+                float temperature = background->getTemperatureValue();
+                counts->reads += 2;
+                // Both are whole numbers, or -9999 before the first reading
+                if (value != -9999 && value != floorf(value)) counts->torn++;
+                if (temperature != -9999 && temperature != floorf(temperature)) {
+                    counts->torn++;
+                }
+                continue;
+            }
+            if (!background->read(reading)) continue;
+        } else {
+            reading = plainReading;
+            if (reading.numValues == 0) continue;
+        }
+        check(reading, last, *counts);
+    }
+}
+
+// Publishes count readings while the readers read, and prints a row of what they saw
+static bool run(const char* name, yosemitechBackground* background, uint32_t count,
+                uint8_t readers) {
+    std::atomic<bool>         done(false);
+    std::vector<readerCounts> counts(readers);
+    std::vector<std::thread>  threads;
+    memset(&plainReading, 0, sizeof(plainReading));
+
+    benchClock::time_point start = benchClock::now();
+    for (uint8_t i = 0; i < readers; i++) {
+        threads.push_back(std::thread(reader, background, &done, &counts[i]));
+    }
+    yosemitechReading reading;
+    for (uint32_t k = 1; k <= count; k++) {
+        makeReading(reading, k);
+        if (background != NULL) {
+            background->publish(reading);
+        } else {
+            plainReading = reading;
+        }
+        // Let the readers in now and then, in case they share a core with this thread
+        if (k % 1000 == 0) std::this_thread::yield();
+    }
+    done.store(true, std::memory_order_release);
+    for (uint8_t i = 0; i < readers; i++) threads[i].join();
+    double seconds = std::chrono::duration<double>(benchClock::now() - start).count();
+
+    readerCounts total = {0, 0, 0};
+    for (uint8_t i = 0; i < readers; i++) {
+        total.reads += counts[i].reads;
+        total.torn += counts[i].torn;
+        total.backward += counts[i].backward;
+    }
+    printf("| %-20s | %8u | %7u | %12.2f | %12llu | %9llu | %8llu |\n", name, count,
+           readers, count / seconds / 1e6, (unsigned long long)total.reads,
+           (unsigned long long)total.torn, (unsigned long long)total.backward);
+    fflush(stdout);
+    return total.torn == 0 && total.backward == 0;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-n readings] [-t readers]\n", name);
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t count   = 2000000;
+    int      readers = 3;
+    int      arg     = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (arg + 1 >= argc) break;
+        if (strcmp(argv[arg], "-n") == 0) {
+            count = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-t") == 0) {
+            readers = atoi(argv[++arg]);
+        } else {
+            break;
+        }
+    }
+    if (arg != argc || count == 0 || count > STRESS_MAX_READINGS || readers < 1 ||
+        readers > 64) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // The sensor is never polled, only published to
+    yosemitech           sensor;
+    yosemitechBackground background(sensor);
+
+    printf("| %-20s | %8s | %7s | %12s | %12s | %9s | %8s |\n", "Latest reading",
+           "Written", "Readers", "M writes/s", "Reads", "Torn", "Backward");
+    printf("| -------------------- | -------- | ------- | ------------ | ------------ "
+           "| --------- | -------- |\n");
+    bool ok = run("yosemitechBackground", &background, count, readers);
+    run("plain copy", NULL, count, readers);
+    return ok ? 0 : 1;
+}
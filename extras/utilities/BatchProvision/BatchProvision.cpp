@@ -0,0 +1,277 @@
+/*****************************************************************************
+BatchProvision.cpp
+
+A command line tool, for a Linux or macOS computer, that commissions a batch of
+Yosemitech sensors from a manifest instead of one sketch upload per sensor.
+
+For every sensor in the manifest it can change the slave ID, set the brush
+interval and set the two-coefficient calibration, and then it reads back the
+serial number, versions and settings to confirm them.  Sensors on different
+serial ports are provisioned at the same time, one thread per port; sensors
+sharing a port (and so a bus) are done one after another.
+
+Usage:
+    BatchProvision manifest.csv [results.csv]
+
+See ReadMe.md for the manifest format and how to build this.
+*****************************************************************************/
+
+// ---------------------------------------------------------------------------
+// Include the base required libraries
+// ---------------------------------------------------------------------------
+// The standard library comes first, before Arduino.h can define min() and max()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Arduino.h>
+#include <YosemitechModbus.h>
+#include <YosemitechSerialStream.h>
+
+// ---------------------------------------------------------------------------
+// The manifest and results
+// ---------------------------------------------------------------------------
+
+// One line of the manifest; a setting of -1 means "leave it as it is"
+struct manifestEntry {
+    int         line;       // The line number in the manifest
+    std::string port;       // The serial port device
+    uint32_t    baud;       // The baud rate of the port
+    int         slaveID;    // The current slave ID of the sensor
+    int         newID;      // The slave ID to change to
+    long        brush;      // The brush interval to set, in minutes
+    bool        setCal;     // Whether to set the calibration
+    bool        halfCal;    // Whether only one of K and B was given
+    float       K;          // The calibration slope
+    float       B;          // The calibration offset
+};
+
+std::mutex logLock;     // Keeps lines from different ports from mixing
+FILE*      results;     // The per-sensor results file
+int        failures;    // The number of sensors that weren't provisioned
+
+// Prints a log line for a sensor
+static void logLine(const manifestEntry& entry, const char* message) {
+    std::lock_guard<std::mutex> lock(logLock);
+    printf("[%s 0x%02X] %s\n", entry.port.c_str(), entry.slaveID, message);
+    fflush(stdout);
+}
+
+// Parses one field of the manifest, returning false if it isn't a number; a field
+// that is empty or just "-" means "not set", and leaves set false
+static bool parseField(const char* field, double& value, bool& set) {
+    set = false;
+    if (field == nullptr) return true;
+    while (*field == ' ') field++;
+    size_t length = strlen(field);
+    while (length > 0 && field[length - 1] == ' ') length--;
+    if (length == 0 || (length == 1 && field[0] == '-')) return true;
+
+    char* end;
+    value = strtod(field, &end);
+    if (end != field + length) return false;
+    set = true;
+    return true;
+}
+
+// Reads the manifest, returning false if it can't be read
+//   port,baud,slaveID,newSlaveID,brushMinutes,K,B
+static bool readManifest(const char* path, std::vector<manifestEntry>& entries) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) return false;
+
+    char line[256];
+    int  lineNumber = 0;
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        lineNumber++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '#' || line[0] == '\0') continue;
+
+        // Split the line at the commas, keeping empty fields
+        char* fields[7] = {nullptr};
+        int   numFields = 0;
+        char* field     = line;
+        while (field != nullptr && numFields < 7) {
+            fields[numFields++] = field;
+            field               = strchr(field, ',');
+            if (field != nullptr) *field++ = '\0';
+        }
+        // Fields 1 to 6 are numbers: baud, slaveID, newSlaveID, brush, K and B
+        double values[7] = {0};
+        bool   set[7]    = {false};
+        int    bad       = 0;
+        for (int i = 1; i < 7 && bad == 0; i++) {
+            if (!parseField(fields[i], values[i], set[i])) bad = i + 1;
+        }
+        if (bad > 0) {
+            fprintf(stderr, "Manifest line %d: field %d isn't a number\n", lineNumber,
+                    bad);
+            continue;
+        }
+        if (numFields < 3 || !set[2]) {
+            fprintf(stderr, "Manifest line %d: need at least a port, baud and ID\n",
+                    lineNumber);
+            continue;
+        }
+
+        manifestEntry entry;
+        entry.line    = lineNumber;
+        entry.port    = fields[0];
+        entry.slaveID = (int)values[2];
+        entry.baud    = set[1] ? (uint32_t)values[1] : 9600;
+        entry.newID   = set[3] ? (int)values[3] : -1;
+        entry.brush   = set[4] ? (long)values[4] : -1;
+        entry.setCal  = set[5] && set[6];
+        entry.halfCal = set[5] != set[6];
+        entry.K       = entry.setCal ? (float)values[5] : 0;
+        entry.B       = entry.setCal ? (float)values[6] : 0;
+        entries.push_back(entry);
+    }
+    fclose(file);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Provisioning
+// ---------------------------------------------------------------------------
+
+// Provisions one sensor, returning true if everything asked for was done
+static bool provision(yosemitechSerialStream& port, const manifestEntry& entry) {
+    yosemitech sensor;
+    char       message[160];
+    bool       ok = true;
+
+    sensor.begin(UNKNOWN, entry.slaveID, port);
+    sensor.setBaudRate(entry.baud);
+    // Give each sensor at most 30 seconds, however badly it behaves
+    sensor.setDeadline(millis() + 30000UL);
+
+    String serial = sensor.getSerialNumber();
+    if (serial.length() == 0) {
+        logLine(entry, "no response");
+        return false;
+    }
+
+    int slaveID = entry.slaveID;
+    if (entry.newID >= 0 && entry.newID != slaveID) {
+        if (sensor.setSlaveID(entry.newID)) {
+            slaveID = entry.newID;
+            sensor.begin(UNKNOWN, slaveID, port);
+            sensor.setBaudRate(entry.baud);
+            sensor.setDeadline(millis() + 30000UL);
+            snprintf(message, sizeof(message), "slave ID changed to 0x%02X", slaveID);
+        } else {
+            ok = false;
+            snprintf(message, sizeof(message), "slave ID change failed (error 0x%02X)",
+                     sensor.getLastError());
+        }
+        logLine(entry, message);
+    }
+
+    if (entry.brush >= 0 && !sensor.setBrushInterval(entry.brush)) {
+        ok = false;
+        snprintf(message, sizeof(message),
+                 "setting brush interval failed (error 0x%02X)", sensor.getLastError());
+        logLine(entry, message);
+    }
+    if (entry.halfCal) {
+        ok = false;
+        logLine(entry, "calibration not set: K and B must both be given");
+    }
+    if (entry.setCal && !sensor.setCalibration(entry.K, entry.B)) {
+        ok = false;
+        snprintf(message, sizeof(message), "setting calibration failed (error 0x%02X)",
+                 sensor.getLastError());
+        logLine(entry, message);
+    }
+
+    // Read everything back
+    float    hardware = -9999, software = -9999;
+    float    K = -9999, B = -9999;
+    uint16_t brush = 0;
+    serial         = sensor.getSerialNumber();
+    if (!sensor.getVersion(hardware, software)) ok = false;
+    if (entry.brush >= 0) {
+        brush = sensor.getBrushInterval();
+        if (brush != entry.brush) ok = false;
+    }
+    if (entry.setCal) {
+        if (!sensor.getCalibration(K, B) || K != entry.K || B != entry.B) ok = false;
+    }
+
+    snprintf(message, sizeof(message), "%s %s, hardware %.2f, software %.2f: %s",
+             sensor.getModel().c_str(), serial.c_str(), hardware, software,
+             ok ? "done" : "FAILED");
+    logLine(entry, message);
+
+    std::lock_guard<std::mutex> lock(logLock);
+    if (results != nullptr) {
+        fprintf(results, "%d,%s,0x%02X,%s,%s,%.2f,%.2f,%u,%g,%g,%s\n", entry.line,
+                entry.port.c_str(), slaveID, sensor.getModel().c_str(), serial.c_str(),
+                hardware, software, brush, K, B, ok ? "ok" : "failed");
+        fflush(results);
+    }
+    return ok;
+}
+
+// Provisions every sensor on one port, in manifest order
+static void provisionPort(std::vector<manifestEntry> entries) {
+    yosemitechSerialStream port(entries.front().port.c_str());
+    uint32_t               baud = 0;
+    for (const manifestEntry& entry : entries) {
+        // Reopen the port if this sensor talks at a different rate
+        if (entry.baud != baud) {
+            if (!port.begin(entry.baud)) {
+                logLine(entry, "could not open the port");
+                std::lock_guard<std::mutex> lock(logLock);
+                failures++;
+                continue;
+            }
+            baud = entry.baud;
+        }
+        if (!provision(port, entry)) {
+            std::lock_guard<std::mutex> lock(logLock);
+            failures++;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Main function
+// ---------------------------------------------------------------------------
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s manifest.csv [results.csv]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<manifestEntry> entries;
+    if (!readManifest(argv[1], entries)) {
+        fprintf(stderr, "Could not read the manifest %s\n", argv[1]);
+        return 2;
+    }
+
+    results = argc > 2 ? fopen(argv[2], "w") : nullptr;
+    if (results != nullptr) {
+        fprintf(results, "line,port,slaveID,model,serialNumber,hardwareVersion,"
+                         "softwareVersion,brushInterval,K,B,result\n");
+    }
+
+    // One thread for each port
+    std::map<std::string, std::vector<manifestEntry>> byPort;
+    for (const manifestEntry& entry : entries) { byPort[entry.port].push_back(entry); }
+    std::vector<std::thread> threads;
+    for (auto& port : byPort) { threads.emplace_back(provisionPort, port.second); }
+    for (std::thread& thread : threads) { thread.join(); }
+
+    if (results != nullptr) fclose(results);
+    printf("%d of %d sensors provisioned\n", (int)entries.size() - failures,
+           (int)entries.size());
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+/*****************************************************************************
+BeginBenchmark.cpp
+
+A command line tool, for a Linux or macOS computer, that measures how long
+begin() takes to start sensors of UNKNOWN model, which have to be identified
+by their serial numbers, with and without an identity cache.  It starts the
+sensors at slave IDs 1 to N, the way a logger does after every reset, four
+ways:
+
+    no cache      every begin() reads and parses the serial number
+    cold cache    the cache file starts empty, so every begin() identifies the
+                  sensor and then saves what it found
+    warm cache    every begin() takes the model from the cache
+    warm, verify  every begin() checks the cached versions against the sensor
+
+For each it prints the mean and worst time of a begin(), the commands each
+sent on the bus, and how many of the sensors were identified.
+
+Usage:
+    BeginBenchmark [-n sensors] [-r rounds] [-b baud] [-f file] port
+
+    -n sensors  how many sensors, at slave IDs 1 up (16)
+    -r rounds   how many times to start every sensor each way (3)
+    -b baud     the baud rate of a serial port (9600)
+    -f file     the file to keep the cache in (BeginBenchmark.cache), which
+                is emptied first
+
+The port is a serial port device, or host:port for a serial device server.
+See ReadMe.md for how to build this.
+*****************************************************************************/
+
+// ---------------------------------------------------------------------------
+// Include the base required libraries
+// ---------------------------------------------------------------------------
+// The standard library comes first, before Arduino.h can define min() and max()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+#include <YosemitechIdentityCache.h>
+#include <YosemitechModbus.h>
+#include <YosemitechSerialStream.h>
+#include <YosemitechTCPStream.h>
+
+// The ways of starting the sensors
+enum startMode { noCache, coldCache, warmCache, warmVerify, modeCount };
+
+static const char* modeNames[] = {"no cache", "cold cache", "warm cache",
+                                  "warm, verify"};
+
+// Starts every sensor once, and adds up the time and commands it took
+static void startAll(Stream& bus, uint32_t baud, int count,
+                     yosemitechIdentityCache* cache, bool verify, uint32_t& time,
+                     uint32_t& worst, uint32_t& commands, int& identified) {
+    for (int i = 0; i < count; i++) {
+        yosemitech sensor;
+        sensor.setBaudRate(baud);
+        sensor.setIdentityCache(cache, verify);
+        uint32_t began = micros();
+        sensor.begin(UNKNOWN, i + 1, bus);
+        uint32_t took = micros() - began;
+        time += took;
+        if (took > worst) worst = took;
+        commands += sensor.getStats().transactions;
+        if (strcmp(sensor.getModel().c_str(), "Unknown") != 0) identified++;
+    }
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-n sensors] [-r rounds] [-b baud] [-f file] port\n",
+            name);
+}
+
+int main(int argc, char* argv[]) {
+    int         count  = 16;
+    int         rounds = 3;
+    uint32_t    baud   = 9600;
+    const char* path   = "BeginBenchmark.cache";
+    int         arg    = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (arg + 1 >= argc) break;
+        if (strcmp(argv[arg], "-n") == 0) {
+            count = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-r") == 0) {
+            rounds = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-b") == 0) {
+            baud = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-f") == 0) {
+            path = argv[++arg];
+        } else {
+            break;
+        }
+    }
+    if (argc - arg != 1 || count < 1 || count > 247 || rounds < 1 || baud == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    const char* port = argv[arg];
+
+    // A port with a colon in it is on a device server
+    Stream*                 bus    = nullptr;
+    yosemitechSerialStream* serial = nullptr;
+    yosemitechTCPStream*    tcp    = nullptr;
+    std::string             host(port);
+    size_t                  split = host.rfind(':');
+    if (split != std::string::npos) {
+        host.resize(split);
+        tcp = new yosemitechTCPStream(host.c_str(), atoi(port + split + 1));
+        if (!tcp->begin()) {
+            fprintf(stderr, "Could not connect to %s\n", port);
+            return 2;
+        }
+        bus = tcp;
+    } else {
+        serial = new yosemitechSerialStream(port);
+        if (!serial->begin(baud)) {
+            fprintf(stderr, "Could not open %s at %u baud\n", port, baud);
+            return 2;
+        }
+        bus = serial;
+    }
+
+    // A slot for every sensor, in a file emptied for the cold start
+    remove(path);
+    yosemitechFileStore store(path, count * yosemitechIdentityCache::recordSize);
+    yosemitechByteStoreCache<yosemitechFileStore> cache(store, 0, count);
+
+    printf("Starting %d sensors of UNKNOWN model at %u baud, %d rounds each way\n\n",
+           count, baud, rounds);
+    printf("| %-12s | %12s | %12s | %16s | %10s |\n", "Cache", "Mean ms", "Worst ms",
+           "Commands/begin", "Identified");
+    printf("| ------------ | ------------ | ------------ | ---------------- | "
+           "---------- |\n");
+    for (int mode = noCache; mode < modeCount; mode++) {
+        uint32_t time = 0, worst = 0, commands = 0;
+        int      identified = 0;
+        for (int r = 0; r < rounds; r++) {
+            // Empty the cache again, so every round of the cold start is cold
+            if (mode == coldCache && r > 0) {
+                for (int i = 0; i < count; i++) { cache.invalidate(i + 1); }
+            }
+            startAll(*bus, baud, count, mode == noCache ? nullptr : &cache,
+                     mode == warmVerify, time, worst, commands, identified);
+        }
+        int begins = count * rounds;
+        printf("| %-12s | %12.1f | %12.1f | %16.2f | %4d of %3d |\n", modeNames[mode],
+               time / 1000.0 / begins, worst / 1000.0, (double)commands / begins,
+               identified / rounds, count);
+        fflush(stdout);
+    }
+
+    delete serial;
+    delete tcp;
+    return 0;
+}
@@ -0,0 +1,287 @@
+/*****************************************************************************
+BusBenchmark.cpp
+
+A command line tool, for a Linux or macOS computer, that measures how many
+sensors one RS-485 bus can poll.  At each of a rising series of bus sizes it
+talks to sensors at slave IDs 1 to N, of the models taken in turn like the
+SensorSimulator's -n option, and runs whole poll cycles the way a station
+would: startMeasurement() on every sensor, then getReading(), then
+stopMeasurement().
+
+For each bus size it prints the mean time of a poll cycle, the readings per
+second it allows, how much of the cycle the bus was busy sending bytes, the
+share of sensors polled without a failure, the 50th, 90th and 99th percentile
+and worst time spent on one sensor in one cycle, and the commands sent a
+second.  With -p it pauses before every call, like the fixed delays sketches
+used to put between commands, to show what they cost.
+
+With -r it times raw reads of the version of the sensor at slave ID 1 instead,
+written straight to the port without the library, and prints the percentiles
+of their round trips, to compare the time the port itself takes, like a
+device server against a serial line.
+
+Usage:
+    BusBenchmark [-n sizes] [-c cycles] [-b baud] [-p pause] [-r requests] port
+
+    -n sizes     a comma separated list of the numbers of sensors on the bus,
+                 up to 247 (1,4,16,32,64,128,247)
+    -c cycles    how many poll cycles to run at each size (3)
+    -b baud      the baud rate of the bus (9600)
+    -p pause     a pause before every call, in milliseconds (0)
+    -r requests  how many raw reads to time instead of running poll cycles (0)
+
+The port is a serial port device, or host:port for a serial device server.
+See ReadMe.md for how to build this.
+*****************************************************************************/
+
+// ---------------------------------------------------------------------------
+// Include the base required libraries
+// ---------------------------------------------------------------------------
+// The standard library comes first, before Arduino.h can define min() and max()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+#include <YosemitechFrameParser.h>
+#include <YosemitechModbus.h>
+#include <YosemitechSerialStream.h>
+#include <YosemitechTCPStream.h>
+
+// The sensors take the models in turn, from Y502 to Y4000
+static const int modelCount = Y4000 + 1;
+
+// A Stream that counts the bytes going each way through it
+class countingStream : public Stream {
+ public:
+    explicit countingStream(Stream& stream) : _stream(stream) {}
+    size_t write(uint8_t value) override {
+        size_t sent = _stream.write(value);
+        written += sent;
+        return sent;
+    }
+    size_t write(const uint8_t* buffer, size_t size) override {
+        size_t sent = _stream.write(buffer, size);
+        written += sent;
+        return sent;
+    }
+    int available() override {
+        return _stream.available();
+    }
+    int read() override {
+        int value = _stream.read();
+        if (value >= 0) received++;
+        return value;
+    }
+    int peek() override {
+        return _stream.peek();
+    }
+    void flush() override {
+        _stream.flush();
+    }
+
+    uint32_t written  = 0;
+    uint32_t received = 0;
+
+ private:
+    Stream& _stream;
+};
+
+static yosemitech sensors[247];
+
+static void usage(const char* name) {
+    fprintf(stderr,
+            "Usage: %s [-n sizes] [-c cycles] [-b baud] [-p pause] [-r requests] "
+            "port\n",
+            name);
+}
+
+// Gets the value at a percentile of sorted times, in milliseconds
+static float percentile(const std::vector<uint32_t>& sorted, int percent) {
+    if (sorted.empty()) return 0;
+    size_t index = (sorted.size() - 1) * percent / 100;
+    return sorted[index] / 1000.0f;
+}
+
+// Times raw reads of the version (0x0700) of slave ID 1, a round trip each, and
+// prints their percentiles in microseconds
+static void roundTrips(Stream& bus, uint32_t requests) {
+    byte     request[8] = {0x01, 0x03, 0x07, 0x00, 0x00, 0x02, 0, 0};
+    uint16_t crc        = 0xFFFF;
+    for (int i = 0; i < 6; i++) crc = yosemitechFrameParser::crcUpdate(crc, request[i]);
+    request[6] = crc & 0xFF;
+    request[7] = crc >> 8;
+
+    byte                  response[16];
+    yosemitechFrameParser parser(response, sizeof(response));
+    std::vector<uint32_t> times;
+    uint32_t              failed = 0;
+    for (uint32_t r = 0; r < requests; r++) {
+        while (bus.available() > 0) bus.read();
+        parser.begin(0x01, 0x03, 9);
+        yosemitechFrameStatus status = YM_FRAME_INCOMPLETE;
+        uint32_t              began  = micros();
+        bus.write(request, sizeof(request));
+        bus.flush();
+        while (status == YM_FRAME_INCOMPLETE && micros() - began < 500000UL) {
+            if (bus.available() > 0) status = parser.add(bus.read());
+        }
+        uint32_t took = micros() - began;
+        if (status == YM_FRAME_COMPLETE) {
+            times.push_back(took);
+        } else {
+            failed++;
+        }
+    }
+    std::sort(times.begin(), times.end());
+    uint64_t total = 0;
+    for (uint32_t time : times) total += time;
+
+    printf("Timing %u raw reads of the version of slave ID 1\n\n", requests);
+    printf("requests  failed  mean us  p50 us  p90 us  p99 us  max us\n");
+    printf("%8u  %6u  %7.0f  %6.0f  %6.0f  %6.0f  %6.0f\n", requests, failed,
+           times.empty() ? 0.0 : (double)total / times.size(),
+           percentile(times, 50) * 1000, percentile(times, 90) * 1000,
+           percentile(times, 99) * 1000, percentile(times, 100) * 1000);
+}
+
+int main(int argc, char* argv[]) {
+    const char* sizes  = "1,4,16,32,64,128,247";
+    uint32_t    cycles = 3;
+    uint32_t    baud   = 9600;
+    uint32_t    pause    = 0;
+    uint32_t    requests = 0;
+    int         arg      = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (arg + 1 >= argc) break;
+        if (strcmp(argv[arg], "-n") == 0) {
+            sizes = argv[++arg];
+        } else if (strcmp(argv[arg], "-c") == 0) {
+            cycles = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-b") == 0) {
+            baud = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-p") == 0) {
+            pause = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-r") == 0) {
+            requests = atoi(argv[++arg]);
+        } else {
+            break;
+        }
+    }
+    if (argc - arg != 1 || cycles == 0 || baud == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    const char* port = argv[arg];
+
+    // A port with a colon in it is on a device server
+    Stream*                 bus    = nullptr;
+    yosemitechSerialStream* serial = nullptr;
+    yosemitechTCPStream*    tcp    = nullptr;
+    std::string             host(port);
+    size_t                  split = host.rfind(':');
+    if (split != std::string::npos) {
+        host.resize(split);
+        tcp = new yosemitechTCPStream(host.c_str(), atoi(port + split + 1));
+        if (!tcp->begin()) {
+            fprintf(stderr, "Could not connect to %s\n", port);
+            return 2;
+        }
+        bus = tcp;
+    } else {
+        serial = new yosemitechSerialStream(port);
+        if (!serial->begin(baud)) {
+            fprintf(stderr, "Could not open %s at %u baud\n", port, baud);
+            return 2;
+        }
+        bus = serial;
+    }
+
+    if (requests > 0) {
+        roundTrips(*bus, requests);
+        delete serial;
+        delete tcp;
+        return 0;
+    }
+
+    countingStream counted(*bus);
+    for (int i = 0; i < 247; i++) {
+        sensors[i].begin((yosemitechModel)(i % modelCount), i + 1, counted);
+        sensors[i].setBaudRate(baud);
+    }
+
+    printf("Polling up to %d models in turn at %u baud, %u cycles at each size, with "
+           "a %u ms pause before each call\n\n",
+           modelCount, baud, cycles, pause);
+    printf("sensors  cycle ms  readings/s  bus use    good   p50 ms   p90 ms   p99 ms  "
+           "max ms  commands/s\n");
+    for (const char* next = sizes; *next != '\0';) {
+        char* end   = nullptr;
+        long  count = strtol(next, &end, 0);
+        if (end == next) break;
+        next = *end == ',' ? end + 1 : end;
+        if (count < 1 || count > 247) {
+            fprintf(stderr, "Not a bus size: %ld\n", count);
+            continue;
+        }
+
+        // The time spent on each sensor in each cycle, and whether it all worked
+        std::vector<uint32_t> spent(count);
+        std::vector<uint32_t> latencies;
+        uint32_t              good      = 0;
+        uint32_t              cycleTime = 0;
+        uint32_t              bytes     = counted.written + counted.received;
+        uint32_t              commands  = 0;
+        for (long i = 0; i < count; i++) { sensors[i].resetStats(); }
+        for (uint32_t c = 0; c < cycles; c++) {
+            std::vector<bool> worked(count, true);
+            uint32_t          cycleStart = micros();
+            for (long i = 0; i < count; i++) {
+                uint32_t began = micros();
+                delay(pause);
+                if (!sensors[i].startMeasurement()) worked[i] = false;
+                spent[i] = micros() - began;
+            }
+            for (long i = 0; i < count; i++) {
+                yosemitechReading reading;
+                uint32_t          began = micros();
+                delay(pause);
+                if (!sensors[i].getReading(reading)) worked[i] = false;
+                spent[i] += micros() - began;
+            }
+            for (long i = 0; i < count; i++) {
+                uint32_t began = micros();
+                delay(pause);
+                if (!sensors[i].stopMeasurement()) worked[i] = false;
+                spent[i] += micros() - began;
+                latencies.push_back(spent[i]);
+                if (worked[i]) good++;
+            }
+            cycleTime += micros() - cycleStart;
+        }
+        bytes = counted.written + counted.received - bytes;
+        for (long i = 0; i < count; i++) {
+            commands += sensors[i].getStats().transactions;
+        }
+        std::sort(latencies.begin(), latencies.end());
+
+        // A byte is ten bits on the line: start, eight data bits and stop
+        float cycleMs  = cycleTime / 1000.0f / cycles;
+        float busShare = 100.0f * bytes * 10 / baud / (cycleTime / 1e6f);
+        printf("%7ld  %8.1f  %10.2f  %6.1f%%  %5.1f%%  %7.1f  %7.1f  %7.1f  %6.1f  "
+               "%10.1f\n",
+               count, cycleMs, cycleMs > 0 ? count * 1000.0f / cycleMs : 0, busShare,
+               100.0f * good / (count * cycles), percentile(latencies, 50),
+               percentile(latencies, 90), percentile(latencies, 99),
+               percentile(latencies, 100), commands / (cycleTime / 1e6f));
+        fflush(stdout);
+    }
+
+    delete serial;
+    delete tcp;
+    return 0;
+}
@@ -0,0 +1,287 @@
+/*****************************************************************************
+DeadbandReplay.cpp
+
+A command line tool, for a Linux or macOS computer, that replays a series of
+readings through a yosemitechDeadband, to see how many reports it would save
+with a given set of deadbands before they go out on a logger.
+
+It replays a file of readings a station logged, or takes readings from a sensor
+first and saves them to the file, or, with no file, a made up week of pH,
+temperature and potential readings from a Y532, once a minute, with a daily
+cycle and some sensor noise.  The readings are a line each, with the time in
+milliseconds, the error code and each value, separated by commas; any line
+that doesn't start with a number, like a header, is skipped.
+
+It prints, for each channel and in all, how many values it checked and how
+many it would report, and how many of the readings had anything to report.
+
+Usage:
+    DeadbandReplay [-h heartbeat] [-t channel:absolute[:relative]] [readings.csv]
+    DeadbandReplay -c count [-i interval] [-b baud] [-h heartbeat]
+                   [-t channel:absolute[:relative]] port slaveID:model
+                   readings.csv
+
+    -h heartbeat  the longest a channel goes unreported, in seconds, or 0 for
+                  never (3600)
+    -t channel:absolute[:relative]
+                  the deadband of a channel, counting from 0; can be given for
+                  each channel (0:0.05, 1:0.2 and 2:2, for the pH,
+                  temperature and potential of a Y532, and none on the others)
+    -c count      how many readings to take from the sensor first
+    -i interval   the time between them, in seconds (1)
+    -b baud       the baud rate of a serial port (9600)
+
+The port is a serial port device, or host:port for a serial device server.
+See ReadMe.md for how to build this.
+*****************************************************************************/
+
+// ---------------------------------------------------------------------------
+// Include the base required libraries
+// ---------------------------------------------------------------------------
+// The standard library comes first, before Arduino.h can define min() and max()
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+#include <YosemitechDeadband.h>
+#include <YosemitechModbus.h>
+#include <YosemitechSerialStream.h>
+#include <YosemitechTCPStream.h>
+
+// The names of the models, in the order of yosemitechModel
+static const char* modelNames[] = {"Y502", "Y504", "Y510", "Y511",  "Y513", "Y514",
+                                   "Y516", "Y520", "Y521", "Y532",  "Y533", "Y550",
+                                   "Y551", "Y560", "Y700", "Y4000", nullptr};
+
+// Makes up a week of Y532 readings once a minute: pH, temperature and potential
+static void makeReadings(std::vector<yosemitechReading>& readings) {
+    srand(1);
+    for (uint32_t time = 0; time < 7 * 86400000UL; time += 60000) {
+        double            hour = time / 3600000.0;
+        yosemitechReading reading;
+        memset(&reading, 0, sizeof(reading));
+        reading.time      = time;
+        reading.numValues = 3;
+        reading.values[0] = 7.2 + 0.15 * sin(hour * 2 * M_PI / 24) +
+            (rand() % 5 - 2) * 0.01;
+        reading.values[1] = 15 + 3 * sin(hour * 2 * M_PI / 24) +
+            (rand() % 5 - 2) * 0.02;
+        reading.values[2] = 250 + (rand() % 5 - 2) * 0.3;
+        readings.push_back(reading);
+    }
+}
+
+// Reads a file of readings, a line each
+static bool readReadings(const char* path, std::vector<yosemitechReading>& readings) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return false;
+    }
+    char line[512];
+    int  lineNumber = 0;
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        lineNumber++;
+        if (!isdigit((unsigned char)line[0])) continue;
+        yosemitechReading reading;
+        memset(&reading, 0, sizeof(reading));
+        char* next        = line;
+        reading.time      = strtoul(next, &next, 10);
+        reading.errorCode = *next == ',' ? (byte)strtoul(next + 1, &next, 10) : 0;
+        while (*next == ',' && reading.numValues < YM_MAX_VALUES) {
+            char* end   = nullptr;
+            float value = strtof(next + 1, &end);
+            if (end == next + 1) break;
+            reading.values[reading.numValues++] = value;
+            next                                = end;
+        }
+        if (reading.numValues == 0) {
+            fprintf(stderr, "%s line %d has no values\n", path, lineNumber);
+            fclose(file);
+            return false;
+        }
+        readings.push_back(reading);
+    }
+    fclose(file);
+    return true;
+}
+
+// Takes readings from a sensor and saves them to a file, a line each
+static bool takeReadings(yosemitech& sensor, uint32_t count, uint32_t interval,
+                         const char* path, std::vector<yosemitechReading>& readings) {
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        fprintf(stderr, "Could not create %s\n", path);
+        return false;
+    }
+    fprintf(file, "time,error,values\n");
+    sensor.startMeasurement();
+    for (uint32_t k = 0; k < count; k++) {
+        uint32_t          start = millis();
+        yosemitechReading reading;
+        if (sensor.getReading(reading)) {
+            fprintf(file, "%lu,%u", (unsigned long)reading.time, reading.errorCode);
+            for (uint8_t i = 0; i < reading.numValues; i++) {
+                fprintf(file, ",%.9g", reading.values[i]);
+            }
+            fprintf(file, "\n");
+            readings.push_back(reading);
+        } else {
+            fprintf(stderr, "Reading %u failed\n", k + 1);
+        }
+        while (k + 1 < count && millis() - start < interval * 1000) delay(10);
+    }
+    fclose(file);
+    return true;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr,
+            "Usage: %s [-h heartbeat] [-t channel:absolute[:relative]] "
+            "[readings.csv]\n"
+            "       %s -c count [-i interval] [-b baud] [-h heartbeat]\n"
+            "                  [-t channel:absolute[:relative]] port slaveID:model "
+            "readings.csv\n",
+            name, name);
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t heartbeat = 3600;
+    uint32_t count     = 0;
+    uint32_t interval  = 1;
+    uint32_t baud      = 9600;
+    float    absolute[YM_MAX_VALUES] = {0.05f, 0.2f, 2.0f, 0, 0, 0, 0, 0};
+    float    relative[YM_MAX_VALUES] = {0, 0, 0, 0, 0, 0, 0, 0};
+    int      arg                     = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (arg + 1 >= argc) break;
+        if (strcmp(argv[arg], "-h") == 0) {
+            heartbeat = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-t") == 0) {
+            char* next    = argv[++arg];
+            long  channel = strtol(next, &next, 10);
+            if (*next != ':' || channel < 0 || channel >= YM_MAX_VALUES) {
+                fprintf(stderr, "Not a deadband: %s\n", argv[arg]);
+                return 2;
+            }
+            absolute[channel] = strtof(next + 1, &next);
+            relative[channel] = *next == ':' ? strtof(next + 1, &next) : 0;
+        } else if (strcmp(argv[arg], "-c") == 0) {
+            count = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-i") == 0) {
+            interval = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-b") == 0) {
+            baud = atoi(argv[++arg]);
+        } else {
+            break;
+        }
+    }
+    if ((count == 0 && argc - arg > 1) || (count > 0 && argc - arg != 3)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<yosemitechReading> readings;
+    const char*                    source = "a made up week of Y532 readings";
+    if (count > 0) {
+        const char* port    = argv[arg++];
+        const char* colon   = strchr(argv[arg], ':');
+        int         slaveID = (int)strtol(argv[arg], nullptr, 0);
+        int         model   = -1;
+        for (int m = 0; colon != nullptr && modelNames[m] != nullptr; m++) {
+            if (strcmp(colon + 1, modelNames[m]) == 0) model = m;
+        }
+        if (model < 0 || slaveID < 1 || slaveID > 247) {
+            fprintf(stderr, "Not a sensor: %s\n", argv[arg]);
+            usage(argv[0]);
+            return 2;
+        }
+        arg++;
+
+        // A port with a colon in it is on a device server
+        Stream*     bus = nullptr;
+        std::string host(port);
+        size_t      split = host.rfind(':');
+        if (split != std::string::npos) {
+            host.resize(split);
+            yosemitechTCPStream* tcp = new yosemitechTCPStream(host.c_str(),
+                                                               atoi(port + split + 1));
+            if (!tcp->begin()) {
+                fprintf(stderr, "Could not connect to %s\n", port);
+                return 2;
+            }
+            bus = tcp;
+        } else {
+            yosemitechSerialStream* serial = new yosemitechSerialStream(port);
+            if (!serial->begin(baud)) {
+                fprintf(stderr, "Could not open %s at %u baud\n", port, baud);
+                return 2;
+            }
+            bus = serial;
+        }
+        yosemitech sensor;
+        sensor.begin((yosemitechModel)model, slaveID, *bus);
+        sensor.setBaudRate(baud);
+        fprintf(stderr, "Taking %u readings, %u s apart, into %s\n", count, interval,
+                argv[arg]);
+        if (!takeReadings(sensor, count, interval, argv[arg], readings)) return 2;
+        source = argv[arg];
+    } else if (arg < argc) {
+        if (!readReadings(argv[arg], readings)) return 2;
+        source = argv[arg];
+    } else {
+        makeReadings(readings);
+    }
+    if (readings.empty()) {
+        fprintf(stderr, "There are no readings to replay\n");
+        return 2;
+    }
+
+    yosemitechDeadband deadband(heartbeat * 1000);
+    for (uint8_t i = 0; i < YM_MAX_VALUES; i++) {
+        deadband.setThreshold(i, absolute[i], relative[i]);
+    }
+    uint32_t checked[YM_MAX_VALUES]  = {0};
+    uint32_t reported[YM_MAX_VALUES] = {0};
+    uint32_t sent                    = 0;
+    uint8_t  channels                = 0;
+    for (size_t k = 0; k < readings.size(); k++) {
+        const yosemitechReading& reading = readings[k];
+        uint8_t                  changed = deadband.filter(reading);
+        if (changed != 0) sent++;
+        for (uint8_t i = 0; i < reading.numValues; i++) {
+            checked[i]++;
+            if (changed & (1 << i)) reported[i]++;
+        }
+        if (reading.numValues > channels) channels = reading.numValues;
+    }
+
+    printf("%zu readings from %s, with a heartbeat of %u s\n\n", readings.size(),
+           source, heartbeat);
+    printf("| Channel | Deadband      | Values | Reported | Share  |\n");
+    printf("| ------- | ------------- | ------ | -------- | ------ |\n");
+    for (uint8_t i = 0; i < channels; i++) {
+        char band[32];
+        if (relative[i] > 0 && absolute[i] > 0) {
+            snprintf(band, sizeof(band), "%g or %g%%", absolute[i], relative[i] * 100);
+        } else if (relative[i] > 0) {
+            snprintf(band, sizeof(band), "%g%%", relative[i] * 100);
+        } else {
+            snprintf(band, sizeof(band), "%g", absolute[i]);
+        }
+        printf("| %7u | %-13s | %6u | %8u | %5.1f%% |\n", i, band, checked[i],
+               reported[i], 100.0 * reported[i] / checked[i]);
+    }
+    printf("| all     |               | %6lu | %8lu | %5.1f%% |\n",
+           (unsigned long)deadband.getChecked(), (unsigned long)deadband.getReported(),
+           100.0 * deadband.getReported() / deadband.getChecked());
+    printf("\n%u of the %zu readings had a value to report (%.1f%%)\n", sent,
+           readings.size(), 100.0 * sent / readings.size());
+    return 0;
+}
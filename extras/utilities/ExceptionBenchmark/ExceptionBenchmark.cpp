@@ -0,0 +1,241 @@
+/*****************************************************************************
+ExceptionBenchmark.cpp
+
+A command line tool, for a Linux or macOS computer, that measures the bus time
+wasted probing registers a sensor doesn't have.  Over and over, it asks the
+sensor for the pH calibration point and status (0x2300 and 0x0E00) and sets
+the cap coefficients of a dissolved oxygen sensor (0x2700), which a sensor of
+any other model refuses with an exception.  A Y511 is a good choice.
+
+It does this three ways, with a filter between the library and the sensor
+that changes only the exception responses:
+
+    exception     they are passed on as they are, so the library stops at
+                  each one straight away
+    bad reply     their CRC is broken, so the library can't tell them from a
+                  garbled reply and retries them, like it used to
+    no answer     they are dropped, like a sensor that doesn't answer for a
+                  register it doesn't have, so every try waits for a timeout
+
+For each it prints the mean time of a call, the commands sent for each, and
+the exceptions and time on them that getStats() counted.
+
+Usage:
+    ExceptionBenchmark [-n rounds] [-b baud] port slaveID:model
+
+    -n rounds  how many times to make each call each way (10)
+    -b baud    the baud rate of a serial port (9600)
+
+The port is a serial port device, or host:port for a serial device server.
+See ReadMe.md for how to build this.
+*****************************************************************************/
+
+// ---------------------------------------------------------------------------
+// Include the base required libraries
+// ---------------------------------------------------------------------------
+// The standard library comes first, before Arduino.h can define min() and max()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <deque>
+#include <string>
+
+#include <Arduino.h>
+#include <YosemitechModbus.h>
+#include <YosemitechSerialStream.h>
+#include <YosemitechTCPStream.h>
+
+// The names of the models, in the order of yosemitechModel
+static const char* modelNames[] = {"Y502", "Y504", "Y510", "Y511",  "Y513", "Y514",
+                                   "Y516", "Y520", "Y521", "Y532",  "Y533", "Y550",
+                                   "Y551", "Y560", "Y700", "Y4000", nullptr};
+
+// What the filter does to exception responses
+enum exceptionMode { passException, breakException, dropException, modeCount };
+
+static const char* modeNames[] = {"exception", "bad reply", "no answer"};
+
+// A Stream wrapped around the bus, which changes the exception responses and passes
+// everything else through.  The first write after reading starts a new response, and
+// its first byte is held back until the second shows whether it is an exception.
+class exceptionFilter : public Stream {
+ public:
+    explicit exceptionFilter(Stream& stream) : _stream(stream) {}
+
+    void setMode(exceptionMode mode) {
+        _mode = mode;
+    }
+
+    size_t write(uint8_t value) override {
+        startRequest();
+        return _stream.write(value);
+    }
+    size_t write(const uint8_t* buffer, size_t size) override {
+        startRequest();
+        return _stream.write(buffer, size);
+    }
+    int available() override {
+        receive();
+        return (int)_ready.size();
+    }
+    int read() override {
+        receive();
+        _writing = false;
+        if (_ready.empty()) return -1;
+        int value = _ready.front();
+        _ready.pop_front();
+        return value;
+    }
+    int peek() override {
+        receive();
+        return _ready.empty() ? -1 : _ready.front();
+    }
+    void flush() override {
+        _stream.flush();
+    }
+
+ private:
+    void startRequest(void) {
+        if (_writing) return;
+        _writing   = true;
+        _index     = 0;
+        _exception = false;
+    }
+
+    // Reads what has arrived, and changes it if it is an exception response
+    void receive(void) {
+        while (_stream.available() > 0) {
+            uint8_t value = _stream.read();
+            if (_index < 2) {
+                _held[_index++] = value;
+                if (_index < 2) continue;
+                _exception = (_held[1] & 0x80) != 0;
+                if (_exception && _mode == dropException) continue;
+                _ready.push_back(_held[0]);
+                _ready.push_back(_held[1]);
+                continue;
+            }
+            _index++;
+            if (_exception && _mode == dropException) continue;
+            // The last byte of an exception response is the high byte of its CRC
+            if (_exception && _mode == breakException && _index == 5) value ^= 0xFF;
+            _ready.push_back(value);
+        }
+    }
+
+    Stream&             _stream;
+    exceptionMode       _mode      = passException;
+    bool                _writing   = false;
+    bool                _exception = false;
+    uint16_t            _index     = 0;
+    uint8_t             _held[2]   = {0, 0};
+    std::deque<uint8_t> _ready;
+};
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-n rounds] [-b baud] port slaveID:model\n", name);
+}
+
+int main(int argc, char* argv[]) {
+    int      rounds = 10;
+    uint32_t baud   = 9600;
+    int      arg    = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (arg + 1 >= argc) break;
+        if (strcmp(argv[arg], "-n") == 0) {
+            rounds = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-b") == 0) {
+            baud = atoi(argv[++arg]);
+        } else {
+            break;
+        }
+    }
+    if (argc - arg != 2 || rounds < 1 || baud == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    const char* port = argv[arg++];
+
+    const char* colon   = strchr(argv[arg], ':');
+    int         slaveID = (int)strtol(argv[arg], nullptr, 0);
+    int         model   = -1;
+    for (int m = 0; colon != nullptr && modelNames[m] != nullptr; m++) {
+        if (strcmp(colon + 1, modelNames[m]) == 0) model = m;
+    }
+    if (model < 0 || slaveID < 1 || slaveID > 247) {
+        fprintf(stderr, "Not a sensor: %s\n", argv[arg]);
+        usage(argv[0]);
+        return 2;
+    }
+
+    // A port with a colon in it is on a device server
+    Stream*                 bus    = nullptr;
+    yosemitechSerialStream* serial = nullptr;
+    yosemitechTCPStream*    tcp    = nullptr;
+    std::string             host(port);
+    size_t                  split = host.rfind(':');
+    if (split != std::string::npos) {
+        host.resize(split);
+        tcp = new yosemitechTCPStream(host.c_str(), atoi(port + split + 1));
+        if (!tcp->begin()) {
+            fprintf(stderr, "Could not connect to %s\n", port);
+            return 2;
+        }
+        bus = tcp;
+    } else {
+        serial = new yosemitechSerialStream(port);
+        if (!serial->begin(baud)) {
+            fprintf(stderr, "Could not open %s at %u baud\n", port, baud);
+            return 2;
+        }
+        bus = serial;
+    }
+
+    exceptionFilter filter(*bus);
+    yosemitech      sensor;
+    sensor.begin((yosemitechModel)model, slaveID, filter);
+    sensor.setBaudRate(baud);
+
+    printf("Probing registers 0x%02X:%s doesn't have, %d times each way\n\n", slaveID,
+           modelNames[model], rounds * 3);
+    printf("| %-10s | %7s | %6s | %9s | %13s | %10s | %17s |\n", "Responses", "Calls",
+           "Worked", "Mean ms", "Commands/call", "Exceptions", "Exception time ms");
+    printf("| ---------- | ------- | ------ | --------- | ------------- | ---------- "
+           "| ----------------- |\n");
+    float K[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    for (int mode = passException; mode < modeCount; mode++) {
+        filter.setMode((exceptionMode)mode);
+        sensor.resetStats();
+        uint32_t calls  = 0;
+        uint32_t worked = 0;
+        uint32_t time   = 0;
+        for (int r = 0; r < rounds; r++) {
+            for (int call = 0; call < 3; call++) {
+                uint32_t began = micros();
+                bool     ok    = false;
+                switch (call) {
+                    case 0: ok = sensor.pHCalibrationPoint(7.0); break;
+                    case 1: ok = sensor.pHCalibrationStatus() == 0x00; break;
+                    default:
+                        ok = sensor.setCapCoefficients(K[0], K[1], K[2], K[3], K[4],
+                                                       K[5], K[6], K[7]);
+                        break;
+                }
+                time += micros() - began;
+                calls++;
+                if (ok) worked++;
+            }
+        }
+        yosemitechStats stats = sensor.getStats();
+        printf("| %-10s | %7u | %6u | %9.1f | %13.2f | %10u | %17u |\n",
+               modeNames[mode], calls, worked, time / 1000.0 / calls,
+               (double)stats.transactions / calls, stats.exceptions,
+               stats.exceptionTime);
+        fflush(stdout);
+    }
+
+    delete serial;
+    delete tcp;
+    return 0;
+}
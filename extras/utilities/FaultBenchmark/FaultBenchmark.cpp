@@ -0,0 +1,240 @@
+/*****************************************************************************
+FaultBenchmark.cpp
+
+A command line tool, for a Linux or macOS computer, that measures how well the
+library rides out a noisy bus.  It puts a yosemitechFaultStream between the
+library and one sensor and, at each of a rising series of fault rates, takes
+readings as fast as it can for a while, along with the occasional
+startMeasurement(), activateBrush() and getSlaveID().
+
+For each rate it prints the good readings per second spent reading, the share of
+getValues() calls that worked, their mean and worst case time, the mean time of
+those that met a fault (the time to recover from it), how many of the other
+calls worked, and how many commands went out on the bus per reading.  With
+-a off the library waits the whole modbus timeout for every response instead
+of the timeout it learns from the sensor's response times.
+
+Usage:
+    FaultBenchmark [-s seconds] [-f fault] [-r rates] [-d delay] [-b baud]
+                   [-a on|off] port slaveID:model
+
+    -s seconds  how long to run at each fault rate (10)
+    -f fault    only inject one kind of fault: drop, flip, truncate, delay,
+                duplicate, stray or echo (all of them)
+    -r rates    a comma separated list of the chance of each fault, from 0 to
+                1 (0,0.01,0.02,0.05,0.1,0.2)
+    -d delay    how long a delayed response stalls, in milliseconds (100)
+    -b baud     the baud rate of a serial port (9600)
+    -a on|off   whether to learn the response timeout (on)
+
+The port is a serial port device, or host:port for a serial device server.
+See ReadMe.md for how to build this.
+*****************************************************************************/
+
+// ---------------------------------------------------------------------------
+// Include the base required libraries
+// ---------------------------------------------------------------------------
+// The standard library comes first, before Arduino.h can define min() and max()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include <Arduino.h>
+#include <YosemitechModbus.h>
+#include <YosemitechFaultStream.h>
+#include <YosemitechSerialStream.h>
+#include <YosemitechTCPStream.h>
+
+// The names of the models, in the order of yosemitechModel
+static const char* modelNames[] = {"Y502", "Y504", "Y510", "Y511",  "Y513", "Y514",
+                                   "Y516", "Y520", "Y521", "Y532",  "Y533", "Y550",
+                                   "Y551", "Y560", "Y700", "Y4000", nullptr};
+
+// The names of the faults, in the order of yosemitechFault
+static const char* faultNames[] = {"drop",      "flip",  "truncate", "delay",
+                                   "duplicate", "stray", "echo",     nullptr};
+
+// The results at one fault rate
+struct result {
+    uint32_t readings;     // getValues() calls
+    uint32_t good;         // getValues() calls that worked
+    uint32_t readingTime;  // microseconds spent in getValues()
+    uint32_t worst;        // the longest getValues() call, in microseconds
+    uint32_t faulted;      // getValues() calls that met at least one fault
+    uint32_t faultedTime;  // microseconds spent in those calls
+    uint32_t others;       // calls to the other functions
+    uint32_t othersGood;   // calls to the other functions that worked
+};
+
+static void usage(const char* name) {
+    fprintf(stderr,
+            "Usage: %s [-s seconds] [-f fault] [-r rates] [-d delay] [-b baud] "
+            "[-a on|off] port slaveID:model\n",
+            name);
+}
+
+// Counts the faults injected so far
+static uint32_t injected(yosemitechFaultStream& faulty) {
+    uint32_t total = 0;
+    for (int f = 0; f < YM_FAULT_COUNT; f++) {
+        total += faulty.getInjected((yosemitechFault)f);
+    }
+    return total;
+}
+
+// Takes readings through the fault stream for a while
+static result run(yosemitech& sensor, yosemitechFaultStream& faulty, byte slaveID,
+                  uint32_t seconds) {
+    result   r     = {};
+    uint32_t start = millis();
+    for (uint32_t i = 0; millis() - start < seconds * 1000; i++) {
+        float    value = -9999, temperature = -9999;
+        byte     errorCode = 0xFF;
+        uint32_t faults    = injected(faulty);
+        uint32_t began     = micros();
+        bool     ok        = sensor.getValues(value, temperature, errorCode);
+        uint32_t took      = micros() - began;
+        r.readings++;
+        r.readingTime += took;
+        if (ok) r.good++;
+        if (took > r.worst) r.worst = took;
+        // The time a reading that met a fault took is the time to recover from it
+        if (injected(faulty) != faults) {
+            r.faulted++;
+            r.faultedTime += took;
+        }
+
+        // Every tenth reading, try one of the commands with their own checks
+        if (i % 10 != 9) continue;
+        bool worked = false;
+        switch ((i / 10) % 3) {
+            case 0: worked = sensor.startMeasurement(); break;
+            case 1: worked = sensor.activateBrush(); break;
+            default: worked = sensor.getSlaveID() == slaveID; break;
+        }
+        r.others++;
+        if (worked) r.othersGood++;
+    }
+    return r;
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t    seconds = 10;
+    int         fault   = -1;
+    const char* rates   = "0,0.01,0.02,0.05,0.1,0.2";
+    uint32_t    delay   = 100;
+    uint32_t    baud    = 9600;
+    bool        learn   = true;
+    int         arg     = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (arg + 1 >= argc) break;
+        if (strcmp(argv[arg], "-s") == 0) {
+            seconds = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-f") == 0) {
+            const char* name = argv[++arg];
+            for (int f = 0; faultNames[f] != nullptr; f++) {
+                if (strcmp(name, faultNames[f]) == 0) fault = f;
+            }
+            if (fault < 0) {
+                fprintf(stderr, "Not a fault: %s\n", name);
+                return 2;
+            }
+        } else if (strcmp(argv[arg], "-r") == 0) {
+            rates = argv[++arg];
+        } else if (strcmp(argv[arg], "-d") == 0) {
+            delay = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-b") == 0) {
+            baud = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-a") == 0) {
+            learn = strcmp(argv[++arg], "off") != 0;
+        } else {
+            break;
+        }
+    }
+    if (argc - arg != 2 || seconds == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    const char* port = argv[arg++];
+
+    const char* colon   = strchr(argv[arg], ':');
+    int         slaveID = (int)strtol(argv[arg], nullptr, 0);
+    int         model   = -1;
+    for (int m = 0; colon != nullptr && modelNames[m] != nullptr; m++) {
+        if (strcmp(colon + 1, modelNames[m]) == 0) model = m;
+    }
+    if (model < 0 || slaveID < 1 || slaveID > 247) {
+        fprintf(stderr, "Not a sensor: %s\n", argv[arg]);
+        usage(argv[0]);
+        return 2;
+    }
+
+    // A port with a colon in it is on a device server
+    Stream*                 bus    = nullptr;
+    yosemitechSerialStream* serial = nullptr;
+    yosemitechTCPStream*    tcp    = nullptr;
+    std::string             host(port);
+    size_t                  split = host.rfind(':');
+    if (split != std::string::npos) {
+        host.resize(split);
+        tcp = new yosemitechTCPStream(host.c_str(), atoi(port + split + 1));
+        if (!tcp->begin()) {
+            fprintf(stderr, "Could not connect to %s\n", port);
+            return 2;
+        }
+        bus = tcp;
+    } else {
+        serial = new yosemitechSerialStream(port);
+        if (!serial->begin(baud)) {
+            fprintf(stderr, "Could not open %s at %u baud\n", port, baud);
+            return 2;
+        }
+        bus = serial;
+    }
+
+    yosemitechFaultStream faulty(*bus);
+    yosemitech            sensor;
+    faulty.setDelay(delay);
+    sensor.begin((yosemitechModel)model, slaveID, faulty);
+    sensor.setBaudRate(baud);
+    sensor.setAdaptiveTimeout(learn);
+
+    printf("Injecting %s into the responses of %s, %u s at each rate, with %s\n\n",
+           fault < 0 ? "every fault" : faultNames[fault], argv[arg], seconds,
+           learn ? "a learned timeout" : "a fixed timeout");
+    printf("  rate  readings/s     good  mean ms  worst ms  faulted ms   others  "
+           "commands/reading\n");
+    for (const char* next = rates; *next != '\0';) {
+        char* end  = nullptr;
+        float rate = strtof(next, &end);
+        if (end == next) break;
+        next = *end == ',' ? end + 1 : end;
+
+        faulty.setSeed(1);
+        if (fault < 0) {
+            faulty.setAllFaults(rate);
+        } else {
+            faulty.setAllFaults(0);
+            faulty.setFault((yosemitechFault)fault, rate);
+        }
+        sensor.resetStats();
+        result          r     = run(sensor, faulty, slaveID, seconds);
+        yosemitechStats stats = sensor.getStats();
+
+        float busSeconds = r.readingTime / 1e6f;
+        printf("%6.3f  %10.1f  %6.1f%%  %7.1f  %8.1f  %10.1f  %6.1f%%  %16.2f\n", rate,
+               busSeconds > 0 ? r.good / busSeconds : 0,
+               r.readings ? 100.0f * r.good / r.readings : 0,
+               r.readings ? r.readingTime / 1000.0f / r.readings : 0, r.worst / 1000.0f,
+               r.faulted ? r.faultedTime / 1000.0f / r.faulted : 0,
+               r.others ? 100.0f * r.othersGood / r.others : 0,
+               r.readings ? (float)stats.transactions / r.readings : 0);
+        fflush(stdout);
+    }
+
+    delete serial;
+    delete tcp;
+    return 0;
+}
@@ -0,0 +1,178 @@
+/*****************************************************************************
+FilterBenchmark.cpp
+
+A command line tool, for a Linux or macOS computer, that measures the filter
+stages of YosemitechFilter.h and a few chains of them.  It makes up a slowly
+changing turbidity with noise and the spikes of bubbles and debris, the same
+every run, and runs it through each filter in turn.
+
+For each filter it prints its size in bytes, the time it takes for each value
+(the fastest of five runs), and how far its output is from the turbidity
+without the noise and spikes: the root mean square and the worst error.
+
+The FilterCycles sketch measures the same filters on a board.
+
+Usage:
+    FilterBenchmark [-n values] [-p chance]
+
+    -n values   how many values to filter (1000000)
+    -p chance   the chance of a spike on each value, from 0 to 1 (0.02)
+
+See ReadMe.md for how to build this.
+*****************************************************************************/
+
+// ---------------------------------------------------------------------------
+// Include the base required libraries
+// ---------------------------------------------------------------------------
+// The standard library comes first, before Arduino.h can define min() and max()
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include <Arduino.h>
+#include <YosemitechFilter.h>
+
+// The values, one a second
+struct sample {
+    float    clean;  // the turbidity, without noise or spikes
+    float    value;  // what the sensor read
+    uint32_t time;   // the value of millis() when it was read
+};
+
+static std::vector<sample> samples;
+
+// A random number from 0 to 1, the same every run
+static uint32_t seed = 1;
+static float    random01(void) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) / 16777216.0f;
+}
+
+static void makeSamples(uint32_t count, float chance) {
+    samples.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        sample& s = samples[i];
+        s.time    = i * 1000;
+        s.clean   = 10 + 5 * sinf(6.2831853f * i / 3600);
+        // Noise of about 0.1 NTU, and a spike of 20 to 200 NTU now and then
+        float noise = (random01() + random01() + random01() - 1.5f) * 0.2f;
+        s.value     = s.clean + noise;
+        if (random01() < chance) s.value += 20 + 180 * random01();
+    }
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-n values] [-p chance]\n", name);
+}
+
+// Runs every value through a filter and prints its row of the table
+template <typename Filter>
+static void run(const char* name, Filter& filter) {
+    // The fastest of a few runs, to leave out whatever else the computer was doing
+    volatile float sink = 0;
+    double         best = 0;
+    for (int r = 0; r < 5; r++) {
+        filter.reset();
+        auto  start = std::chrono::steady_clock::now();
+        float sum   = 0;
+        for (const sample& s : samples) sum += filter.apply(s.value, s.time);
+        double seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+                .count();
+        sink = sum;
+        if (r == 0 || seconds < best) best = seconds;
+    }
+    (void)sink;
+
+    // Then once more for the errors
+    filter.reset();
+    double squares = 0;
+    float  worst   = 0;
+    for (const sample& s : samples) {
+        float error = fabsf(filter.apply(s.value, s.time) - s.clean);
+        squares += (double)error * error;
+        if (error > worst) worst = error;
+    }
+
+    printf("| %-32s | %5u | %8.1f | %9.3f | %9.2f |\n", name, (unsigned)sizeof(filter),
+           best * 1e9 / samples.size(), sqrt(squares / samples.size()), worst);
+}
+
+// No filter at all, for the errors of the raw values
+struct passThrough {
+    float apply(float value, uint32_t) {
+        return value;
+    }
+    void reset(void) {}
+};
+
+
+int main(int argc, char* argv[]) {
+    uint32_t count  = 1000000;
+    float    chance = 0.02f;
+    int      arg    = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (arg + 1 >= argc) break;
+        if (strcmp(argv[arg], "-n") == 0) {
+            count = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-p") == 0) {
+            chance = atof(argv[++arg]);
+        } else {
+            break;
+        }
+    }
+    if (arg != argc || count == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    makeSamples(count, chance);
+
+    printf("| %-32s | %5s | %8s | %9s | %9s |\n", "Filter", "Bytes", "ns/value",
+           "RMS error", "Max error");
+    printf("| -------------------------------- | ----- | -------- | --------- | "
+           "--------- |\n");
+
+    passThrough none;
+    run("none", none);
+
+    yosemitechMedian<3> median3;
+    run("yosemitechMedian<3>", median3);
+    yosemitechMedian<5> median5;
+    run("yosemitechMedian<5>", median5);
+    yosemitechMedian<9> median9;
+    run("yosemitechMedian<9>", median9);
+
+    yosemitechHampel<5> hampel5;
+    run("yosemitechHampel<5>", hampel5);
+    yosemitechHampel<9> hampel9;
+    run("yosemitechHampel<9>", hampel9);
+    yosemitechHampel<15> hampel15;
+    run("yosemitechHampel<15>", hampel15);
+
+    yosemitechEWMA ewma;
+    run("yosemitechEWMA", ewma);
+
+    yosemitechRateLimit rateLimit;
+    rateLimit.setLimit(0.1);
+    run("yosemitechRateLimit", rateLimit);
+
+    yosemitechFilterChain<yosemitechHampel<9>, yosemitechEWMA> hampelEWMA;
+    run("Hampel<9>, EWMA", hampelEWMA);
+
+    yosemitechFilterChain<yosemitechMedian<5>, yosemitechEWMA> medianEWMA;
+    run("Median<5>, EWMA", medianEWMA);
+
+    yosemitechFilterChain<yosemitechHampel<9>, yosemitechMedian<3>, yosemitechEWMA,
+                          yosemitechRateLimit>
+        all;
+    all.stage<3>().setLimit(0.1);
+    run("Hampel<9>, Median<3>, EWMA, Rate", all);
+
+    return 0;
+}
+
+// cspell: ignore Hampel EWMA NTU
@@ -0,0 +1,112 @@
+/*****************************************************************************
+FilterCycles.ino
+
+This measures the filter stages of YosemitechFilter.h on a board: for each one
+it prints the bytes of RAM it takes and the time and clock cycles it takes to
+filter a value, then does it all again every minute.
+
+No sensor is needed.  The values are made up as they go: about 10 NTU with a
+little noise and the odd spike, so the outlier filters take both of their
+paths.  The time to make up a value is measured on its own first and taken
+off the time of each filter.
+
+The FilterBenchmark utility measures the same filters on a computer.
+*****************************************************************************/
+
+// ---------------------------------------------------------------------------
+// Include the base required libraries
+// ---------------------------------------------------------------------------
+#include <Arduino.h>
+#include <YosemitechFilter.h>
+
+// How many values to time each filter over
+const uint16_t timedValues = 1000;
+
+// A made up turbidity, the same every time
+uint32_t seed = 1;
+float    nextValue() {
+    seed        = seed * 1103515245 + 12345;
+    float value = 10 + (seed >> 24) / 1280.0;
+    if ((seed >> 16 & 0x3F) == 0) value += 100;  // a spike, 1 value in 64
+    return value;
+}
+
+// No filter at all, to time making up the values
+struct passThrough {
+    float apply(float value, uint32_t) {
+        return value;
+    }
+    void reset(void) {}
+};
+
+// The time to make up a value and add it up, in microseconds
+float overhead = 0;
+
+// Times a filter over a run of values, in microseconds per value
+template <typename Filter>
+float timeFilter(Filter& filter) {
+    filter.reset();
+    seed                = 1;
+    volatile float sink = 0;
+    uint32_t       start = micros();
+    for (uint16_t i = 0; i < timedValues; i++) {
+        sink = sink + filter.apply(nextValue(), i * 1000UL);
+    }
+    return (float)(micros() - start) / timedValues;
+}
+
+template <typename Filter>
+void measure(const __FlashStringHelper* name, Filter& filter) {
+    float us = timeFilter(filter) - overhead;
+    Serial.print(name);
+    Serial.print(F(": "));
+    Serial.print(sizeof(filter));
+    Serial.print(F(" bytes, "));
+    Serial.print(us, 2);
+    Serial.print(F(" us, "));
+    Serial.print(us * (F_CPU / 1000000UL), 0);
+    Serial.println(F(" cycles"));
+}
+
+// The filters are globals, so the RAM they take shows in the build's memory use
+passThrough                                                none;
+yosemitechMedian<3>                                        median3;
+yosemitechMedian<5>                                        median5;
+yosemitechMedian<9>                                        median9;
+yosemitechHampel<5>                                        hampel5;
+yosemitechHampel<9>                                        hampel9;
+yosemitechEWMA                                             ewma;
+yosemitechRateLimit                                        rateLimit;
+yosemitechFilterChain<yosemitechHampel<9>, yosemitechEWMA> hampelEWMA;
+
+// ---------------------------------------------------------------------------
+// Main setup function
+// ---------------------------------------------------------------------------
+void setup() {
+    Serial.begin(115200);
+    Serial.println(F("FilterCycles.ino"));
+    rateLimit.setLimit(0.1);
+}
+
+// ---------------------------------------------------------------------------
+// Main loop function
+// ---------------------------------------------------------------------------
+void loop() {
+    overhead = timeFilter(none);
+    Serial.print(F("Making up a value takes "));
+    Serial.print(overhead, 2);
+    Serial.println(F(" us"));
+
+    measure(F("yosemitechMedian<3>"), median3);
+    measure(F("yosemitechMedian<5>"), median5);
+    measure(F("yosemitechMedian<9>"), median9);
+    measure(F("yosemitechHampel<5>"), hampel5);
+    measure(F("yosemitechHampel<9>"), hampel9);
+    measure(F("yosemitechEWMA"), ewma);
+    measure(F("yosemitechRateLimit"), rateLimit);
+    measure(F("Hampel<9>, EWMA"), hampelEWMA);
+    Serial.println();
+    delay(60000);
+}
+
+// cspell: ignore Hampel EWMA NTU
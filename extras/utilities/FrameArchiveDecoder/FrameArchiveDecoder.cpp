@@ -0,0 +1,327 @@
+/*****************************************************************************
+FrameArchiveDecoder.cpp
+
+A command line tool, for a Linux or macOS computer, that decodes archives of
+raw Modbus response frames captured from Yosemitech sensors - the frames
+answering the value reads from register 0x2600 (or 0x2601 for the Y4000) - in
+bulk.
+
+The archive is memory mapped, not read.  It is decoded in two passes over all
+of the frames at once instead of one frame at a time:
+  1. find the frames with a good CRC, skipping anything that isn't a value
+     response
+  2. copy the values of the good frames into one column per value
+A frame that fails the CRC, like one cut short, is only stepped over a byte at
+a time, so the good frame after it is still found.  Because the sensors send
+their floats little-endian, on a little-endian computer the last pass is a
+plain strided copy that the compiler can vectorize; on a big-endian one each
+value is byte-swapped on the way.
+
+Usage:
+    FrameArchiveDecoder [-r registers] [-b] archive.bin [values.csv]
+
+    -r registers  only decode responses of this many registers; by default the
+                  size of the first response with a good CRC is used
+    -b            also time the batch decoder against decoding one frame at a
+                  time the way the library does, and print frames per second
+
+This uses only the C++ standard library and POSIX; build it with, for example:
+    c++ -std=c++11 -O2 -o FrameArchiveDecoder FrameArchiveDecoder.cpp
+*****************************************************************************/
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// CRC
+// ---------------------------------------------------------------------------
+
+// The Modbus CRC-16 (polynomial 0xA001, reflected), a byte at a time from a table
+static uint16_t crcTable[256];
+
+static void makeCRCTable(void) {
+    for (int i = 0; i < 256; i++) {
+        uint16_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 1 ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+        crcTable[i] = crc;
+    }
+}
+
+static uint16_t tableCRC(const uint8_t* data, size_t length) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc = (crc >> 8) ^ crcTable[(crc ^ data[i]) & 0xFF];
+    }
+    return crc;
+}
+
+// The same CRC a bit at a time, the way the modbusMaster works it out
+static uint16_t bitwiseCRC(const uint8_t* data, size_t length) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 1 ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+// ---------------------------------------------------------------------------
+// The archive
+// ---------------------------------------------------------------------------
+
+// A memory mapped archive file
+struct archive {
+    const uint8_t* data;
+    size_t         size;
+};
+
+static bool openArchive(const char* path, archive& file) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    file.size = info.st_size;
+    void* mapped = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // the mapping stays valid
+    if (mapped == MAP_FAILED) return false;
+    madvise(mapped, file.size, MADV_SEQUENTIAL);
+    file.data = (const uint8_t*)mapped;
+    return true;
+}
+
+// The frames found in an archive, as columns
+struct frameColumns {
+    int                             byteCount;   // data bytes in each frame
+    int                             numFloats;   // float values in each frame
+    bool                            hasError;    // whether an error code follows
+    size_t                          candidates;  // frames found, good or bad
+    size_t                          badCRC;      // frames failing the CRC
+    std::vector<size_t>             offsets;     // where each frame starts
+    std::vector<uint8_t>            slaveIDs;    // the slave ID of each good frame
+    std::vector<std::vector<float>> values;      // one column for each value
+    std::vector<uint8_t>            errorCodes;  // the error code of each good frame
+};
+
+// Checks the CRC at the end of a frame of a given length, counting the CRC
+static inline bool goodCRC(const uint8_t* frame, size_t length) {
+    uint16_t sent = frame[length - 2] | (frame[length - 1] << 8);
+    return tableCRC(frame, length - 2) == sent;
+}
+
+// Pass 1: finds every value response with the expected number of data bytes and a
+// good CRC.  Good frames and exception responses are stepped over whole, and anything
+// else, a frame that fails the CRC included, one byte at a time, so the search finds
+// its way back to the frames after any garbage or a frame that was cut short.  With
+// no size given, the first value response with a good CRC sets it, so noise that
+// happens to look like the start of one can't.
+static void findFrames(const archive& file, frameColumns& frames) {
+    const uint8_t* data = file.data;
+    size_t         pos  = 0;
+    frames.candidates   = 0;
+    while (pos + 5 <= file.size) {
+        const uint8_t* frame    = data + pos;
+        uint8_t        function = frame[1];
+        if (function == 0x03 && (frames.byteCount == 0 ||
+                                 frame[2] == frames.byteCount)) {
+            size_t length = 3 + frame[2] + 2;
+            if (pos + length <= file.size) {
+                frames.candidates++;
+                if (goodCRC(frame, length)) {
+                    frames.byteCount = frame[2];
+                    frames.offsets.push_back(pos);
+                    pos += length;
+                    continue;
+                }
+            }
+        } else if (function == 0x83 && goodCRC(frame, 5)) {
+            pos += 5;
+            continue;
+        }
+        pos++;
+    }
+    frames.badCRC    = frames.candidates - frames.offsets.size();
+    frames.numFloats = frames.byteCount / 4;
+    frames.hasError  = frames.byteCount % 4 >= 2;
+}
+
+// Gets a little-endian float from anywhere in memory
+static inline float floatLE(const uint8_t* bytes) {
+    uint32_t bits;
+    memcpy(&bits, bytes, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    bits = __builtin_bswap32(bits);
+#endif
+    float value;
+    memcpy(&value, &bits, 4);
+    return value;
+}
+
+// Pass 2: copies each value of every good frame into its column
+static void decodeColumns(const archive& file, frameColumns& frames) {
+    size_t count = frames.offsets.size();
+    frames.slaveIDs.resize(count);
+    frames.values.assign(frames.numFloats, std::vector<float>(count));
+    frames.errorCodes.resize(frames.hasError ? count : 0);
+
+    const size_t* offsets = frames.offsets.data();
+    for (size_t i = 0; i < count; i++) { frames.slaveIDs[i] = file.data[offsets[i]]; }
+    // One column at a time, so each inner loop writes one contiguous array
+    for (int column = 0; column < frames.numFloats; column++) {
+        const uint8_t* base = file.data + 3 + 4 * column;
+        float*         out  = frames.values[column].data();
+        for (size_t i = 0; i < count; i++) { out[i] = floatLE(base + offsets[i]); }
+    }
+    if (frames.hasError) {
+        const uint8_t* base = file.data + 3 + 4 * frames.numFloats;
+        for (size_t i = 0; i < count; i++) { frames.errorCodes[i] = base[offsets[i]]; }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// The frame at a time decoder, for comparison
+// ---------------------------------------------------------------------------
+
+// The same little-endian float union the modbusMaster uses
+union leFrame {
+    uint8_t bytes[4];
+    float   value;
+};
+
+// Decodes the archive one frame at a time into rows, the way a sketch would
+static size_t decodeFrameByFrame(const archive& file, int byteCount,
+                                 std::vector<float>& rows) {
+    size_t length = 3 + byteCount;
+    int    floats = byteCount / 4;
+    size_t good   = 0;
+    size_t pos    = 0;
+    rows.clear();
+    while (pos + length + 2 <= file.size) {
+        const uint8_t* frame = file.data + pos;
+        if (frame[1] != 0x03 || frame[2] != byteCount) {
+            bool exception = frame[1] == 0x83 &&
+                bitwiseCRC(frame, 3) == (frame[3] | (frame[4] << 8));
+            pos += exception ? 5 : 1;
+            continue;
+        }
+        uint16_t sent = frame[length] | (frame[length + 1] << 8);
+        // A frame that fails the CRC may be cut short, with the next one inside it
+        if (bitwiseCRC(frame, length) != sent) {
+            pos++;
+            continue;
+        }
+        for (int v = 0; v < floats; v++) {
+            leFrame fram;
+            for (int b = 0; b < 4; b++) { fram.bytes[b] = frame[3 + 4 * v + b]; }
+            rows.push_back(fram.value);
+        }
+        good++;
+        pos += length + 2;
+    }
+    return good;
+}
+
+// ---------------------------------------------------------------------------
+// Main function
+// ---------------------------------------------------------------------------
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-r registers] [-b] archive.bin [values.csv]\n", name);
+}
+
+int main(int argc, char* argv[]) {
+    int         registers = 0;
+    bool        benchmark = false;
+    const char* inPath    = nullptr;
+    const char* outPath   = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            registers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0) {
+            benchmark = true;
+        } else if (inPath == nullptr) {
+            inPath = argv[i];
+        } else if (outPath == nullptr) {
+            outPath = argv[i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (inPath == nullptr || registers < 0 || registers > 125) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    archive file;
+    if (!openArchive(inPath, file)) {
+        fprintf(stderr, "Could not map %s\n", inPath);
+        return 2;
+    }
+    makeCRCTable();
+
+    frameColumns frames;
+    frames.byteCount = registers * 2;
+    auto start       = std::chrono::steady_clock::now();
+    findFrames(file, frames);
+    decodeColumns(file, frames);
+    double batchTime =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%zu frames of %d registers found, %zu failed the CRC, %zu decoded into %d "
+           "value columns%s\n",
+           frames.candidates, frames.byteCount / 2, frames.badCRC,
+           frames.offsets.size(), frames.numFloats,
+           frames.hasError ? " and an error code column" : "");
+
+    if (benchmark) {
+        std::vector<float> rows;
+        start       = std::chrono::steady_clock::now();
+        size_t good = decodeFrameByFrame(file, frames.byteCount, rows);
+        std::chrono::duration<double> oneTime =
+            std::chrono::steady_clock::now() - start;
+        printf("batch:          %12.0f frames/s\n", frames.candidates / batchTime);
+        printf("frame by frame: %12.0f frames/s (%zu decoded)\n",
+               frames.candidates / oneTime.count(), good);
+    }
+
+    if (outPath != nullptr) {
+        FILE* out = fopen(outPath, "w");
+        if (out == nullptr) {
+            fprintf(stderr, "Could not write %s\n", outPath);
+            return 2;
+        }
+        fprintf(out, "offset,slaveID");
+        for (int v = 0; v < frames.numFloats; v++) { fprintf(out, ",value%d", v + 1); }
+        fprintf(out, frames.hasError ? ",errorCode\n" : "\n");
+        for (size_t i = 0; i < frames.offsets.size(); i++) {
+            fprintf(out, "%zu,%u", frames.offsets[i], frames.slaveIDs[i]);
+            for (int v = 0; v < frames.numFloats; v++) {
+                fprintf(out, ",%g", frames.values[v][i]);
+            }
+            if (frames.hasError) fprintf(out, ",%u", frames.errorCodes[i]);
+            fprintf(out, "\n");
+        }
+        fclose(out);
+    }
+
+    munmap((void*)file.data, file.size);
+    return 0;
+}
+
+// cspell: ignore madvise fram
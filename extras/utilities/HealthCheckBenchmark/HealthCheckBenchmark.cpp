@@ -0,0 +1,155 @@
+/*****************************************************************************
+HealthCheckBenchmark.cpp
+
+A command line tool, for a Linux or macOS computer, that measures how much bus
+traffic the register cache saves a health check loop.  Each check reads the
+sensor's version, serial number, calibration and brush interval, the way a
+dashboard does, and then its values.  It runs the loop with the register cache
+off and then on.
+
+For each it prints the commands sent on the bus, and their time, for each
+check, and the cache hits and misses counted by getStats().
+
+Usage:
+    HealthCheckBenchmark [-n checks] [-i interval] [-b baud] port slaveID:model
+
+    -n checks    how many checks to run each way (100)
+    -i interval  the time from the start of one check to the next, in
+                 milliseconds, or 0 to run them back to back (0)
+    -b baud      the baud rate of a serial port (9600)
+
+The port is a serial port device, or host:port for a serial device server.
+See ReadMe.md for how to build this.
+*****************************************************************************/
+
+// ---------------------------------------------------------------------------
+// Include the base required libraries
+// ---------------------------------------------------------------------------
+// The standard library comes first, before Arduino.h can define min() and max()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include <Arduino.h>
+#include <YosemitechModbus.h>
+#include <YosemitechSerialStream.h>
+#include <YosemitechTCPStream.h>
+
+// The names of the models, in the order of yosemitechModel
+static const char* modelNames[] = {"Y502", "Y504", "Y510", "Y511",  "Y513", "Y514",
+                                   "Y516", "Y520", "Y521", "Y532",  "Y533", "Y550",
+                                   "Y551", "Y560", "Y700", "Y4000", nullptr};
+
+// Runs the checks and prints a row, returning false if any read failed
+static bool run(yosemitech& sensor, bool cache, uint32_t checks, uint32_t interval) {
+    sensor.setRegisterCache(cache);
+    sensor.clearRegisterCache();
+    sensor.resetStats();
+    uint32_t failed = 0;
+    uint32_t start  = millis();
+    for (uint32_t i = 0; i < checks; i++) {
+        uint32_t began = millis();
+        float    hardware, software, K, B, value, temperature;
+        byte     errorCode;
+        if (!sensor.getVersion(hardware, software)) failed++;
+        if (sensor.getSerialNumber().length() == 0) failed++;
+        if (!sensor.getCalibration(K, B)) failed++;
+        sensor.getBrushInterval();
+        if (!sensor.getValues(value, temperature, errorCode)) failed++;
+        while (i + 1 < checks && millis() - began < interval) delay(1);
+    }
+    uint32_t        took  = millis() - start;
+    yosemitechStats stats = sensor.getStats();
+    printf("| %-5s | %6u | %14.2f | %15.1f | %10u | %12u | %9.1f | %6u |\n",
+           cache ? "on" : "off", checks, (double)stats.transactions / checks,
+           (double)stats.busTime / checks, stats.cacheHits, stats.cacheMisses,
+           took / 1000.0, failed);
+    fflush(stdout);
+    return failed == 0;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr,
+            "Usage: %s [-n checks] [-i interval] [-b baud] port slaveID:model\n",
+            name);
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t checks   = 100;
+    uint32_t interval = 0;
+    uint32_t baud     = 9600;
+    int      arg      = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (arg + 1 >= argc) break;
+        if (strcmp(argv[arg], "-n") == 0) {
+            checks = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-i") == 0) {
+            interval = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-b") == 0) {
+            baud = atoi(argv[++arg]);
+        } else {
+            break;
+        }
+    }
+    if (argc - arg != 2 || checks == 0 || baud == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    const char* port = argv[arg++];
+
+    const char* colon   = strchr(argv[arg], ':');
+    int         slaveID = (int)strtol(argv[arg], nullptr, 0);
+    int         model   = -1;
+    for (int m = 0; colon != nullptr && modelNames[m] != nullptr; m++) {
+        if (strcmp(colon + 1, modelNames[m]) == 0) model = m;
+    }
+    if (model < 0 || slaveID < 1 || slaveID > 247) {
+        fprintf(stderr, "Not a sensor: %s\n", argv[arg]);
+        usage(argv[0]);
+        return 2;
+    }
+
+    // A port with a colon in it is on a device server
+    Stream*                 bus    = nullptr;
+    yosemitechSerialStream* serial = nullptr;
+    yosemitechTCPStream*    tcp    = nullptr;
+    std::string             host(port);
+    size_t                  split = host.rfind(':');
+    if (split != std::string::npos) {
+        host.resize(split);
+        tcp = new yosemitechTCPStream(host.c_str(), atoi(port + split + 1));
+        if (!tcp->begin()) {
+            fprintf(stderr, "Could not connect to %s\n", port);
+            return 2;
+        }
+        bus = tcp;
+    } else {
+        serial = new yosemitechSerialStream(port);
+        if (!serial->begin(baud)) {
+            fprintf(stderr, "Could not open %s at %u baud\n", port, baud);
+            return 2;
+        }
+        bus = serial;
+    }
+
+    yosemitech sensor;
+    sensor.begin((yosemitechModel)model, slaveID, *bus);
+    sensor.setBaudRate(baud);
+
+    printf("%u health checks of 0x%02X:%s", checks, slaveID, modelNames[model]);
+    if (interval > 0) printf(", %u ms apart", interval);
+    printf("\n\n");
+    printf("| %-5s | %6s | %14s | %15s | %10s | %12s | %9s | %6s |\n", "Cache",
+           "Checks", "Commands/check", "Bus ms/check", "Cache hits", "Cache misses",
+           "Seconds", "Failed");
+    printf("| ----- | ------ | -------------- | --------------- | ---------- | "
+           "------------ | --------- | ------ |\n");
+    bool ok = run(sensor, false, checks, interval);
+    ok      = run(sensor, true, checks, interval) && ok;
+
+    delete serial;
+    delete tcp;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+/*****************************************************************************
+ModbusGateway.cpp
+
+A command line tool, for a Linux or macOS computer, that shares the Yosemitech
+sensors on one serial bus with any number of Modbus TCP clients - a SCADA
+system, a historian and an engineering laptop, say - without each of them
+polling the slow RS-485 line.
+
+The sensors' values and their version and serial number are kept in a cache
+that is refreshed from the bus on a schedule, and reads of those registers are
+answered from it.  Writes and any other reads are sent on to the sensors one at
+a time.  See yosemitechGateway in the library for the details.
+
+Usage:
+    ModbusGateway [-p port] [-a address] [-i interval] device baud
+                  slaveID:model [slaveID:model ...]
+
+    -p port      the TCP port to listen on (502)
+    -a address   the address to listen on (127.0.0.1; 0.0.0.0 for any)
+    -i interval  how often to refresh the values, in seconds (10)
+
+The models are the names of the library's models, like Y511 or Y4000.  Stop
+the gateway with Ctrl+C.  See ReadMe.md for how to build this.
+*****************************************************************************/
+
+// ---------------------------------------------------------------------------
+// Include the base required libraries
+// ---------------------------------------------------------------------------
+// The standard library comes first, before Arduino.h can define min() and max()
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <Arduino.h>
+#include <YosemitechModbus.h>
+#include <YosemitechGateway.h>
+#include <YosemitechSerialStream.h>
+
+// The names of the models, in the order of yosemitechModel
+static const char* modelNames[] = {"Y502", "Y504", "Y510", "Y511",  "Y513", "Y514",
+                                   "Y516", "Y520", "Y521", "Y532",  "Y533", "Y550",
+                                   "Y551", "Y560", "Y700", "Y4000", nullptr};
+
+static volatile sig_atomic_t stopping = 0;
+
+static void stop(int) {
+    stopping = 1;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr,
+            "Usage: %s [-p port] [-a address] [-i interval] device baud "
+            "slaveID:model [slaveID:model ...]\n",
+            name);
+}
+
+int main(int argc, char* argv[]) {
+    uint16_t    port     = 502;
+    const char* address  = "127.0.0.1";
+    uint32_t    interval = 10;
+    int         arg      = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (arg + 1 >= argc) break;
+        if (strcmp(argv[arg], "-p") == 0) {
+            port = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-a") == 0) {
+            address = argv[++arg];
+        } else if (strcmp(argv[arg], "-i") == 0) {
+            interval = atoi(argv[++arg]);
+        } else {
+            break;
+        }
+    }
+    if (argc - arg < 3 || interval == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    const char* device = argv[arg++];
+    uint32_t    baud   = atoi(argv[arg++]);
+
+    yosemitechSerialStream bus(device);
+    if (!bus.begin(baud)) {
+        fprintf(stderr, "Could not open %s at %u baud\n", device, baud);
+        return 2;
+    }
+
+    yosemitechGateway        gateway;
+    std::vector<yosemitech*> sensors;
+    for (; arg < argc; arg++) {
+        const char* colon   = strchr(argv[arg], ':');
+        int         slaveID = (int)strtol(argv[arg], nullptr, 0);
+        int         model   = -1;
+        for (int m = 0; colon != nullptr && modelNames[m] != nullptr; m++) {
+            if (strcmp(colon + 1, modelNames[m]) == 0) model = m;
+        }
+        if (model < 0 || slaveID < 1 || slaveID > 247) {
+            fprintf(stderr, "Not a sensor: %s\n", argv[arg]);
+            usage(argv[0]);
+            return 2;
+        }
+        yosemitech* sensor = new yosemitech;
+        sensor->begin((yosemitechModel)model, slaveID, bus);
+        sensor->setBaudRate(baud);
+        if (!gateway.addSensor(*sensor, interval * 1000)) {
+            fprintf(stderr, "Too many sensors\n");
+            return 2;
+        }
+        sensors.push_back(sensor);
+    }
+
+    if (!gateway.begin(port, address)) {
+        fprintf(stderr, "Could not listen on %s:%u\n", address, port);
+        return 2;
+    }
+    printf("Serving %zu sensors on %s to Modbus TCP clients at %s:%u\n",
+           sensors.size(), device, address, port);
+    fflush(stdout);
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    for (int second = 1; !stopping; second++) {
+        sleep(1);
+        if (second % 60 != 0 && !stopping) continue;
+        yosemitechGatewayStats stats = gateway.getStats();
+        printf("%u clients (%u connections), %u requests: %u from the cache, %u "
+               "forwarded; %u refreshes, %u failed\n",
+               stats.clients, stats.connections, stats.requests, stats.cacheReads,
+               stats.forwarded, stats.refreshes, stats.refreshFailures);
+        fflush(stdout);
+    }
+
+    gateway.end();
+    for (yosemitech* sensor : sensors) { delete sensor; }
+    return 0;
+}
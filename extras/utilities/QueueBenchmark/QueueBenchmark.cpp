@@ -0,0 +1,201 @@
+/*****************************************************************************
+QueueBenchmark.cpp
+
+A command line tool, for a Linux or macOS computer, that measures
+yosemitechReadingQueue between a producer thread and a consumer thread, next to
+the locked queue it replaces: a std::deque behind a std::mutex, holding as
+many readings.
+
+For each queue it runs the producer flat out and prints the readings a second
+that got through, then runs it at a steady rate and prints the 50th, 99th and
+99.9th percentile and worst time from push() to pop().  The consumer checks
+that every reading arrives once, in order and whole.
+
+Usage:
+    QueueBenchmark [-n readings] [-r rate]
+
+    -n readings  how many readings to pass through each queue flat out
+                 (2000000)
+    -r rate      the readings a second for the latency runs, which pass a
+                 second's worth (20000)
+
+See ReadMe.md for how to build this.
+*****************************************************************************/
+
+// ---------------------------------------------------------------------------
+// Include the base required libraries
+// ---------------------------------------------------------------------------
+// The standard library comes first, before Arduino.h can define min() and max()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <Arduino.h>
+#include <YosemitechReadingQueue.h>
+
+typedef std::chrono::steady_clock benchClock;
+
+// The locked queue, for comparison: the same push() and pop(), but both take a lock
+template <uint16_t Capacity>
+class lockedQueue {
+ public:
+    bool push(const yosemitechReading& reading) {
+        std::lock_guard<std::mutex> lock(_lock);
+        if (_readings.size() == Capacity) return false;
+        _readings.push_back(reading);
+        return true;
+    }
+    bool pop(yosemitechReading& reading) {
+        std::lock_guard<std::mutex> lock(_lock);
+        if (_readings.empty()) return false;
+        reading = _readings.front();
+        _readings.pop_front();
+        return true;
+    }
+
+ private:
+    std::mutex                    _lock;
+    std::deque<yosemitechReading> _readings;
+};
+
+// Fills in a reading with its sequence number in every field, so a torn copy shows
+static void makeReading(yosemitechReading& reading, uint32_t sequence) {
+    reading.time      = sequence;
+    reading.slaveID   = sequence & 0xFF;
+    reading.numValues = YM_MAX_VALUES;
+    reading.errorCode = 0;
+    for (uint8_t i = 0; i < YM_MAX_VALUES; i++) {
+        reading.values[i] = (float)(sequence & 0xFFFF);
+    }
+}
+
+static bool whole(const yosemitechReading& reading, uint32_t sequence) {
+    if (reading.time != sequence || reading.slaveID != (sequence & 0xFF)) return false;
+    for (uint8_t i = 0; i < YM_MAX_VALUES; i++) {
+        if (reading.values[i] != (float)(sequence & 0xFFFF)) return false;
+    }
+    return true;
+}
+
+// Passes readings from a producer thread to this one.  With a period, the producer
+// pushes one reading every period and the time each spent in the queue is returned;
+// without one it pushes as fast as the queue takes them.  Whoever finds the queue
+// full or empty yields, since the threads may share a core.
+template <typename Queue>
+static double pass(Queue& queue, uint32_t count, benchClock::duration period,
+                   std::vector<double>& latencies, uint32_t& bad) {
+    std::vector<benchClock::time_point> pushed(period.count() > 0 ? count : 0);
+    benchClock::time_point              start = benchClock::now();
+
+    std::thread producer([&]() {
+        yosemitechReading reading;
+        for (uint32_t i = 0; i < count; i++) {
+            if (period.count() > 0) {
+                benchClock::time_point due = start + period * i;
+                while (benchClock::now() < due) std::this_thread::yield();
+            }
+            makeReading(reading, i);
+            // The push publishes the time along with the reading
+            if (period.count() > 0) pushed[i] = benchClock::now();
+            while (!queue.push(reading)) std::this_thread::yield();
+        }
+    });
+
+    yosemitechReading reading;
+    bad = 0;
+    latencies.clear();
+    for (uint32_t i = 0; i < count;) {
+        if (!queue.pop(reading)) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (!whole(reading, i)) bad++;
+        if (period.count() > 0) {
+            latencies.push_back(
+                std::chrono::duration<double, std::micro>(benchClock::now() - pushed[i])
+                    .count());
+        }
+        i++;
+    }
+    producer.join();
+    return std::chrono::duration<double>(benchClock::now() - start).count();
+}
+
+static double percentile(const std::vector<double>& sorted, double percent) {
+    if (sorted.empty()) return 0;
+    return sorted[(size_t)((sorted.size() - 1) * percent / 100)];
+}
+
+// Runs one queue flat out and then at the steady rate, and prints its row.  The queue
+// is static, since the larger ones are too big for the stack and new can't align them
+// before C++17.
+template <typename Queue>
+static void run(const char* name, uint16_t capacity, uint32_t count, uint32_t rate) {
+    static Queue        queue;
+    std::vector<double> latencies;
+    uint32_t            bad    = 0;
+    uint32_t            broken = 0;
+
+    double seconds = pass(queue, count, benchClock::duration(0), latencies, bad);
+    broken += bad;
+    pass(queue, rate,
+         std::chrono::duration_cast<benchClock::duration>(std::chrono::seconds(1)) /
+             rate,
+         latencies, bad);
+    broken += bad;
+    std::sort(latencies.begin(), latencies.end());
+
+    printf("| %-22s | %8u | %12.2f | %7.1f | %7.1f | %8.1f | %8.1f | %6u |\n", name,
+           capacity, count / seconds / 1e6, percentile(latencies, 50),
+           percentile(latencies, 99), percentile(latencies, 99.9),
+           percentile(latencies, 100), broken);
+    fflush(stdout);
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-n readings] [-r rate]\n", name);
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t count = 2000000;
+    uint32_t rate  = 20000;
+    int      arg   = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (arg + 1 >= argc) break;
+        if (strcmp(argv[arg], "-n") == 0) {
+            count = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-r") == 0) {
+            rate = atoi(argv[++arg]);
+        } else {
+            break;
+        }
+    }
+    if (arg != argc || count == 0 || rate == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    printf("%u readings flat out, then %u at %u a second, on %u core(s)\n\n", count,
+           rate, rate, std::thread::hardware_concurrency());
+    printf("| %-22s | %8s | %12s | %7s | %7s | %8s | %8s | %6s |\n", "Queue",
+           "Capacity", "M readings/s", "p50 us", "p99 us", "p99.9 us", "max us",
+           "Broken");
+    printf("| ---------------------- | -------- | ------------ | ------- | ------- | "
+           "-------- | -------- | ------ |\n");
+    run<yosemitechReadingQueue<16>>("yosemitechReadingQueue", 16, count, rate);
+    run<yosemitechReadingQueue<128>>("yosemitechReadingQueue", 128, count, rate);
+    run<yosemitechReadingQueue<1024>>("yosemitechReadingQueue", 1024, count, rate);
+    run<lockedQueue<16>>("std::mutex, std::deque", 16, count, rate);
+    run<lockedQueue<128>>("std::mutex, std::deque", 128, count, rate);
+    run<lockedQueue<1024>>("std::mutex, std::deque", 1024, count, rate);
+    return 0;
+}
+
+// cspell: ignore deque
@@ -0,0 +1,441 @@
+/*****************************************************************************
+SensorSimulator.cpp
+
+A command line tool, for a Linux or macOS computer, that pretends to be a bus of
+Yosemitech sensors on a pseudo-terminal, so the library and the tools built on
+it can be tried out without any hardware.
+
+Each simulated sensor answers reads of its version, serial number, calibration,
+brush interval, slave ID and measured values, and takes writes to them, with a
+configurable response delay.  The values drift slowly so every read is
+different.  Requests for other slave IDs are ignored, like on a real bus.
+
+The bus can also be served on a TCP port instead, like an Ethernet to RS485
+device server passing Modbus RTU frames over TCP.
+
+Usage:
+    SensorSimulator [-l link | -t port] [-d delay] [-b baud] [-n count]
+                    [slaveID:model ...]
+
+    -l link   also make a symbolic link to the pseudo-terminal at this path
+    -t port   act as a device server on this TCP port instead of a
+              pseudo-terminal; a new connection replaces the last one
+    -d delay  how long each sensor takes to answer, in milliseconds (10)
+    -b baud   take as long as a real bus at this baud rate, receiving each
+              request and sending each response a byte at a time (instantly)
+    -n count  simulate sensors at slave IDs 1 to count, taking the models in
+              turn in the order of yosemitechModel, Y502 to Y4000
+
+The models are the names of the library's models, like Y511 or Y4000.  The
+path of the pseudo-terminal is printed on start up; use it as the serial port.
+Stop the simulator with Ctrl+C to see how many requests it answered.
+
+This uses only the C++ standard library and POSIX; build it with, for example:
+    c++ -std=c++11 -O2 -o SensorSimulator SensorSimulator.cpp
+*****************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// The simulated sensors
+// ---------------------------------------------------------------------------
+
+// The serial number code and the layout of the values of each model
+struct modelInfo {
+    const char* name;
+    const char* code;    // the two digits of the serial number that give the model
+    uint16_t    values;  // the register the values start at
+    int         floats;  // the number of float values there
+    bool        error;   // whether an error code register follows the values
+};
+
+static const modelInfo models[] = {
+    {"Y502", "01", 0x2600, 3, false}, {"Y504", "01", 0x2600, 3, false},
+    {"Y510", "10", 0x2600, 2, true},  {"Y511", "29", 0x2600, 2, true},
+    {"Y513", "61", 0x2600, 2, false}, {"Y514", "48", 0x2600, 2, true},
+    {"Y516", "00", 0x2600, 2, true},  {"Y520", "09", 0x2600, 2, true},
+    {"Y521", "09", 0x2600, 2, true},  {"Y532", "43", 0x2600, 2, false},
+    {"Y533", "00", 0x2600, 2, false}, {"Y550", "47", 0x2600, 2, true},
+    {"Y551", "47", 0x2600, 2, true},  {"Y560", "68", 0x2600, 2, false},
+    {"Y700", "24", 0x2600, 3, false}, {"Y4000", "38", 0x2601, 8, false},
+};
+
+// One simulated sensor and its holding registers
+struct sensor {
+    int                          slaveID;
+    const modelInfo*             model;
+    std::map<uint16_t, uint16_t> registers;
+    unsigned long                answered;
+};
+
+// Puts a float into two registers the way the sensors send them: little-endian
+// bytes, two to a register, first byte high
+static void putFloat(sensor& s, uint16_t reg, float value) {
+    uint8_t bytes[4];
+    memcpy(bytes, &value, 4);
+    s.registers[reg]     = (bytes[0] << 8) | bytes[1];
+    s.registers[reg + 1] = (bytes[2] << 8) | bytes[3];
+}
+
+// Puts a string into registers, two characters to a register
+static void putString(sensor& s, uint16_t reg, const char* text, int length) {
+    for (int i = 0; i < length; i += 2) {
+        s.registers[reg + i / 2] = (text[i] << 8) | text[i + 1];
+    }
+}
+
+// Sets up the registers of a new sensor, at the addresses the library uses for its
+// model
+static void makeSensor(sensor& s) {
+    char serial[15];
+    snprintf(serial, sizeof(serial), "01%s%02d%08d", s.model->code, s.slaveID,
+             s.slaveID * 1001);
+    const char* name = s.model->name;
+    s.registers[0x0700] = 0x0100;  // hardware version 1.00
+    s.registers[0x0701] = 0x0114;  // software version 1.20
+    s.registers[0x3000] = s.slaveID << 8;
+    s.registers[0x2E00] = 0;  // read to stop measuring
+
+    if (strcmp(name, "Y4000") == 0) {
+        putString(s, 0x1400, serial, 14);
+        s.registers[0x0E00] = 30;  // brush interval, minutes
+        s.registers[0x0800] = 0;   // error code
+        return;  // the library doesn't calibrate a sonde
+    }
+    putString(s, 0x0900, serial, 14);
+    s.registers[0x3200] = 30;  // brush interval, minutes
+
+    if (strcmp(name, "Y532") == 0) {
+        // The factory calibration of a pH sensor, the calibration point written by
+        // pHCalibrationPoint() and the status read by pHCalibrationStatus()
+        const float factory[6] = {6.86f, -6.72f, 0.04f, 6.86f, -6.56f, -1.04f};
+        for (int i = 0; i < 6; i++) { putFloat(s, 0x2900 + 2 * i, factory[i]); }
+        putFloat(s, 0x2300, 7.0f);
+        s.registers[0x0E00] = 0;
+    } else if (strcmp(name, "Y533") == 0) {
+        putFloat(s, 0x3400, 1.0f);  // calibration K
+        putFloat(s, 0x3402, 0.0f);  // calibration B
+    } else {
+        putFloat(s, 0x1100, 1.0f);  // calibration K
+        putFloat(s, 0x1102, 0.0f);  // calibration B
+    }
+    if (strcmp(name, "Y502") == 0 || strcmp(name, "Y504") == 0) {
+        // The coefficients of the membrane cap, written by setCapCoefficients()
+        for (int i = 0; i < 8; i++) { putFloat(s, 0x2700 + 2 * i, 0.0f); }
+    }
+}
+
+// Updates the values of a sensor, drifting slowly around a different level for each
+static void updateValues(sensor& s, double seconds) {
+    for (int i = 0; i < s.model->floats; i++) {
+        float value = 10 * (i + 1) + sin(seconds / 60 + s.slaveID + i);
+        putFloat(s, s.model->values + 2 * i, value);
+    }
+    if (s.model->error) s.registers[s.model->values + 2 * s.model->floats] = 0;
+    putFloat(s, 0x2400, 20 + sin(seconds / 300));     // temperature
+    putFloat(s, 0x1200, 150 + sin(seconds / 100));    // potential
+    putFloat(s, 0x2800, 7 + sin(seconds / 200) / 2);  // pH or NH4
+}
+
+// ---------------------------------------------------------------------------
+// Modbus RTU
+// ---------------------------------------------------------------------------
+
+static uint16_t modbusCRC(const uint8_t* data, size_t length) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 1 ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+// How long each byte takes on the line, in microseconds, or 0 to send responses
+// all at once
+static int byteTime = 0;
+
+// Adds the CRC to a response and sends it, a byte at a time at the baud rate if
+// there is one
+static void sendFrame(int fd, uint8_t* frame, size_t length) {
+    uint16_t crc      = modbusCRC(frame, length);
+    frame[length]     = crc & 0xFF;
+    frame[length + 1] = crc >> 8;
+    size_t written    = 0;
+    while (written < length + 2) {
+        size_t  chunk = byteTime > 0 ? 1 : length + 2 - written;
+        ssize_t sent  = write(fd, frame + written, chunk);
+        if (sent > 0) {
+            written += sent;
+            if (byteTime > 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(byteTime));
+            }
+        } else if (sent < 0 && errno != EAGAIN && errno != EINTR) {
+            break;  // the other end has gone
+        }
+    }
+}
+
+// Works out how long the request at the start of a buffer is, or 0 if more of it
+// is needed to tell
+static size_t requestLength(const std::vector<uint8_t>& buffer) {
+    if (buffer.size() < 2) return 0;
+    if (buffer[1] == 0x10) return buffer.size() < 7 ? 0 : 9 + buffer[6];
+    return 8;
+}
+
+// Answers one request for a simulated sensor
+static void answer(int fd, sensor& s, const uint8_t* request, double seconds) {
+    uint8_t  response[260];
+    uint8_t  function = request[1];
+    uint16_t reg      = (request[2] << 8) | request[3];
+    uint16_t count    = (request[4] << 8) | request[5];
+    response[0]       = s.slaveID;
+    response[1]       = function;
+
+    uint8_t exception = 0;
+    if (function == 0x03) {
+        updateValues(s, seconds);
+        if (count > 125) exception = 0x03;
+        for (uint16_t i = 0; i < count && exception == 0; i++) {
+            auto found = s.registers.find(reg + i);
+            if (found == s.registers.end()) {
+                exception = 0x02;
+            } else {
+                response[3 + 2 * i] = found->second >> 8;
+                response[4 + 2 * i] = found->second & 0xFF;
+            }
+        }
+        if (exception == 0) {
+            response[2] = count * 2;
+            sendFrame(fd, response, 3 + count * 2);
+        }
+    } else if (function == 0x06 || function == 0x10) {
+        const uint8_t* data = request + (function == 0x06 ? 4 : 7);
+        if (function == 0x06) count = 1;
+        for (uint16_t i = 0; i < count && exception == 0; i++) {
+            if (s.registers.find(reg + i) == s.registers.end()) exception = 0x02;
+        }
+        for (uint16_t i = 0; i < count && exception == 0; i++) {
+            s.registers[reg + i] = (data[2 * i] << 8) | data[2 * i + 1];
+        }
+        if (exception == 0) {
+            memcpy(response + 2, request + 2, 4);
+            sendFrame(fd, response, 6);
+            // A new slave ID takes effect after the response
+            if (reg <= 0x3000 && 0x3000 < reg + count) {
+                s.slaveID = s.registers[0x3000] >> 8;
+            }
+        }
+    } else {
+        exception = 0x01;
+    }
+    if (exception != 0) {
+        response[1] = function | 0x80;
+        response[2] = exception;
+        sendFrame(fd, response, 3);
+    }
+    s.answered++;
+}
+
+// ---------------------------------------------------------------------------
+// Main function
+// ---------------------------------------------------------------------------
+
+static volatile sig_atomic_t stopping = 0;
+
+static void stop(int) {
+    stopping = 1;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr,
+            "Usage: %s [-l link | -t port] [-d delay] [-b baud] [-n count] "
+            "[slaveID:model ...]\n",
+            name);
+}
+
+int main(int argc, char* argv[]) {
+    const char*         link  = nullptr;
+    int                 port  = 0;
+    int                 delay = 10;
+    std::vector<sensor> sensors;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            link = argv[++i];
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            delay = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            // Fill slave IDs 1 to count, going through the models in turn
+            int count = atoi(argv[++i]);
+            for (int id = 1; id <= count && id <= 247; id++) {
+                sensor s  = {};
+                s.slaveID = id;
+                s.model   = &models[(id - 1) % (sizeof(models) / sizeof(models[0]))];
+                makeSensor(s);
+                sensors.push_back(s);
+            }
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            // A byte is ten bits on the line: start, eight data bits and stop
+            int baud = atoi(argv[++i]);
+            byteTime = baud > 0 ? 10000000 / baud : 0;
+        } else {
+            const char* colon = strchr(argv[i], ':');
+            sensor      s     = {};
+            s.slaveID         = (int)strtol(argv[i], nullptr, 0);
+            for (const modelInfo& model : models) {
+                if (colon != nullptr && strcmp(colon + 1, model.name) == 0) {
+                    s.model = &model;
+                }
+            }
+            if (s.model == nullptr || s.slaveID < 1 || s.slaveID > 247) {
+                fprintf(stderr, "Not a sensor: %s\n", argv[i]);
+                usage(argv[0]);
+                return 2;
+            }
+            makeSensor(s);
+            sensors.push_back(s);
+        }
+    }
+    if (sensors.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // The line is either a pseudo-terminal, raw, like a serial port, or the latest
+    // connection to the listening socket
+    int fd       = -1;
+    int listenFd = -1;
+    if (port > 0) {
+        struct sockaddr_in local = {};
+        local.sin_family         = AF_INET;
+        local.sin_port           = htons(port);
+        local.sin_addr.s_addr    = htonl(INADDR_LOOPBACK);
+        int on                   = 1;
+        listenFd                 = socket(AF_INET, SOCK_STREAM, 0);
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(listenFd, (struct sockaddr*)&local, sizeof(local)) != 0 ||
+            listen(listenFd, 4) != 0) {
+            perror("listen");
+            return 2;
+        }
+        printf("Simulating %zu sensors on 127.0.0.1:%d\n", sensors.size(), port);
+    } else {
+        fd = posix_openpt(O_RDWR | O_NOCTTY);
+        if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+            perror("posix_openpt");
+            return 2;
+        }
+        struct termios settings;
+        tcgetattr(fd, &settings);
+        cfmakeraw(&settings);
+        tcsetattr(fd, TCSANOW, &settings);
+        const char* path = ptsname(fd);
+        if (link != nullptr) {
+            unlink(link);
+            if (symlink(path, link) != 0) perror("symlink");
+        }
+        printf("Simulating %zu sensors on %s\n", sensors.size(), link ? link : path);
+    }
+    fflush(stdout);
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    signal(SIGPIPE, SIG_IGN);
+    auto                 start = std::chrono::steady_clock::now();
+    std::vector<uint8_t> buffer;
+    unsigned long        ignored = 0;
+    while (!stopping) {
+        struct pollfd ready[2] = {{fd, POLLIN, 0}, {listenFd, POLLIN, 0}};
+        if (poll(ready, 2, 200) <= 0) continue;
+        if (ready[1].revents & POLLIN) {
+            int connection = accept(listenFd, nullptr, nullptr);
+            if (connection >= 0) {
+                // Send each byte as it's written, so paced responses aren't held
+                // back waiting for acknowledgements
+                int on = 1;
+                setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+                if (fd >= 0) close(fd);
+                fd = connection;
+                buffer.clear();
+            }
+            continue;
+        }
+        uint8_t got[256];
+        ssize_t count = read(fd, got, sizeof(got));
+        if (count <= 0 && port > 0) {
+            // The client has disconnected
+            close(fd);
+            fd = -1;
+            continue;
+        } else if (count <= 0) {
+            // Nothing has the other end of the pseudo-terminal open yet
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            continue;
+        }
+        buffer.insert(buffer.end(), got, got + count);
+
+        // Answer every whole request, dropping a byte at a time to find the next
+        // frame after anything with a bad CRC
+        size_t length;
+        while ((length = requestLength(buffer)) > 0 && buffer.size() >= length) {
+            if (modbusCRC(buffer.data(), length - 2) !=
+                (buffer[length - 2] | (buffer[length - 1] << 8))) {
+                buffer.erase(buffer.begin());
+                continue;
+            }
+            // The first sensor answers the broadcast read of getSlaveID()
+            sensor* target = buffer[0] == 0xFF ? &sensors[0] : nullptr;
+            for (sensor& s : sensors) {
+                if (s.slaveID == buffer[0]) target = &s;
+            }
+            if (target != nullptr) {
+                // The request came in all at once, so take the time it would have
+                // taken on the line first
+                std::this_thread::sleep_for(
+                    std::chrono::microseconds(byteTime * length) +
+                    std::chrono::milliseconds(delay));
+                double seconds = std::chrono::duration<double>(
+                                     std::chrono::steady_clock::now() - start)
+                                     .count();
+                answer(fd, *target, buffer.data(), seconds);
+            } else {
+                ignored++;
+            }
+            buffer.erase(buffer.begin(), buffer.begin() + length);
+        }
+    }
+
+    for (const sensor& s : sensors) {
+        printf("slave 0x%02X %-5s answered %lu requests\n", s.slaveID, s.model->name,
+               s.answered);
+    }
+    printf("%lu requests for other slaves ignored\n", ignored);
+    if (link != nullptr) unlink(link);
+    return 0;
+}
+
+// cspell: ignore NOCTTY TCSANOW cfmakeraw tcgetattr tcsetattr grantpt unlockpt
+// cspell: ignore ptsname openpt NODELAY
@@ -0,0 +1,234 @@
+/*****************************************************************************
+SeriesBenchmark.cpp
+
+A command line tool, for a Linux or macOS computer, that measures how small
+yosemitechSeriesEncoder makes a series of readings and how long it takes to
+encode and decode them.  It makes up a series of readings from a Y4000 sonde,
+once a minute with a few milliseconds of jitter, the same every run, with the
+clock rolling over early on.
+
+It prints the bytes each reading takes encoded, as raw floats (the time, the
+error code and each value) and as CSV, how many times smaller the encoding is,
+and the time it takes to encode and decode each reading (the fastest of five
+runs).  It checks that every reading decodes to exactly what was encoded, bit
+for bit, and does the same for a short series of odd values: NaN, infinity,
+negative zero and the smallest floats.
+
+Usage:
+    SeriesBenchmark [-n readings]
+
+    -n readings  how many readings to encode (100000)
+
+It exits with 1 if a reading didn't decode to what was encoded.  See ReadMe.md
+for how to build this.
+*****************************************************************************/
+
+// ---------------------------------------------------------------------------
+// Include the base required libraries
+// ---------------------------------------------------------------------------
+// The standard library comes first, before Arduino.h can define min() and max()
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include <Arduino.h>
+#include <YosemitechSeriesCodec.h>
+
+// A Stream on a block of memory: writes go on the end and reads come off the front
+class memoryStream : public Stream {
+ public:
+    size_t write(uint8_t value) override {
+        bytes.push_back(value);
+        return 1;
+    }
+    int available() override {
+        return (int)(bytes.size() - position);
+    }
+    int read() override {
+        if (position >= bytes.size()) return -1;
+        return bytes[position++];
+    }
+    int peek() override {
+        if (position >= bytes.size()) return -1;
+        return bytes[position];
+    }
+    void flush() override {}
+    void clear() {
+        bytes.clear();
+        position = 0;
+    }
+
+    std::vector<uint8_t> bytes;
+    size_t               position = 0;
+};
+
+// Makes up the readings of a sonde, with every value rounded as the sonde sends it
+static void makeReadings(std::vector<yosemitechReading>& readings, uint32_t count) {
+    srand(2);
+    uint32_t time = 4294000000UL;  // about 16 minutes before millis() rolls over
+    readings.resize(count);
+    for (uint32_t k = 0; k < count; k++) {
+        yosemitechReading& reading = readings[k];
+        time += 60000 + rand() % 7 - 3;
+        // Now and then the logger was busy for a few minutes
+        if (k % 1000 == 999) time += 250000;
+        double hour       = k / 60.0;
+        reading.time      = time;
+        reading.slaveID   = 1;
+        reading.numValues = 8;
+        reading.errorCode = k % 5000 == 4999 ? 3 : 0;
+        // Dissolved oxygen, turbidity, conductivity, pH, temperature, ORP, chlorophyll
+        reading.values[0] = roundf((8 + sin(hour / 4)) * 100) / 100;
+        reading.values[1] = roundf((3 + rand() % 3) * 10) / 10;
+        reading.values[2] = roundf(250 + 5 * sin(hour / 24));
+        reading.values[3] = roundf((7.2 + 0.1 * sin(hour / 24)) * 100) / 100;
+        reading.values[4] = roundf((15 + 3 * sin(hour / 24)) * 10) / 10;
+        reading.values[5] = roundf(200 + rand() % 3);
+        reading.values[6] = roundf((2 + 0.5 * sin(hour / 6)) * 100) / 100;
+        reading.values[7] = -9999;  // no blue-green algae probe
+    }
+}
+
+// Makes up a few readings of odd values that the encoding must keep exactly
+static void makeOddReadings(std::vector<yosemitechReading>& readings) {
+    const float odd[] = {NAN, -NAN, INFINITY, -INFINITY, 0.0f, -0.0f, FLT_MIN,
+                         FLT_MAX, -FLT_MAX, 1e-45f, -9999, 1, 1, NAN};
+    const uint8_t oddCount = sizeof(odd) / sizeof(odd[0]);
+    readings.resize(64);
+    for (uint32_t k = 0; k < readings.size(); k++) {
+        yosemitechReading& reading = readings[k];
+        // Irregular times that go over the rollover and back to a steady step
+        reading.time      = 4294967000UL + (k < 8 ? k * k * 37 : k * 100);
+        reading.slaveID   = 1;
+        reading.numValues = 3;
+        reading.errorCode = k % 3;
+        for (uint8_t i = 0; i < 3; i++) reading.values[i] = odd[(k * 5 + i) % oddCount];
+    }
+}
+
+static void encode(memoryStream&                         stream,
+                   const std::vector<yosemitechReading>& readings, uint8_t numValues) {
+    yosemitechSeriesEncoder encoder(stream);
+    stream.clear();
+    encoder.begin(1, numValues);
+    for (size_t k = 0; k < readings.size(); k++) encoder.encode(readings[k]);
+    encoder.end();
+}
+
+// Decodes the whole series, and counts the readings that aren't exactly as encoded
+static size_t decode(memoryStream&                         stream,
+                     const std::vector<yosemitechReading>& readings, size_t& wrong) {
+    yosemitechSeriesDecoder decoder(stream);
+    yosemitechReading       reading;
+    size_t                  decoded = 0;
+    stream.position                 = 0;
+    wrong                           = 0;
+    if (!decoder.begin()) return 0;
+    while (decoder.decode(reading)) {
+        if (decoded < readings.size()) {
+            const yosemitechReading& original = readings[decoded];
+            if (reading.time != original.time ||
+                reading.errorCode != original.errorCode ||
+                reading.numValues != original.numValues ||
+                memcmp(reading.values, original.values,
+                       original.numValues * sizeof(float)) != 0) {
+                wrong++;
+            }
+        }
+        decoded++;
+    }
+    return decoded;
+}
+
+// Checks the series decodes to exactly what was encoded, and says what went wrong
+static bool check(const char* name, memoryStream& stream,
+                  const std::vector<yosemitechReading>& readings) {
+    size_t wrong;
+    size_t decoded = decode(stream, readings, wrong);
+    if (decoded == readings.size() && wrong == 0) return true;
+    printf("The %s series decoded to %zu readings of %zu, %zu of them wrong\n", name,
+           decoded, readings.size(), wrong);
+    return false;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-n readings]\n", name);
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t count = 100000;
+    int      arg   = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (arg + 1 >= argc) break;
+        if (strcmp(argv[arg], "-n") == 0) {
+            count = atoi(argv[++arg]);
+        } else {
+            break;
+        }
+    }
+    if (arg != argc || count == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<yosemitechReading> readings;
+    makeReadings(readings, count);
+    memoryStream stream;
+    bool         ok = true;
+
+    // The fastest of a few runs, to leave out whatever else the computer was doing
+    double encodeBest = 0, decodeBest = 0;
+    for (int r = 0; r < 5; r++) {
+        auto start = std::chrono::steady_clock::now();
+        encode(stream, readings, 8);
+        double seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+                .count();
+        if (r == 0 || seconds < encodeBest) encodeBest = seconds;
+
+        size_t wrong;
+        start = std::chrono::steady_clock::now();
+        decode(stream, readings, wrong);
+        seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+                .count();
+        if (r == 0 || seconds < decodeBest) decodeBest = seconds;
+    }
+    ok = check("sonde", stream, readings) && ok;
+    double encoded = stream.bytes.size();
+
+    // The raw readings are the time, the error code and each value
+    double raw = (double)count * (4 + 1 + 8 * 4);
+    double csv = 0;
+    char   line[160];
+    for (uint32_t k = 0; k < count; k++) {
+        const yosemitechReading& reading = readings[k];
+        csv += snprintf(line, sizeof(line),
+                        "%lu,%u,%.2f,%.1f,%.0f,%.2f,%.1f,%.0f,%.2f,%.0f\n",
+                        (unsigned long)reading.time, reading.errorCode,
+                        reading.values[0], reading.values[1], reading.values[2],
+                        reading.values[3], reading.values[4], reading.values[5],
+                        reading.values[6], reading.values[7]);
+    }
+
+    std::vector<yosemitechReading> odd;
+    makeOddReadings(odd);
+    encode(stream, odd, 3);
+    ok = check("odd value", stream, odd) && ok;
+
+    printf("%u readings of 8 values, once a minute\n\n", count);
+    printf("| Format     | Bytes/reading | Series is smaller by |\n");
+    printf("| ---------- | ------------- | -------------------- |\n");
+    printf("| raw floats | %13.2f | %19.1fx |\n", raw / count, raw / encoded);
+    printf("| CSV        | %13.2f | %19.1fx |\n", csv / count, csv / encoded);
+    printf("| series     | %13.2f | %20s |\n", encoded / count, "");
+    printf("\nEncoding took %.0f ns and decoding %.0f ns a reading\n",
+           encodeBest * 1e9 / count, decodeBest * 1e9 / count);
+    printf("%s\n", ok ? "Every reading decoded exactly" : "Some readings were wrong");
+    return ok ? 0 : 1;
+}
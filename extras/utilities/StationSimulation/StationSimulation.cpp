@@ -0,0 +1,501 @@
+/*****************************************************************************
+StationSimulation.cpp
+
+A command line tool, for a Linux or macOS computer, that runs days of logging
+by a station of simulated sensors in a few seconds.  The sensors are simulated
+in the same program, on a bus that takes as long as a real one at the baud
+rate, and everything keeps time with a yosemitechVirtualClock, so the clock
+jumps ahead whenever the library and the sensors are all waiting.
+
+At every logging interval the station starts every sensor measuring, waits
+for them to stabilize, takes a reading from each and stops them, like the
+GetValues example does for one sensor.  At the end it prints how many readings
+were taken, how long the bus was busy each interval, how long the simulation
+took, and a checksum of every reading and time.  The same options always give
+the same checksum.
+
+With -p the sensors are spread over that many power rails switched by a
+yosemitechPowerManager, and a simulated sensor only answers once its rail has
+been on for its warm up time.  The manager is given each model's warm up and
+stabilization times, and the time each rail was on is printed too.
+
+With -x the last sensors are left off the bus, so they never answer, and with
+-l every command of an interval is given a deadline, so the time spent on the
+bus in an interval stays within a limit however many sensors don't answer.
+
+Usage:
+    StationSimulation [-d days] [-i minutes] [-w seconds] [-n sensors]
+                      [-b baud] [-r delay] [-f rate] [-p rails] [-u ms]
+                      [-x dead] [-l ms]
+
+    -d days     how many days to log (7)
+    -i minutes  the logging interval (15)
+    -w seconds  how long to wait for the sensors to stabilize (22)
+    -n sensors  how many sensors, at slave IDs 1 up, taking the models in
+                turn from Y502 to Y4000 (16)
+    -b baud     the baud rate of the bus (9600)
+    -r delay    how long each sensor takes to answer, in milliseconds (10)
+    -f rate     the chance of every fault of a yosemitechFaultStream on
+                each response (0)
+    -p rails    how many power rails to spread the sensors over, or 0 to
+                keep them all powered (0)
+    -u ms       the warm up time to give the power manager for every sensor,
+                in place of each model's own
+    -x dead     how many of the sensors, counting back from the last, never
+                answer (0)
+    -l ms       the most time to spend on the bus in each interval, not
+                counting the wait for the sensors to stabilize, or 0 for no
+                limit (0); not used with -p
+
+See ReadMe.md for how to build this.
+*****************************************************************************/
+
+// ---------------------------------------------------------------------------
+// Include the base required libraries
+// ---------------------------------------------------------------------------
+// The standard library comes first, before Arduino.h can define min() and max()
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <vector>
+
+#include <Arduino.h>
+#include <YosemitechModbus.h>
+#include <YosemitechClock.h>
+#include <YosemitechFaultStream.h>
+#include <YosemitechPowerManager.h>
+
+// ---------------------------------------------------------------------------
+// The simulated sensors, like the SensorSimulator's
+// ---------------------------------------------------------------------------
+
+// The serial number code and the layout of the values of each model, in the order
+// of yosemitechModel
+struct modelInfo {
+    const char* code;    // the two digits of the serial number that give the model
+    uint16_t    values;  // the register the values start at
+    int         floats;  // the number of float values there
+    bool        error;   // whether an error code register follows the values
+};
+
+static const modelInfo models[] = {
+    {"01", 0x2600, 3, false}, {"01", 0x2600, 3, false}, {"10", 0x2600, 2, true},
+    {"29", 0x2600, 2, true},  {"61", 0x2600, 2, false}, {"48", 0x2600, 2, true},
+    {"00", 0x2600, 2, true},  {"09", 0x2600, 2, true},  {"09", 0x2600, 2, true},
+    {"43", 0x2600, 2, false}, {"00", 0x2600, 2, false}, {"47", 0x2600, 2, true},
+    {"47", 0x2600, 2, true},  {"68", 0x2600, 2, false}, {"24", 0x2600, 3, false},
+    {"38", 0x2601, 8, false},
+};
+static const int modelCount = sizeof(models) / sizeof(models[0]);
+
+// How long each model takes to answer after power up and for its values to stabilize
+// after it starts measuring, in milliseconds, roughly as noted in the GetValues
+// example; in the order of yosemitechModel
+struct powerProfile {
+    uint32_t warmUp;
+    uint32_t stabilization;
+};
+
+static const powerProfile profiles[] = {
+    {300, 8000},   {300, 8000},   {500, 12000},  {500, 22000}, {500, 22000},
+    {500, 22000},  {500, 10000},  {1200, 10000}, {1200, 10000}, {500, 5000},
+    {500, 5000},   {500, 2000},   {500, 22000},  {500, 20000}, {500, 12000},
+    {1200, 22000},
+};
+
+// One simulated sensor and its holding registers
+struct sensor {
+    int                          slaveID;
+    const modelInfo*             model;
+    int                          rail;  // the power rail, or -1 for always powered
+    std::map<uint16_t, uint16_t> registers;
+};
+
+// Puts a float into two registers the way the sensors send them
+static void putFloat(sensor& s, uint16_t reg, float value) {
+    uint8_t bytes[4];
+    memcpy(bytes, &value, 4);
+    s.registers[reg]     = (bytes[0] << 8) | bytes[1];
+    s.registers[reg + 1] = (bytes[2] << 8) | bytes[3];
+}
+
+// Sets up the registers of a new sensor
+static void makeSensor(sensor& s) {
+    char serial[15];
+    snprintf(serial, sizeof(serial), "01%s%02d%08d", s.model->code, s.slaveID,
+             s.slaveID * 1001);
+    bool sonde = s.model == &models[Y4000];
+    for (int i = 0; i < 14; i += 2) {
+        s.registers[(sonde ? 0x1400 : 0x0900) + i / 2] = (serial[i] << 8) |
+            serial[i + 1];
+    }
+    s.registers[0x0700] = 0x0100;  // hardware version 1.00
+    s.registers[0x0701] = 0x0114;  // software version 1.20
+    s.registers[0x0800] = 0;       // the sonde's error code
+    s.registers[0x2E00] = 0;       // read to stop measuring
+}
+
+// Updates the values of a sensor, drifting slowly around a different level for each
+static void updateValues(sensor& s, double seconds) {
+    for (int i = 0; i < s.model->floats; i++) {
+        float value = 10 * (i + 1) + sin(seconds / 3600 + s.slaveID + i);
+        putFloat(s, s.model->values + 2 * i, value);
+    }
+    if (s.model->error) s.registers[s.model->values + 2 * s.model->floats] = 0;
+    putFloat(s, 0x2400, 20 + sin(seconds / 86400));    // temperature
+    putFloat(s, 0x1200, 150 + sin(seconds / 7200));    // potential
+    putFloat(s, 0x2800, 7 + sin(seconds / 43200) / 2);  // pH or NH4
+}
+
+// A bus of simulated sensors on a virtual clock.  Each request takes its time on the
+// line at the baud rate once flushed, and each byte of the response becomes
+// available at the time it would have arrived.
+class simulatedBus : public Stream {
+ public:
+    simulatedBus(yosemitechVirtualClock& clock, uint32_t baud, uint32_t delay)
+        : _clock(clock),
+          _byteTime(10000000 / baud),
+          _delay(delay * 1000),
+          _sent(0) {}
+
+    void addSensor(int slaveID, int model, int rail = -1) {
+        sensor s  = {};
+        s.slaveID = slaveID;
+        s.model   = &models[model];
+        s.rail    = rail;
+        makeSensor(s);
+        _sensors.push_back(s);
+        if (rail >= (int)_railOn.size()) _railOn.resize(rail + 1, -1);
+    }
+
+    // Switches the power of the sensors on a rail
+    void power(int rail, bool on) {
+        _railOn[rail] = on ? (int64_t)_clock.getTime() : -1;
+    }
+
+    size_t write(uint8_t value) override {
+        _request.push_back(value);
+        return 1;
+    }
+    // A request goes out on the line as it is flushed, as with a hardware serial port
+    void flush(void) override {
+        if (_request.empty()) return;
+        _clock.advance((uint64_t)_request.size() * _byteTime);
+        _sent += _request.size();
+        answer();
+        _request.clear();
+    }
+    int available(void) override {
+        uint64_t now   = _clock.getTime();
+        int      ready = 0;
+        for (const arrival& a : _response) {
+            if (a.at > now) {
+                // Nothing waiting should sleep through the next byte
+                if (ready == 0) _clock.wakeAt((uint32_t)a.at);
+                break;
+            }
+            ready++;
+        }
+        return ready;
+    }
+    int read(void) override {
+        if (available() == 0) return -1;
+        uint8_t value = _response.front().value;
+        _response.pop_front();
+        return value;
+    }
+    int peek(void) override {
+        return available() > 0 ? _response.front().value : -1;
+    }
+
+    using Print::write;
+
+    // The bytes sent both ways, for the time the bus was busy
+    uint64_t getBytes(void) {
+        return _sent;
+    }
+    uint32_t getByteTime(void) {
+        return _byteTime;
+    }
+
+ private:
+    struct arrival {
+        uint8_t  value;
+        uint64_t at;
+    };
+
+    void answer(void) {
+        std::vector<uint8_t>& q = _request;
+        if (q.size() < 8) return;
+        uint16_t crc = 0xFFFF;
+        for (uint8_t b : q) { crc = yosemitechFrameParser::crcUpdate(crc, b); }
+        if (crc != 0) return;
+        sensor* target = nullptr;
+        for (sensor& s : _sensors) {
+            if (s.slaveID == q[0]) target = &s;
+        }
+        if (target == nullptr) return;
+
+        // A sensor without power, or still warming up, says nothing
+        if (target->rail >= 0) {
+            int64_t  onAt   = _railOn[target->rail];
+            uint64_t warmUp = profiles[target->model - models].warmUp * 1000ULL;
+            if (onAt < 0 || _clock.getTime() - onAt < warmUp) return;
+        }
+
+        uint8_t  response[260] = {q[0], q[1]};
+        uint16_t reg           = (q[2] << 8) | q[3];
+        uint16_t count         = (q[4] << 8) | q[5];
+        uint16_t length        = 0;
+        bool     refused       = false;
+        if (q[1] == 0x03) {
+            updateValues(*target, _clock.getTime() / 1e6);
+            for (uint16_t i = 0; i < count && !refused; i++) {
+                auto found = target->registers.find(reg + i);
+                refused    = found == target->registers.end();
+                if (refused) break;
+                response[3 + 2 * i] = found->second >> 8;
+                response[4 + 2 * i] = found->second & 0xFF;
+            }
+            response[2] = count * 2;
+            length      = 3 + count * 2;
+        } else if (q[1] == 0x06 || q[1] == 0x10) {
+            memcpy(response + 2, q.data() + 2, 4);
+            length = 6;
+        } else {
+            refused = true;
+        }
+        if (refused) {
+            response[1] |= 0x80;
+            response[2] = 0x02;
+            length      = 3;
+        }
+        crc = 0xFFFF;
+        for (uint16_t i = 0; i < length; i++) {
+            crc = yosemitechFrameParser::crcUpdate(crc, response[i]);
+        }
+        response[length++] = crc & 0xFF;
+        response[length++] = crc >> 8;
+
+        uint64_t at = _clock.getTime() + _delay;
+        for (uint16_t i = 0; i < length; i++) {
+            at += _byteTime;
+            _response.push_back({response[i], at});
+        }
+        _sent += length;
+    }
+
+    yosemitechVirtualClock& _clock;
+    uint32_t                _byteTime;  // microseconds a byte takes on the line
+    uint32_t                _delay;     // microseconds a sensor takes to answer
+    uint64_t                _sent;
+    std::vector<sensor>     _sensors;
+    std::vector<int64_t>    _railOn;  // when each rail was switched on, or -1 if off
+    std::vector<uint8_t>    _request;
+    std::deque<arrival>     _response;
+};
+
+// A power manager switching the rails of the simulated bus
+class simulatedPower : public yosemitechPowerManager {
+ public:
+    explicit simulatedPower(simulatedBus& bus) : _bus(bus) {}
+
+ protected:
+    void switchRail(uint8_t rail, bool on) override {
+        _bus.power(rail, on);
+    }
+
+ private:
+    simulatedBus& _bus;
+};
+
+// Adds bytes to a 64 bit FNV-1a hash
+static void hash(uint64_t& h, const void* data, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < length; i++) {
+        h ^= bytes[i];
+        h *= 0x100000001B3ULL;
+    }
+}
+
+static void usage(const char* name) {
+    fprintf(stderr,
+            "Usage: %s [-d days] [-i minutes] [-w seconds] [-n sensors] [-b baud] "
+            "[-r delay] [-f rate] [-p rails] [-u ms] [-x dead] [-l ms]\n",
+            name);
+}
+
+int main(int argc, char* argv[]) {
+    float    days     = 7;
+    uint32_t interval = 15;
+    uint32_t settle   = 22;
+    int      count    = 16;
+    uint32_t baud     = 9600;
+    uint32_t delay    = 10;
+    float    rate     = 0;
+    int      rails    = 0;
+    int32_t  warmUp   = -1;
+    int      dead     = 0;
+    uint32_t limit    = 0;
+    for (int arg = 1; arg < argc; arg++) {
+        if (arg + 1 >= argc || argv[arg][0] != '-') {
+            usage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++arg];
+        switch (argv[arg - 1][1]) {
+            case 'd': days = atof(value); break;
+            case 'i': interval = atoi(value); break;
+            case 'w': settle = atoi(value); break;
+            case 'n': count = atoi(value); break;
+            case 'b': baud = atoi(value); break;
+            case 'r': delay = atoi(value); break;
+            case 'f': rate = atof(value); break;
+            case 'p': rails = atoi(value); break;
+            case 'u': warmUp = atoi(value); break;
+            case 'x': dead = atoi(value); break;
+            case 'l': limit = atoi(value); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (days <= 0 || interval == 0 || count < 1 || count > 247 || baud == 0 ||
+        rails < 0 || rails > YM_MAX_RAILS || count > YM_MAX_POWERED || dead < 0 ||
+        dead > count) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    yosemitechVirtualClock clock;
+    simulatedBus           bus(clock, baud, delay);
+    yosemitechFaultStream  faulty(bus);
+    faulty.setClock(clock);
+    faulty.setAllFaults(rate);
+    std::vector<yosemitech> sensors(count);
+    simulatedPower          power(bus);
+    for (int r = 0; r < rails; r++) { power.addRail(-1); }
+    for (int i = 0; i < count; i++) {
+        int model = i % modelCount;
+        int rail  = rails > 0 ? i % rails : -1;
+        // A dead sensor is set up in the library but isn't on the bus to answer
+        if (i < count - dead) bus.addSensor(i + 1, model, rail);
+        sensors[i].setClock(clock);
+        sensors[i].begin((yosemitechModel)model, i + 1, faulty);
+        sensors[i].setBaudRate(baud);
+        if (rails > 0) {
+            // A little longer than the sensor needs, unless told otherwise
+            uint32_t wait = warmUp >= 0 ? warmUp : profiles[model].warmUp + 100;
+            power.addSensor(sensors[i], rail, wait, profiles[model].stabilization);
+        }
+    }
+    std::vector<yosemitechReading> powered(count);
+
+    auto     began     = std::chrono::steady_clock::now();
+    uint64_t h         = 0xCBF29CE484222325ULL;
+    uint64_t end       = (uint64_t)(days * 86400e6);
+    uint64_t step      = (uint64_t)interval * 60000000ULL;
+    uint32_t cycles    = 0;
+    uint32_t readings  = 0;
+    uint32_t good      = 0;
+    uint64_t busyTotal = 0;
+    uint64_t busyMax   = 0;
+    uint32_t overruns  = 0;
+    for (uint64_t next = 0; next < end; next += step) {
+        if (next > clock.getTime()) clock.advance(next - clock.getTime());
+        uint64_t start = clock.getTime();
+        uint64_t busy;
+        if (rails > 0) {
+            // The manager waits for each sensor; the whole time the rails are on counts
+            power.takeReadings(powered.data());
+            for (yosemitechReading& reading : powered) {
+                bool ok = reading.values[0] != -9999;  // as getReading() leaves it
+                readings++;
+                if (ok) good++;
+                hash(h, &ok, sizeof(ok));
+                hash(h, &reading.time, sizeof(reading.time));
+                hash(h, reading.values, sizeof(reading.values));
+            }
+            busy = clock.getTime() - start;
+        } else {
+            // The deadline of the starts is the whole limit, and the deadline of the
+            // rest is whatever the starts left of it after the wait
+            uint32_t began = clock.millis();
+            if (limit > 0) {
+                for (yosemitech& sensor : sensors) { sensor.setDeadline(began + limit); }
+            }
+            for (yosemitech& sensor : sensors) { sensor.startMeasurement(); }
+            uint32_t used = clock.millis() - began;
+            clock.delay(settle * 1000);
+            if (limit > 0) {
+                uint32_t left = limit > used ? limit - used : 0;
+                for (yosemitech& sensor : sensors) {
+                    sensor.setDeadline(clock.millis() + left);
+                }
+            }
+            for (yosemitech& sensor : sensors) {
+                yosemitechReading reading;
+                bool              ok = sensor.getReading(reading);
+                readings++;
+                if (ok) good++;
+                hash(h, &ok, sizeof(ok));
+                hash(h, &reading.time, sizeof(reading.time));
+                hash(h, reading.values, sizeof(reading.values));
+            }
+            for (yosemitech& sensor : sensors) { sensor.stopMeasurement(); }
+            if (limit > 0) {
+                for (yosemitech& sensor : sensors) { sensor.clearDeadline(); }
+            }
+            // The time on the bus, leaving out the wait for the sensors to stabilize
+            busy = clock.getTime() - start - settle * 1000000ULL;
+            if (limit > 0 && busy > limit * 1000ULL) overruns++;
+        }
+        busyTotal += busy;
+        if (busy > busyMax) busyMax = busy;
+        cycles++;
+    }
+    uint64_t finished = clock.getTime();
+    hash(h, &finished, sizeof(finished));
+    double took =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+
+    printf("Simulated %.1f days of %d sensors every %u minutes at %u baud\n", days,
+           count, interval, baud);
+    printf("  readings        %u in %u intervals, %.2f%% good\n", readings, cycles,
+           100.0 * good / readings);
+    if (rails > 0) {
+        printf("  powered time    %.1f ms an interval on average, %.1f ms at most\n",
+               busyTotal / 1000.0 / cycles, busyMax / 1000.0);
+        for (int r = 0; r < rails; r++) {
+            printf("  rail %d          %d sensors, on %.1f ms an interval, %.2f%% of "
+                   "the time, %u power ups\n",
+                   r, (count + rails - 1 - r) / rails,
+                   (double)power.getOnTime(r) / cycles,
+                   100.0 * power.getOnTime(r) / (finished / 1000.0),
+                   power.getPowerUps(r));
+        }
+    } else {
+        printf("  bus time        %.1f ms an interval on average, %.1f ms at most\n",
+               busyTotal / 1000.0 / cycles, busyMax / 1000.0);
+        if (limit > 0) {
+            printf("  time limit      %u ms, exceeded in %u intervals\n", limit,
+                   overruns);
+        }
+    }
+    printf("  bytes           %llu, %.3f%% of the time on the line\n",
+           (unsigned long long)bus.getBytes(),
+           100.0 * bus.getBytes() * bus.getByteTime() / finished);
+    uint32_t faults = 0;
+    for (int f = 0; f < YM_FAULT_COUNT; f++) {
+        faults += faulty.getInjected((yosemitechFault)f);
+    }
+    printf("  faults          %u in %u responses\n", faults, faulty.getRequests());
+    printf("  idles           %u\n", clock.getIdles());
+    printf("  took            %.2f s, %.0f times faster than real time\n", took,
+           finished / 1e6 / took);
+    printf("  checksum        %016llx\n", (unsigned long long)h);
+    return 0;
+}
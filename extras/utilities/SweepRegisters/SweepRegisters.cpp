@@ -0,0 +1,210 @@
+/*****************************************************************************
+SweepRegisters.cpp
+
+A command line tool, for a Linux or macOS computer, that maps the readable
+holding registers of a sensor with a yosemitechSweeper and saves the binary
+map to a file, or compares two saved maps with yosemitechSweeper::diff().
+
+It prints how many registers were readable, how many requests the sweep sent,
+how long it spent on the bus and how big the map is.  The differences between
+two maps are printed a register to a line.
+
+Usage:
+    SweepRegisters [-f first] [-l last] [-s span] [-b baud] port slaveID:model
+                   map.bin
+    SweepRegisters -d before.bin after.bin
+
+    -f first  the first register to sweep (0x0000)
+    -l last   the last register to sweep (0x3FFF)
+    -s span   the smallest block of registers to split down to (1)
+    -b baud   the baud rate of a serial port (9600)
+    -d        compare two maps instead
+
+The port is a serial port device, or host:port for a serial device server.
+Comparing exits with 1 if the maps are different.  See ReadMe.md for how to
+build this.
+*****************************************************************************/
+
+// ---------------------------------------------------------------------------
+// Include the base required libraries
+// ---------------------------------------------------------------------------
+// The standard library comes first, before Arduino.h can define min() and max()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include <Arduino.h>
+#include <YosemitechModbus.h>
+#include <YosemitechSerialStream.h>
+#include <YosemitechSweeper.h>
+#include <YosemitechTCPStream.h>
+
+// The names of the models, in the order of yosemitechModel
+static const char* modelNames[] = {"Y502", "Y504", "Y510", "Y511",  "Y513", "Y514",
+                                   "Y516", "Y520", "Y521", "Y532",  "Y533", "Y550",
+                                   "Y551", "Y560", "Y700", "Y4000", nullptr};
+
+// A Stream on a file, for writing a map and reading it back
+class fileStream : public Stream {
+ public:
+    explicit fileStream(FILE* file) : _file(file) {}
+    size_t write(uint8_t value) override {
+        return fputc(value, _file) == EOF ? 0 : 1;
+    }
+    size_t write(const uint8_t* buffer, size_t size) override {
+        return fwrite(buffer, 1, size, _file);
+    }
+    int available() override {
+        int next = peek();
+        return next < 0 ? 0 : 1;
+    }
+    int read() override {
+        return fgetc(_file);
+    }
+    int peek() override {
+        int next = fgetc(_file);
+        if (next != EOF) ungetc(next, _file);
+        return next;
+    }
+    void flush() override {
+        fflush(_file);
+    }
+
+ private:
+    FILE* _file;
+};
+
+// A Print that writes to the standard output
+class stdoutPrint : public Print {
+ public:
+    size_t write(uint8_t value) override {
+        return fputc(value, stdout) == EOF ? 0 : 1;
+    }
+};
+
+// Compares two saved maps and prints the differences
+static int compare(const char* beforePath, const char* afterPath) {
+    FILE* before = fopen(beforePath, "rb");
+    FILE* after  = fopen(afterPath, "rb");
+    if (before == nullptr || after == nullptr) {
+        fprintf(stderr, "Could not open %s\n",
+                before == nullptr ? beforePath : afterPath);
+        if (before != nullptr) fclose(before);
+        if (after != nullptr) fclose(after);
+        return 2;
+    }
+    fileStream  beforeStream(before);
+    fileStream  afterStream(after);
+    stdoutPrint out;
+    bool        same = yosemitechSweeper::diff(beforeStream, afterStream, out);
+    if (same) printf("The maps are the same\n");
+    fclose(before);
+    fclose(after);
+    return same ? 0 : 1;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr,
+            "Usage: %s [-f first] [-l last] [-s span] [-b baud] port slaveID:model "
+            "map.bin\n"
+            "       %s -d before.bin after.bin\n",
+            name, name);
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t first = 0x0000;
+    uint32_t last  = 0x3FFF;
+    int      span  = 1;
+    uint32_t baud  = 9600;
+    int      arg   = 1;
+    if (argc == 4 && strcmp(argv[1], "-d") == 0) return compare(argv[2], argv[3]);
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (arg + 1 >= argc) break;
+        if (strcmp(argv[arg], "-f") == 0) {
+            first = strtoul(argv[++arg], nullptr, 0);
+        } else if (strcmp(argv[arg], "-l") == 0) {
+            last = strtoul(argv[++arg], nullptr, 0);
+        } else if (strcmp(argv[arg], "-s") == 0) {
+            span = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-b") == 0) {
+            baud = atoi(argv[++arg]);
+        } else {
+            break;
+        }
+    }
+    if (argc - arg != 3 || first > last || last > 0xFFFE || span < 1 || span > 125 ||
+        baud == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    const char* port    = argv[arg];
+    const char* colon   = strchr(argv[arg + 1], ':');
+    int         slaveID = (int)strtol(argv[arg + 1], nullptr, 0);
+    int         model   = -1;
+    for (int m = 0; colon != nullptr && modelNames[m] != nullptr; m++) {
+        if (strcmp(colon + 1, modelNames[m]) == 0) model = m;
+    }
+    if (model < 0 || slaveID < 1 || slaveID > 247) {
+        fprintf(stderr, "Not a sensor: %s\n", argv[arg + 1]);
+        usage(argv[0]);
+        return 2;
+    }
+    const char* path = argv[arg + 2];
+
+    // A port with a colon in it is on a device server
+    Stream*                 bus    = nullptr;
+    yosemitechSerialStream* serial = nullptr;
+    yosemitechTCPStream*    tcp    = nullptr;
+    std::string             host(port);
+    size_t                  split = host.rfind(':');
+    if (split != std::string::npos) {
+        host.resize(split);
+        tcp = new yosemitechTCPStream(host.c_str(), atoi(port + split + 1));
+        if (!tcp->begin()) {
+            fprintf(stderr, "Could not connect to %s\n", port);
+            return 2;
+        }
+        bus = tcp;
+    } else {
+        serial = new yosemitechSerialStream(port);
+        if (!serial->begin(baud)) {
+            fprintf(stderr, "Could not open %s at %u baud\n", port, baud);
+            return 2;
+        }
+        bus = serial;
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        fprintf(stderr, "Could not create %s\n", path);
+        return 2;
+    }
+    yosemitech sensor;
+    sensor.begin((yosemitechModel)model, slaveID, *bus);
+    sensor.setBaudRate(baud);
+    sensor.resetStats();
+
+    fileStream        map(file);
+    yosemitechSweeper sweeper(sensor);
+    uint32_t          start = millis();
+    bool              whole = sweeper.sweep(first, last, map, span);
+    uint32_t          took  = millis() - start;
+    long              size  = ftell(file);
+    fclose(file);
+
+    uint32_t swept = last - first + 1;
+    printf("Swept 0x%04X to 0x%04X of 0x%02X:%s%s\n", first, last, slaveID,
+           modelNames[model], whole ? "" : ", stopped early");
+    printf("  readable registers  %u of %u\n", sweeper.getReadableRegisters(), swept);
+    printf("  requests            %u (%.2f a register)\n", sweeper.getRequests(),
+           (double)sweeper.getRequests() / swept);
+    printf("  bus time            %.1f s (%.1f s in all)\n",
+           sensor.getStats().busTime / 1000.0, took / 1000.0);
+    printf("  map                 %ld bytes in %s\n", size, path);
+
+    delete serial;
+    delete tcp;
+    return whole ? 0 : 1;
+}
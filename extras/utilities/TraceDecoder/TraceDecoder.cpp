@@ -0,0 +1,118 @@
+/*****************************************************************************
+TraceDecoder.cpp
+
+A command line tool, for a Linux, macOS or Windows computer, that turns binary
+transaction traces dumped with yosemitechTrace::dump() into a readable log.
+
+It reads one or more dumps from a file (or from standard input), skipping
+anything between them, so a whole serial capture can be decoded in one go.
+
+Usage:
+    TraceDecoder [trace.bin]
+
+This uses only the C++ standard library; build it with, for example:
+    c++ -std=c++11 -o TraceDecoder TraceDecoder.cpp
+*****************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// The size of one record in a version 1 dump
+static const int recordSize = 12;
+
+// Gets a little-endian number from a buffer
+static uint32_t fromLE(const uint8_t* bytes, int length) {
+    uint32_t value = 0;
+    for (int i = length - 1; i >= 0; i--) { value = (value << 8) | bytes[i]; }
+    return value;
+}
+
+// Names a modbus function code
+static const char* opName(uint8_t op) {
+    switch (op) {
+        case 0x03: return "read";
+        case 0x04: return "read input";
+        case 0x06: return "write one";
+        case 0x10: return "write";
+        default: return "other";
+    }
+}
+
+// Names a yosemitechError
+static const char* resultName(uint8_t result) {
+    switch (result) {
+        case 0x00: return "ok";
+        case 0x01: return "illegal function";
+        case 0x02: return "illegal data address";
+        case 0x03: return "illegal data value";
+        case 0x04: return "slave device failure";
+        case 0x05: return "acknowledge";
+        case 0x06: return "slave device busy";
+        case 0x07: return "negative acknowledge";
+        case 0x08: return "memory parity error";
+        case 0x0A: return "gateway path unavailable";
+        case 0x0B: return "gateway target failed";
+        case 0xE0: return "no response";
+        case 0xE1: return "deadline expired";
+        default: return "unknown error";
+    }
+}
+
+// Decodes one dump, returning false at the end of the input
+static bool decodeDump(FILE* in, int dumpNumber) {
+    // Skip anything before the start of the dump, like text printed by a sketch
+    uint8_t header[12] = {0};
+    int     c;
+    while (memcmp(header, "YTRC", 4) != 0) {
+        if ((c = fgetc(in)) == EOF) return false;
+        memmove(header, header + 1, 3);
+        header[3] = c;
+    }
+    if (fread(header + 4, 1, 8, in) != 8) return false;
+    if (header[4] != 0x01 || header[5] != recordSize) {
+        fprintf(stderr, "Dump %d: unknown trace version %d\n", dumpNumber, header[4]);
+        return false;
+    }
+    uint16_t count   = fromLE(header + 6, 2);
+    uint32_t dropped = fromLE(header + 8, 4);
+
+    printf("# dump %d: %u transactions", dumpNumber, count);
+    if (dropped > 0) printf(", %lu older ones overwritten", (unsigned long)dropped);
+    printf("\n");
+
+    uint8_t record[recordSize];
+    for (uint16_t i = 0; i < count; i++) {
+        if (fread(record, 1, recordSize, in) != (size_t)recordSize) {
+            fprintf(stderr, "Dump %d: cut short after %u records\n", dumpNumber, i);
+            return false;
+        }
+        uint32_t time    = fromLE(record, 4);
+        uint8_t  op      = record[4];
+        uint8_t  slaveID = record[5];
+        uint16_t regNum  = fromLE(record + 6, 2);
+        uint8_t  length  = record[8];
+        uint8_t  result  = record[9];
+        uint16_t latency = fromLE(record + 10, 2);
+
+        printf("%10lu.%03lu  slave 0x%02X  %-10s (0x%02X)  0x%04X x%-3u  ",
+               (unsigned long)time / 1000, (unsigned long)time % 1000, slaveID,
+               opName(op), op, regNum, length);
+        printf("%5u ms  %s\n", latency, resultName(result));
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    FILE* in = argc > 1 ? fopen(argv[1], "rb") : stdin;
+    if (in == nullptr) {
+        fprintf(stderr, "Could not open %s\n", argv[1]);
+        return 2;
+    }
+    int dumps = 0;
+    while (decodeDump(in, dumps + 1)) { dumps++; }
+    if (in != stdin) fclose(in);
+    return dumps > 0 ? 0 : 1;
+}
+
+// cspell: ignore YTRC
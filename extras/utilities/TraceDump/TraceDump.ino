@@ -0,0 +1,86 @@
+/*****************************************************************************
+TraceDump.ino
+
+This polls a Yosemitech sensor with transaction tracing turned on and dumps
+the binary trace to the serial monitor whenever a 'd' is sent to the board.
+Capture the serial output to a file and turn it into a readable log with the
+TraceDecoder utility.
+
+At start up it also measures how long recording one transaction takes on this
+board, which is all tracing adds to each transaction.
+
+Tracing must be turned on for the whole build, not just this sketch, by
+defining YM_TRACE - for example with `build_flags = -D YM_TRACE` in
+PlatformIO.
+*****************************************************************************/
+
+// ---------------------------------------------------------------------------
+// Include the base required libraries
+// ---------------------------------------------------------------------------
+#include <Arduino.h>
+#include <YosemitechModbus.h>
+
+#ifndef YM_TRACE
+#error Define YM_TRACE for the whole build to use this sketch
+#endif
+
+// ---------------------------------------------------------------------------
+// Set up the sensor specific information
+//   ie, pin locations, addresses, calibrations and related settings
+// ---------------------------------------------------------------------------
+
+// Define the sensor type
+yosemitechModel model = Y511;  // The sensor model number
+
+// Define the sensor's modbus address
+byte modbusAddress = 0x01;  // Yosemitech ships sensors with a default ID of 0x01.
+
+// Define pin number variables
+const int DEREPin = -1;  // The pin controlling Receive Enable and Driver Enable
+                         // on the RS485 adapter, if applicable (else, -1)
+
+// Use the second hardware serial port for modbus
+#define modbusSerial Serial1
+
+// Construct the Yosemitech modbus instance
+yosemitech sensor;
+
+// ---------------------------------------------------------------------------
+// Main setup function
+// ---------------------------------------------------------------------------
+void setup() {
+    Serial.begin(115200);
+    modbusSerial.begin(9600);
+
+    Serial.println(F("TraceDump.ino"));
+
+    // Time recording a batch of transactions, then throw them away
+    const uint16_t timedRecords = 1000;
+    uint32_t       start        = micros();
+    for (uint16_t i = 0; i < timedRecords; i++) {
+        yosemitechTrace::transaction(0x03, modbusAddress, i, 1, YM_SUCCESS, millis());
+    }
+    uint32_t elapsed = micros() - start;
+    yosemitechTrace::clear();
+    Serial.print(F("Recording a transaction takes "));
+    Serial.print((float)elapsed / timedRecords, 2);
+    Serial.println(F(" microseconds"));
+
+    sensor.begin(model, modbusAddress, &modbusSerial, DEREPin);
+    sensor.setBaudRate(9600);
+    sensor.startMeasurement();
+    Serial.println(F("Send 'd' to dump the trace"));
+}
+
+// ---------------------------------------------------------------------------
+// Main loop function
+// ---------------------------------------------------------------------------
+void loop() {
+    float parmValue, tempValue, thirdValue;
+    sensor.getValues(parmValue, tempValue, thirdValue);
+
+    while (Serial.available()) {
+        if (Serial.read() == 'd') yosemitechTrace::dump(Serial);
+    }
+    delay(2000);
+}
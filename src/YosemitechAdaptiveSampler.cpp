@@ -0,0 +1,126 @@
+/**
+ * @file YosemitechAdaptiveSampler.cpp
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the adaptive sampler definitions.
+ */
+
+#include "YosemitechAdaptiveSampler.h"
+
+// The weight of each new value in the running mean and variance
+#define YM_SAMPLER_WEIGHT 0.25f
+
+
+yosemitechAdaptiveSampler::yosemitechAdaptiveSampler(yosemitech& sensor,
+                                                     uint32_t    minInterval,
+                                                     uint32_t    maxInterval)
+    : _sensor(sensor),
+      _minInterval(minInterval),
+      _maxInterval(maxInterval < minInterval ? minInterval : maxInterval),
+      _interval(minInterval),
+      _rateThreshold(0),
+      _varianceThreshold(0),
+      _channel(0),
+      _polled(false),
+      _readings(0),
+      _firstTime(0),
+      _lastTime(0),
+      _lastPoll(0),
+      _lastValue(0),
+      _mean(0),
+      _variance(0) {}
+
+
+void yosemitechAdaptiveSampler::setThresholds(float rateThreshold,
+                                              float varianceThreshold) {
+    _rateThreshold     = rateThreshold;
+    _varianceThreshold = varianceThreshold;
+}
+
+
+void yosemitechAdaptiveSampler::setChannel(uint8_t index) {
+    _channel = index < YM_MAX_VALUES ? index : 0;
+}
+
+
+// This times the interval from the last poll, not the last good reading, so a sensor
+// that fails or has no value isn't polled again straight away
+bool yosemitechAdaptiveSampler::due(void) {
+    return !_polled || _sensor.getClock().millis() - _lastPoll >= _interval;
+}
+
+
+bool yosemitechAdaptiveSampler::poll(yosemitechReading& reading) {
+    if (!due()) return false;
+    if (!_sensor.getReading(reading)) {
+        // Don't hammer a sensor that isn't answering; try again in one interval, but
+        // keep the time of the last reading for the next rate of change
+        _polled   = true;
+        _lastPoll = _sensor.getClock().millis();
+        return false;
+    }
+    update(reading);
+    return true;
+}
+
+
+// This halves the interval when the value is moving and stretches it by a quarter
+// when it is steady, so the rate climbs fast and falls back slowly.  The first
+// reading starts at the fastest rate until there is a history to judge by.
+void yosemitechAdaptiveSampler::update(const yosemitechReading& reading) {
+    _polled     = true;
+    _lastPoll   = reading.time;
+    float value = reading.values[_channel];
+    if (value == -9999) return;  // the sensor had no value to give
+
+    if (_readings == 0) {
+        _firstTime = reading.time;
+        _mean      = value;
+        _variance  = 0;
+    } else {
+        uint32_t elapsed = reading.time - _lastTime;
+        float    rate    = elapsed > 0 ? (value - _lastValue) * 1000.0f / elapsed : 0;
+        if (rate < 0) rate = -rate;
+
+        // Exponentially weighted running mean and variance
+        float deviation = value - _mean;
+        _mean += YM_SAMPLER_WEIGHT * deviation;
+        _variance = (1 - YM_SAMPLER_WEIGHT) *
+            (_variance + YM_SAMPLER_WEIGHT * deviation * deviation);
+
+        bool changing = (_rateThreshold > 0 && rate >= _rateThreshold) ||
+            (_varianceThreshold > 0 && _variance >= _varianceThreshold);
+        if (changing) {
+            _interval /= 2;
+            if (_interval < _minInterval) _interval = _minInterval;
+        } else {
+            _interval += _interval / 4 + 1;
+            if (_interval > _maxInterval) _interval = _maxInterval;
+        }
+    }
+    _readings++;
+    _lastTime  = reading.time;
+    _lastValue = value;
+}
+
+
+uint32_t yosemitechAdaptiveSampler::getInterval(void) {
+    return _interval;
+}
+
+
+uint32_t yosemitechAdaptiveSampler::getReadings(void) {
+    return _readings;
+}
+
+
+// Polling at the minimum interval would have taken one reading at the start and one
+// every interval after it
+uint32_t yosemitechAdaptiveSampler::getSaved(void) {
+    if (_readings == 0 || _minInterval == 0) return 0;
+    uint32_t fixedRate = (_lastTime - _firstTime) / _minInterval + 1;
+    return fixedRate > _readings ? fixedRate - _readings : 0;
+}
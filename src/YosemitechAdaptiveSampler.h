@@ -0,0 +1,137 @@
+/**
+ * @file YosemitechAdaptiveSampler.h
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the adaptive sampler declarations, used to poll a sensor faster
+ * when its values are changing and slower when they are steady.
+ */
+
+#ifndef YosemitechAdaptiveSampler_h
+#define YosemitechAdaptiveSampler_h
+
+#include "YosemitechModbus.h"
+
+/**
+ * @brief Polls a sensor at a rate that follows how fast one of its values changes.
+ *
+ * After each reading the sampler looks at the rate of change of the watched value
+ * since the last reading and at a running variance of the value.  If either is over
+ * its threshold the polling interval is halved (down to the minimum interval);
+ * otherwise it is stretched by a quarter (up to the maximum).  A storm is picked up
+ * within a couple of readings, and a steady sensor drifts back to the slow rate.
+ *
+ * @code{.cpp}
+ * // Turbidity, polled every 10 s to 15 min, faster when it moves 0.5 NTU/s or more
+ * yosemitechAdaptiveSampler sampler(sensor, 10000, 900000);
+ * sampler.setThresholds(0.5, 4.0);
+ *
+ * yosemitechReading reading;
+ * if (sampler.poll(reading)) logReading(reading);
+ * @endcode
+ *
+ * The decision is separate from the bus, so recorded readings can be replayed
+ * through update() to tune the thresholds before deploying them.
+ */
+class yosemitechAdaptiveSampler {
+
+ public:
+    /**
+     * @brief Constructs a new adaptive sampler for a sensor.
+     *
+     * @param sensor The sensor to poll; it must already be started with begin() and
+     * measuring.
+     * @param minInterval The fastest polling interval in milliseconds
+     * @param maxInterval The slowest polling interval in milliseconds
+     */
+    yosemitechAdaptiveSampler(yosemitech& sensor, uint32_t minInterval,
+                              uint32_t maxInterval);
+
+    /**
+     * @brief Sets when to speed up polling.
+     *
+     * @param rateThreshold The rate of change of the watched value, in its units per
+     * second, at or above which polling speeds up
+     * @param varianceThreshold The running variance of the watched value, in its
+     * units squared, at or above which polling speeds up.  Optional with a default
+     * value of 0, to only use the rate of change.
+     */
+    void setThresholds(float rateThreshold, float varianceThreshold = 0);
+
+    /**
+     * @brief Chooses the value to watch.
+     *
+     * @param index The position of the value in a #yosemitechReading.  Optional with
+     * a default value of 0, the main "parameter" value.
+     */
+    void setChannel(uint8_t index = 0);
+
+    /**
+     * @brief Checks whether the next reading is due.
+     *
+     * @return *bool* True if the polling interval has passed since the last poll,
+     * whether or not it got a value.
+     */
+    bool due(void);
+
+    /**
+     * @brief Reads the sensor if the next reading is due and adjusts the interval.
+     *
+     * @param reading The reading to fill in
+     * @return *bool* True if a new reading was taken, false if it wasn't due or the
+     * sensor didn't answer.
+     */
+    bool poll(yosemitechReading& reading);
+
+    /**
+     * @brief Adjusts the polling interval for a new reading.
+     *
+     * poll() calls this itself; call it directly to replay recorded readings.
+     *
+     * @param reading The reading
+     */
+    void update(const yosemitechReading& reading);
+
+    /**
+     * @brief Gets the current polling interval.
+     *
+     * @return *uint32_t* The interval in milliseconds
+     */
+    uint32_t getInterval(void);
+
+    /**
+     * @brief Gets the number of readings taken.
+     *
+     * @return *uint32_t* The number of readings
+     */
+    uint32_t getReadings(void);
+
+    /**
+     * @brief Gets the number of readings saved compared to always polling at the
+     * minimum interval over the same time.
+     *
+     * @return *uint32_t* The number of readings saved
+     */
+    uint32_t getSaved(void);
+
+ private:
+    yosemitech& _sensor;             ///< The sensor being polled
+    uint32_t    _minInterval;        ///< The fastest polling interval
+    uint32_t    _maxInterval;        ///< The slowest polling interval
+    uint32_t    _interval;           ///< The current polling interval
+    float       _rateThreshold;      ///< The rate of change that speeds up polling
+    float       _varianceThreshold;  ///< The variance that speeds up polling
+    uint8_t     _channel;            ///< The value being watched
+    bool        _polled;             ///< Whether the sensor has been polled yet
+    uint32_t    _readings;           ///< Readings taken
+    uint32_t    _firstTime;          ///< The time of the first reading
+    uint32_t    _lastTime;           ///< The time of the last reading
+    uint32_t    _lastPoll;           ///< The time of the last poll, even a failed one
+    float       _lastValue;          ///< The last value
+    float       _mean;               ///< A running mean of the value
+    float       _variance;           ///< A running variance of the value
+};
+
+#endif
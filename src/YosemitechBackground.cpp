@@ -0,0 +1,95 @@
+/**
+ * @file YosemitechBackground.cpp
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the background acquisition definitions.
+ */
+
+#include "YosemitechBackground.h"
+
+// The sequence counter works like a seqlock around a pair of buffers.  Publishing
+// reading k (counting from 0) makes the counter odd (2k + 1), fills buffer
+// (k + 1) % 2, and makes it even again (2k + 2).  At any count s the front buffer
+// is (s / 2) % 2 and a reader can copy it while the back buffer is being filled;
+// the front buffer is only overwritten once the counter passes (s & ~1) + 2.
+// Until the first publish the front buffer is empty, with no values.
+
+
+yosemitechBackground::yosemitechBackground(yosemitech& sensor, uint32_t interval)
+    : _sensor(sensor),
+      _interval(interval),
+      _lastPoll(0),
+      _polled(false),
+      _sequence(0) {
+    _buffers[0].numValues = 0;
+    _buffers[1].numValues = 0;
+}
+
+
+void yosemitechBackground::setInterval(uint32_t interval) {
+    _interval = interval;
+}
+
+
+// This reads the sensor once the interval has passed since the last read
+bool yosemitechBackground::poll(void) {
+    if (_polled && _sensor.getClock().millis() - _lastPoll < _interval) return false;
+    _lastPoll = _sensor.getClock().millis();
+    _polled   = true;
+    yosemitechReading reading;
+    if (!_sensor.getReading(reading)) return false;
+    publish(reading);
+    return true;
+}
+
+
+// This fills the back buffer and then flips it to the front
+void yosemitechBackground::publish(const yosemitechReading& reading) {
+    yosemitechSequence sequence = _sequence;  // only the publisher changes it
+    __atomic_store_n(&_sequence, (yosemitechSequence)(sequence + 1), __ATOMIC_RELAXED);
+    // Keep the buffer writes from being seen before the counter went odd
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    _buffers[((sequence >> 1) + 1) & 1] = reading;
+    __atomic_store_n(&_sequence, (yosemitechSequence)(sequence + 2), __ATOMIC_RELEASE);
+}
+
+
+// This copies the front buffer, trying again if it was overwritten while copying
+bool yosemitechBackground::read(yosemitechReading& reading) {
+    yosemitechSequence before, after;
+    do {
+        before  = __atomic_load_n(&_sequence, __ATOMIC_ACQUIRE);
+        reading = _buffers[(before >> 1) & 1];
+        // Keep the copy from being read after the counter is checked again
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&_sequence, __ATOMIC_RELAXED);
+    } while ((yosemitechSequence)(after - (before & ~1)) > 2);
+    return reading.numValues != 0;
+}
+
+
+float yosemitechBackground::getValue(void) {
+    yosemitechReading reading;
+    if (!read(reading)) return -9999;
+    return reading.values[0];
+}
+
+
+// The sonde returns temperature fifth; every other sensor returns it second
+float yosemitechBackground::getTemperatureValue(void) {
+    yosemitechReading reading;
+    if (!read(reading)) return -9999;
+    return reading.values[reading.numValues == 8 ? 4 : 1];
+}
+
+
+uint32_t yosemitechBackground::getAge(void) {
+    yosemitechReading reading;
+    if (!read(reading)) return UINT32_MAX;
+    return _sensor.getClock().millis() - reading.time;
+}
+
+// cspell: ignore seqlock
@@ -0,0 +1,126 @@
+/**
+ * @file YosemitechBackground.h
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the background acquisition declarations, used to read the latest
+ * values of a sensor without waiting on the bus.
+ */
+
+#ifndef YosemitechBackground_h
+#define YosemitechBackground_h
+
+#include "YosemitechModbus.h"
+
+/**
+ * @brief The type of the snapshot sequence counter.
+ *
+ * The counter is loaded and stored atomically, so on 8-bit AVR boards, which can only
+ * do that for single bytes, it is one byte.
+ */
+#ifdef __AVR__
+typedef uint8_t yosemitechSequence;
+#else
+typedef uint32_t yosemitechSequence;
+#endif
+
+/**
+ * @brief Polls a sensor in the background and keeps its latest reading where any
+ * number of readers can get it without touching the bus.
+ *
+ * One context (a thread, a task, or just the main loop) calls poll() as often as it
+ * likes; it reads the sensor whenever the polling interval has passed.  New readings
+ * are written into the back one of two buffers and then published by flipping the
+ * buffers and bumping a sequence counter.  Readers copy the front buffer and check
+ * the counter didn't move too far while they did, so they never wait on the bus or
+ * a lock and get a consistent reading in the time it takes to copy it.
+ *
+ * @code{.cpp}
+ * yosemitechBackground background(sensor, 2000);
+ *
+ * // in the polling thread, task, or loop()
+ * background.poll();
+ *
+ * // anywhere else
+ * float turbidity = background.getValue();
+ * @endcode
+ */
+class yosemitechBackground {
+
+ public:
+    /**
+     * @brief Constructs a new background poller for a sensor.
+     *
+     * @param sensor The sensor to poll; it must already be started with begin() and
+     * measuring.
+     * @param interval The time between readings in milliseconds.  Optional with a
+     * default value of 0, to read as fast as the sensor answers.
+     */
+    explicit yosemitechBackground(yosemitech& sensor, uint32_t interval = 0);
+
+    /**
+     * @brief Changes the time between readings.
+     *
+     * @param interval The time between readings in milliseconds
+     */
+    void setInterval(uint32_t interval);
+
+    /**
+     * @brief Reads the sensor if the polling interval has passed; only ever call this
+     * from one context.
+     *
+     * @return *bool* True if a new reading was published, false if it wasn't time or
+     * the sensor didn't answer.
+     */
+    bool poll(void);
+
+    /**
+     * @brief Publishes a reading taken somewhere else; only ever call this from the
+     * same context as poll().
+     *
+     * @param reading The reading to publish
+     */
+    void publish(const yosemitechReading& reading);
+
+    /**
+     * @brief Gets the latest reading.  Safe from any context.
+     *
+     * @param reading The reading to fill in
+     * @return *bool* True if there has been a reading, false if not.
+     */
+    bool read(yosemitechReading& reading);
+
+    /**
+     * @brief Gets the main "parameter" value of the latest reading.
+     *
+     * @return *float* The value, or -9999 if there hasn't been a reading.
+     */
+    float getValue(void);
+
+    /**
+     * @brief Gets the temperature of the latest reading.
+     *
+     * @return *float* The temperature, or -9999 if there hasn't been a reading.
+     */
+    float getTemperatureValue(void);
+
+    /**
+     * @brief Gets how long ago the latest reading was taken.
+     *
+     * @return *uint32_t* The age of the reading in milliseconds, or UINT32_MAX if
+     * there hasn't been a reading.
+     */
+    uint32_t getAge(void);
+
+ private:
+    yosemitech&        _sensor;      ///< The sensor being polled
+    uint32_t           _interval;    ///< The time between readings
+    uint32_t           _lastPoll;    ///< When the sensor was last read
+    bool               _polled;      ///< Whether the sensor has been read at all
+    yosemitechSequence _sequence;    ///< Bumped before and after every publish
+    yosemitechReading  _buffers[2];  ///< The front and back readings
+};
+
+#endif
@@ -0,0 +1,191 @@
+/**
+ * @file YosemitechClock.cpp
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the definitions of the system, virtual and sleeping clocks.
+ */
+
+#include "YosemitechClock.h"
+#include "YosemitechModbus.h"
+
+#ifdef YM_HOST_BUILD
+#include <unistd.h>
+#endif
+
+
+yosemitechClock yosemitechClock::system;
+
+
+uint32_t yosemitechClock::millis(void) {
+    return ::millis();
+}
+
+
+uint32_t yosemitechClock::micros(void) {
+    return ::micros();
+}
+
+
+void yosemitechClock::delay(uint32_t ms) {
+    ::delay(ms);
+}
+
+
+// This splits the wait so delayMicroseconds() never gets more than 16 bits on AVR
+void yosemitechClock::delayMicroseconds(uint32_t us) {
+    ::delay(us / 1000);
+    ::delayMicroseconds(us % 1000);
+}
+
+
+// On a computer this sleeps for at most a millisecond, so a waiting tool doesn't keep
+// a core busy; on a board it does nothing, and waiting is busy polling
+void yosemitechClock::idle(uint32_t us) {
+#ifdef YM_HOST_BUILD
+    usleep(us < 1000 ? us : 1000);
+#else
+    (void)us;
+#endif
+}
+
+
+void yosemitechClock::wakeAt(uint32_t) {}
+
+
+yosemitechVirtualClock::yosemitechVirtualClock(uint64_t start)
+    : _now(start),
+      _wake(0),
+      _idles(0) {}
+
+
+uint32_t yosemitechVirtualClock::millis(void) {
+    return (uint32_t)(_now / 1000);
+}
+
+
+uint32_t yosemitechVirtualClock::micros(void) {
+    return (uint32_t)_now;
+}
+
+
+void yosemitechVirtualClock::delay(uint32_t ms) {
+    advance((uint64_t)ms * 1000);
+}
+
+
+void yosemitechVirtualClock::delayMicroseconds(uint32_t us) {
+    advance(us);
+}
+
+
+// This jumps to the earliest wake up, unless the loop would give up first.  A loop
+// that could wait no time at all still moves the time on, so it can't spin forever.
+void yosemitechVirtualClock::idle(uint32_t us) {
+    _idles++;
+    uint64_t until = _now + (us > 0 ? us : 1);
+    if (_wake > _now && _wake < until) until = _wake;
+    advance(until - _now);
+}
+
+
+// This works out the full time from micros(), which can have rolled over, taking the
+// closest time to now
+void yosemitechVirtualClock::wakeAt(uint32_t us) {
+    uint64_t at = _now + (int32_t)(us - (uint32_t)_now);
+    if (at <= _now) return;
+    if (_wake <= _now || at < _wake) _wake = at;
+}
+
+
+void yosemitechVirtualClock::advance(uint64_t us) {
+    _now += us;
+    if (_wake <= _now) _wake = 0;
+}
+
+
+uint64_t yosemitechVirtualClock::getTime(void) {
+    return _now;
+}
+
+
+uint32_t yosemitechVirtualClock::getIdles(void) {
+    return _idles;
+}
+
+
+yosemitechSleepClock::yosemitechSleepClock(yosemitechSleepFunction sleep,
+                                           uint32_t                minSleep)
+    : _sleep(sleep),
+      _minSleep(minSleep) {
+    startCycle();
+}
+
+
+// This sleeps at most an hour at a time, so the time fits in microseconds, and
+// finishes with a busy wait once what is left is too short to sleep through
+void yosemitechSleepClock::delay(uint32_t ms) {
+    uint32_t start = millis();
+    uint32_t elapsed;
+    while ((elapsed = millis() - start) < ms) {
+        uint32_t left = ms - elapsed;
+        if (left > 3600000UL) left = 3600000UL;
+        if (left * 1000 < _minSleep) {
+            yosemitechClock::delay(left);
+            return;
+        }
+        sleep(left * 1000);
+    }
+}
+
+
+void yosemitechSleepClock::delayMicroseconds(uint32_t us) {
+    uint32_t start = micros();
+    uint32_t elapsed;
+    while ((elapsed = micros() - start) < us) {
+        if (us - elapsed < _minSleep) {
+            yosemitechClock::delayMicroseconds(us - elapsed);
+            return;
+        }
+        sleep(us - elapsed);
+    }
+}
+
+
+// This only sleeps when the loop could wait long enough; the sleep function must wake
+// when a byte arrives, which is what the loop is waiting for
+void yosemitechSleepClock::idle(uint32_t us) {
+    if (us >= _minSleep) sleep(us);
+}
+
+
+void yosemitechSleepClock::startCycle(void) {
+    _cycleStart = millis();
+    _asleep     = 0;
+    _sleeps     = 0;
+}
+
+
+uint32_t yosemitechSleepClock::getAsleep(void) {
+    return (uint32_t)(_asleep / 1000);
+}
+
+
+uint32_t yosemitechSleepClock::getAwake(void) {
+    return millis() - _cycleStart - getAsleep();
+}
+
+
+uint32_t yosemitechSleepClock::getSleeps(void) {
+    return _sleeps;
+}
+
+
+void yosemitechSleepClock::sleep(uint32_t us) {
+    uint32_t start = micros();
+    _sleep(us);
+    _asleep += micros() - start;
+    _sleeps++;
+}
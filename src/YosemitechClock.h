@@ -0,0 +1,244 @@
+/**
+ * @file YosemitechClock.h
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the declarations of the clock the library keeps time with, of a
+ * virtual clock for simulations that run faster than real time, and of a clock that
+ * sleeps while it waits.
+ */
+
+#ifndef YosemitechClock_h
+#define YosemitechClock_h
+
+#include <Arduino.h>
+
+/**
+ * @brief The clock a sensor object and its stream keep time with.
+ *
+ * This one is the board's own clock: millis(), micros(), delay() and
+ * delayMicroseconds().  A waiting loop calls idle() every time round, which does
+ * nothing on a board, so waiting is the same busy polling as always.  On a host
+ * build it sleeps for up to a millisecond, so a tool waiting on a sensor doesn't
+ * keep a core busy.
+ *
+ * A subclass can keep a different time, like #yosemitechVirtualClock.
+ */
+class yosemitechClock {
+
+ public:
+    virtual ~yosemitechClock() {}
+
+    /**
+     * @brief Gets the time in milliseconds, like millis().
+     *
+     * @return *uint32_t* The time in milliseconds
+     */
+    virtual uint32_t millis(void);
+    /**
+     * @brief Gets the time in microseconds, like micros().
+     *
+     * @return *uint32_t* The time in microseconds
+     */
+    virtual uint32_t micros(void);
+    /**
+     * @brief Waits, like delay().
+     *
+     * @param ms The time to wait in milliseconds
+     */
+    virtual void delay(uint32_t ms);
+    /**
+     * @brief Waits, like delayMicroseconds(), but for any length of time.
+     *
+     * @param us The time to wait in microseconds
+     */
+    virtual void delayMicroseconds(uint32_t us);
+    /**
+     * @brief Called by a loop that is waiting on something else to happen, like a
+     * byte arriving, and has nothing to do for at most a while.
+     *
+     * @param us The longest the loop could wait, in microseconds, before it gives up
+     */
+    virtual void idle(uint32_t us);
+    /**
+     * @brief Called by something that will have something to do at a given time, like
+     * a simulated sensor with a response on the way, so that nothing waiting sleeps
+     * through it.  Only a virtual clock takes any notice.
+     *
+     * @param us The value of micros() when it will
+     */
+    virtual void wakeAt(uint32_t us);
+
+    /**
+     * @brief The board's own clock, which every sensor object uses unless it is given
+     * another.
+     */
+    static yosemitechClock system;
+};
+
+
+/**
+ * @brief A clock that only moves when something waits for it, for simulations that
+ * run much faster than real time and give the same timings every time.
+ *
+ * A delay moves the time forward straight away.  When a loop idles, the time jumps to
+ * the earliest wake up anything has asked for since the last time it moved, or by as
+ * long as the loop could wait if that comes first.  As long as everything on the
+ * simulated bus keeps its time with the same virtual clock and says when it will next
+ * have something to do, a day of logging takes as long as the computer needs to run
+ * the code in it, and every run comes out the same.
+ *
+ * @code{.cpp}
+ * yosemitechVirtualClock clock;
+ * sensor.setClock(clock);
+ * clock.delay(86400000UL);  // a day passes at once
+ * @endcode
+ *
+ * @note Don't give a virtual clock to anything talking to a real sensor, since the
+ * sensor keeps real time: the clock would jump to the timeout before it answered.
+ */
+class yosemitechVirtualClock : public yosemitechClock {
+
+ public:
+    /**
+     * @brief Constructs a new virtual clock.
+     *
+     * @param start The time to start at, in microseconds.  Optional with a default
+     * value of 0.
+     */
+    explicit yosemitechVirtualClock(uint64_t start = 0);
+
+    uint32_t millis(void) override;
+    uint32_t micros(void) override;
+    void     delay(uint32_t ms) override;
+    void     delayMicroseconds(uint32_t us) override;
+    void     idle(uint32_t us) override;
+    void     wakeAt(uint32_t us) override;
+
+    /**
+     * @brief Moves the time forward.
+     *
+     * @param us How far to move it, in microseconds
+     */
+    void advance(uint64_t us);
+    /**
+     * @brief Gets the full time, which doesn't roll over like micros() does.
+     *
+     * @return *uint64_t* The time in microseconds
+     */
+    uint64_t getTime(void);
+    /**
+     * @brief Gets the number of times a waiting loop has idled.
+     *
+     * @return *uint32_t* The number of calls to idle()
+     */
+    uint32_t getIdles(void);
+
+ private:
+    uint64_t _now;    ///< The time, in microseconds
+    uint64_t _wake;   ///< The earliest wake up asked for, or 0 for none
+    uint32_t _idles;  ///< The number of calls to idle()
+};
+
+
+/**
+ * @brief A function that puts the board to sleep for at most a while.
+ *
+ * It may wake sooner, and must wake when a byte arrives on the sensor's serial port.
+ * It must also use a sleep that keeps millis() and micros() running, like
+ * SLEEP_MODE_IDLE on AVR boards, which any interrupt ends.
+ *
+ * @param us The longest to sleep, in microseconds
+ */
+typedef void (*yosemitechSleepFunction)(uint32_t us);
+
+/**
+ * @brief The board's own clock, but sleeping instead of busy waiting, and keeping
+ * count of the time spent asleep.
+ *
+ * Delays sleep until their time is up and a waiting loop sleeps until something
+ * happens, like a byte arriving, through a sleep function the sketch gives it; the
+ * library only counts the time.  Waits too short to be worth sleeping through busy
+ * wait as usual.
+ *
+ * The time awake and asleep is counted from the last call to startCycle(), so a
+ * sketch can call that at the start of each logging interval and read the times at
+ * the end.  Sketches should wait for their sensors with this clock's delay() too.
+ *
+ * @code{.cpp}
+ * #include <avr/sleep.h>
+ *
+ * void idleSleep(uint32_t) {
+ *     set_sleep_mode(SLEEP_MODE_IDLE);  // woken by the next interrupt
+ *     sleep_mode();
+ * }
+ * yosemitechSleepClock sleepClock(idleSleep);
+ *
+ * sensor.setClock(sleepClock);
+ * sleepClock.startCycle();
+ * sensor.startMeasurement();
+ * sleepClock.delay(22000);  // stabilizing
+ * sensor.getReading(reading);
+ * Serial.println(sleepClock.getAsleep());
+ * @endcode
+ */
+class yosemitechSleepClock : public yosemitechClock {
+
+ public:
+    /**
+     * @brief Constructs a new sleeping clock.
+     *
+     * @param sleep The function that puts the board to sleep
+     * @param minSleep The shortest wait to sleep through, in microseconds.  Optional
+     * with a default value of 2000: twice the millis() tick of an AVR board, which
+     * ends a SLEEP_MODE_IDLE sleep.
+     */
+    explicit yosemitechSleepClock(yosemitechSleepFunction sleep,
+                                  uint32_t                minSleep = 2000);
+
+    void delay(uint32_t ms) override;
+    void delayMicroseconds(uint32_t us) override;
+    void idle(uint32_t us) override;
+
+    /**
+     * @brief Starts counting the time awake and asleep again.
+     */
+    void startCycle(void);
+    /**
+     * @brief Gets the time spent asleep since startCycle().
+     *
+     * @return *uint32_t* The time in milliseconds
+     */
+    uint32_t getAsleep(void);
+    /**
+     * @brief Gets the time spent awake since startCycle().
+     *
+     * @return *uint32_t* The time in milliseconds
+     */
+    uint32_t getAwake(void);
+    /**
+     * @brief Gets the number of times the board has been put to sleep since
+     * startCycle().
+     *
+     * @return *uint32_t* The number of calls to the sleep function
+     */
+    uint32_t getSleeps(void);
+
+ private:
+    /**
+     * @brief Sleeps once and counts the time.
+     *
+     * @param us The longest to sleep, in microseconds
+     */
+    void sleep(uint32_t us);
+
+    yosemitechSleepFunction _sleep;       ///< Puts the board to sleep
+    uint32_t                _minSleep;    ///< The shortest wait to sleep through
+    uint32_t                _cycleStart;  ///< When startCycle() was called, in ms
+    uint64_t                _asleep;      ///< The time asleep, in microseconds
+    uint32_t                _sleeps;      ///< The number of sleeps
+};
+
+#endif
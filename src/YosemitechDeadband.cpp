@@ -0,0 +1,97 @@
+/**
+ * @file YosemitechDeadband.cpp
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the deadband filter definitions.
+ */
+
+#include "YosemitechDeadband.h"
+
+
+yosemitechDeadband::yosemitechDeadband(uint32_t heartbeat)
+    : _heartbeat(heartbeat),
+      _checked(0),
+      _reportedCount(0) {
+    for (uint8_t i = 0; i < YM_MAX_VALUES; i++) {
+        _absolute[i] = 0;
+        _relative[i] = 0;
+    }
+    reset();
+}
+
+
+void yosemitechDeadband::setThreshold(uint8_t channel, float absolute,
+                                      float relative) {
+    if (channel >= YM_MAX_VALUES) return;
+    _absolute[channel] = absolute;
+    _relative[channel] = relative;
+}
+
+
+void yosemitechDeadband::setHeartbeat(uint32_t heartbeat) {
+    _heartbeat = heartbeat;
+}
+
+
+// This reports a channel when its value leaves the deadband, when its heartbeat is
+// due, or when anything about the sensor's state changes: the error code, or a value
+// appearing or disappearing (-9999).
+uint8_t yosemitechDeadband::filter(const yosemitechReading& reading) {
+    bool    newState = !_started || reading.errorCode != _errorCode;
+    uint8_t changed  = 0;
+
+    for (uint8_t i = 0; i < reading.numValues && i < YM_MAX_VALUES; i++) {
+        float value = reading.values[i];
+        float last  = _reported[i];
+        bool  report;
+        if (newState || (value == -9999) != (last == -9999)) {
+            report = true;
+        } else if (_heartbeat > 0 && reading.time - _reportedAt[i] >= _heartbeat) {
+            report = true;
+        } else {
+            float change = value - last;
+            if (change < 0) change = -change;
+            float scale = last < 0 ? -last : last;
+            if (_absolute[i] == 0 && _relative[i] == 0) {
+                report = change > 0;
+            } else {
+                report = (_absolute[i] > 0 && change > _absolute[i]) ||
+                    (_relative[i] > 0 && change > _relative[i] * scale);
+            }
+        }
+
+        _checked++;
+        if (report) {
+            changed |= 1 << i;
+            _reported[i]   = value;
+            _reportedAt[i] = reading.time;
+            _reportedCount++;
+        }
+    }
+    _errorCode = reading.errorCode;
+    _started   = true;
+    return changed;
+}
+
+
+void yosemitechDeadband::reset(void) {
+    _started   = false;
+    _errorCode = 0;
+    for (uint8_t i = 0; i < YM_MAX_VALUES; i++) {
+        _reported[i]   = -9999;
+        _reportedAt[i] = 0;
+    }
+}
+
+
+uint32_t yosemitechDeadband::getChecked(void) {
+    return _checked;
+}
+
+
+uint32_t yosemitechDeadband::getReported(void) {
+    return _reportedCount;
+}
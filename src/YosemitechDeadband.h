@@ -0,0 +1,114 @@
+/**
+ * @file YosemitechDeadband.h
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the deadband filter declarations, used to only report the values
+ * of a sensor that have changed.
+ */
+
+#ifndef YosemitechDeadband_h
+#define YosemitechDeadband_h
+
+#include "YosemitechModbus.h"
+
+/**
+ * @brief A report-by-exception filter for the readings of one sensor.
+ *
+ * Each value of a #yosemitechReading is a channel.  A channel is reported when it
+ * moves outside its deadband around the last value reported for it, when the
+ * heartbeat interval has passed since it was last reported, or when the error code
+ * of the sensor changes.  Everything is kept in a fixed amount of memory.
+ *
+ * @code{.cpp}
+ * yosemitechDeadband deadband(3600000);  // report everything at least hourly
+ * deadband.setThreshold(0, 0.05);        // pH, in pH units
+ * deadband.setThreshold(1, 0.2);         // temperature, in degrees C
+ *
+ * yosemitechReading reading;
+ * sensor.getReading(reading);
+ * uint8_t changed = deadband.filter(reading);
+ * for (uint8_t i = 0; i < reading.numValues; i++) {
+ *     if (changed & (1 << i)) sendValue(i, reading.values[i]);
+ * }
+ * @endcode
+ */
+class yosemitechDeadband {
+
+ public:
+    /**
+     * @brief Constructs a new deadband filter.
+     *
+     * Every channel starts with no deadband, so any change is reported.
+     *
+     * @param heartbeat The longest time in milliseconds a channel goes unreported.
+     * Optional with a default value of 0, for no heartbeat.
+     */
+    explicit yosemitechDeadband(uint32_t heartbeat = 0);
+
+    /**
+     * @brief Sets the deadband of one channel.
+     *
+     * A value is reported when it has moved from the last reported value by more
+     * than either threshold.  A threshold of 0 is not used; with both at 0 any change
+     * is reported.
+     *
+     * @param channel The position of the value in a #yosemitechReading
+     * @param absolute The change to report, in the units of the value
+     * @param relative The change to report, as a fraction of the last reported value
+     * (0.01 for 1%).  Optional with a default value of 0.
+     */
+    void setThreshold(uint8_t channel, float absolute, float relative = 0);
+
+    /**
+     * @brief Sets the heartbeat interval.
+     *
+     * @param heartbeat The longest time in milliseconds a channel goes unreported, or
+     * 0 for no heartbeat
+     */
+    void setHeartbeat(uint32_t heartbeat);
+
+    /**
+     * @brief Checks a reading against the deadbands and remembers the channels it
+     * reports.
+     *
+     * @param reading The reading
+     * @return *uint8_t* A bit for each channel to report, channel 0 being the lowest
+     * bit; 0 if nothing needs to be reported.
+     */
+    uint8_t filter(const yosemitechReading& reading);
+
+    /**
+     * @brief Forgets what was reported, so the next reading is reported in full.
+     */
+    void reset(void);
+
+    /**
+     * @brief Gets the number of channel values that have been filtered.
+     *
+     * @return *uint32_t* The number of channel values checked
+     */
+    uint32_t getChecked(void);
+
+    /**
+     * @brief Gets the number of channel values that have been reported.
+     *
+     * @return *uint32_t* The number of channel values reported
+     */
+    uint32_t getReported(void);
+
+ private:
+    uint32_t _heartbeat;                  ///< The heartbeat interval
+    float    _absolute[YM_MAX_VALUES];    ///< The absolute deadband of each channel
+    float    _relative[YM_MAX_VALUES];    ///< The relative deadband of each channel
+    float    _reported[YM_MAX_VALUES];    ///< The last value reported
+    uint32_t _reportedAt[YM_MAX_VALUES];  ///< When each channel was last reported
+    byte     _errorCode;                  ///< The last error code reported
+    bool     _started;                    ///< Whether anything has been reported
+    uint32_t _checked;                    ///< Channel values checked
+    uint32_t _reportedCount;              ///< Channel values reported
+};
+
+#endif
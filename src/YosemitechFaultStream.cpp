@@ -0,0 +1,228 @@
+/**
+ * @file YosemitechFaultStream.cpp
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the definitions of a Stream that injects bus faults.
+ */
+
+#include "YosemitechFaultStream.h"
+
+
+yosemitechFaultStream::yosemitechFaultStream(Stream& stream, uint32_t seed)
+    : _stream(stream),
+      _clock(&yosemitechClock::system),
+      _delay(100),
+      _stallStart(0),
+      _stalled(false),
+      _writing(false),
+      _faults(0),
+      _flipMask(0),
+      _flipAt(0),
+      _cutAt(0),
+      _stallAt(0),
+      _received(0),
+      _delivered(0),
+      _lastLength(0),
+      _queueStart(0),
+      _queueEnd(0) {
+    setAllFaults(0);
+    setSeed(seed);
+}
+
+
+void yosemitechFaultStream::setFault(yosemitechFault fault, float probability) {
+    if (fault >= YM_FAULT_COUNT) return;
+    if (probability <= 0) {
+        _threshold[fault] = 0;
+    } else if (probability >= 1) {
+        _threshold[fault] = 65536;
+    } else {
+        _threshold[fault] = (uint32_t)(probability * 65536);
+    }
+}
+
+
+void yosemitechFaultStream::setAllFaults(float probability) {
+    for (uint8_t i = 0; i < YM_FAULT_COUNT; i++) {
+        setFault((yosemitechFault)i, probability);
+    }
+}
+
+
+void yosemitechFaultStream::setDelay(uint32_t delay) {
+    _delay = delay;
+}
+
+
+void yosemitechFaultStream::setSeed(uint32_t seed) {
+    // xorshift never leaves 0
+    _random   = seed != 0 ? seed : 1;
+    _requests = 0;
+    for (uint8_t i = 0; i < YM_FAULT_COUNT; i++) { _injected[i] = 0; }
+}
+
+
+void yosemitechFaultStream::setClock(yosemitechClock& clock) {
+    _clock = &clock;
+}
+
+
+uint32_t yosemitechFaultStream::getRequests(void) {
+    return _requests;
+}
+
+
+uint32_t yosemitechFaultStream::getInjected(yosemitechFault fault) {
+    if (fault >= YM_FAULT_COUNT) return 0;
+    return _injected[fault];
+}
+
+
+// This is Marsaglia's xorshift32; plenty random enough to pick faults
+uint32_t yosemitechFaultStream::random32(void) {
+    _random ^= _random << 13;
+    _random ^= _random >> 17;
+    _random ^= _random << 5;
+    return _random;
+}
+
+
+// This decides the faults of the response to a new request, and puts a copy of the
+// last response in line ahead of it if that's one of them
+void yosemitechFaultStream::startRequest(void) {
+    _writing = true;
+    if (_received > 0) {
+        _lastLength = _received < YM_FAULT_BUFFER_SIZE ? _received
+                                                       : YM_FAULT_BUFFER_SIZE;
+    }
+    _received  = 0;
+    _delivered = 0;
+    _stalled   = false;
+    _requests++;
+
+    _faults = 0;
+    for (uint8_t i = 0; i < YM_FAULT_COUNT; i++) {
+        if ((random32() >> 16) < _threshold[i]) _faults |= 1 << i;
+    }
+    // There's nothing to duplicate before the first response
+    if (_lastLength == 0) _faults &= ~(1 << YM_FAULT_DUPLICATE);
+    for (uint8_t i = 0; i < YM_FAULT_COUNT; i++) {
+        if (_faults & (1 << i)) _injected[i]++;
+    }
+
+    // Where things happen is picked within the length of the last response, or of
+    // the shortest one if there hasn't been one yet
+    uint16_t length = _lastLength > 1 ? _lastLength : 5;
+    _cutAt          = 1 + random32() % (length - 1);
+    _flipAt         = random32() % length;
+    _flipMask       = 1 << (random32() % 8);
+    _stallAt        = random32() % length;
+
+    if (_faults & (1 << YM_FAULT_DUPLICATE)) inject(_last, _lastLength);
+}
+
+
+// This puts any stray bytes in line once the request has gone out
+void yosemitechFaultStream::startResponse(void) {
+    _writing = false;
+    if (_faults & (1 << YM_FAULT_STRAY)) {
+        byte    stray[3];
+        uint8_t count = 1 + random32() % 3;
+        for (uint8_t i = 0; i < count; i++) { stray[i] = random32(); }
+        inject(stray, count);
+    }
+    // The stall is counted from whatever is already waiting to be read
+    _stallAt += _queueEnd - _queueStart;
+}
+
+
+// This adds bytes to those waiting to be read, as far as they fit
+void yosemitechFaultStream::inject(const byte* bytes, uint16_t length) {
+    if (_queueStart == _queueEnd) _queueStart = _queueEnd = 0;
+    if (_queueStart > 0 && _queueEnd + length > YM_FAULT_BUFFER_SIZE) {
+        memmove(_queue, _queue + _queueStart, _queueEnd - _queueStart);
+        _queueEnd -= _queueStart;
+        _queueStart = 0;
+    }
+    for (uint16_t i = 0; i < length && _queueEnd < YM_FAULT_BUFFER_SIZE; i++) {
+        _queue[_queueEnd++] = bytes[i];
+    }
+}
+
+
+// This takes what the sensor has sent, keeping a clean copy and passing on what's
+// left of it after the faults
+void yosemitechFaultStream::receive(void) {
+    while (_stream.available() > 0) {
+        int c = _stream.read();
+        if (c < 0) break;
+        uint16_t index = _received++;
+        if (index < YM_FAULT_BUFFER_SIZE) _last[index] = c;
+        if (_faults & (1 << YM_FAULT_DROP)) continue;
+        if ((_faults & (1 << YM_FAULT_TRUNCATE)) && index >= _cutAt) continue;
+        if ((_faults & (1 << YM_FAULT_BIT_FLIP)) && index == _flipAt) c ^= _flipMask;
+        byte value = c;
+        inject(&value, 1);
+    }
+}
+
+
+int yosemitechFaultStream::available(void) {
+    if (_writing) startResponse();
+    receive();
+    uint16_t ready = _queueEnd - _queueStart;
+    if (!(_faults & (1 << YM_FAULT_DELAY))) return ready;
+
+    // Hold back everything past the stall until it's over
+    if (_delivered < _stallAt) {
+        uint16_t before = _stallAt - _delivered;
+        return ready < before ? ready : before;
+    }
+    if (!_stalled) {
+        _stalled    = true;
+        _stallStart = _clock->millis();
+    }
+    if (_clock->millis() - _stallStart < _delay) {
+        _clock->wakeAt((_stallStart + _delay) * 1000);
+        return 0;
+    }
+    _faults &= ~(1 << YM_FAULT_DELAY);
+    return ready;
+}
+
+
+int yosemitechFaultStream::read(void) {
+    if (available() == 0) return -1;
+    _delivered++;
+    return _queue[_queueStart++];
+}
+
+
+int yosemitechFaultStream::peek(void) {
+    if (available() == 0) return -1;
+    return _queue[_queueStart];
+}
+
+
+size_t yosemitechFaultStream::write(uint8_t value) {
+    return write(&value, 1);
+}
+
+
+// This starts a new request after a response has been read; an echo is everything
+// written for the request
+size_t yosemitechFaultStream::write(const uint8_t* buffer, size_t size) {
+    if (!_writing) startRequest();
+    if (_faults & (1 << YM_FAULT_ECHO)) inject(buffer, size);
+    return _stream.write(buffer, size);
+}
+
+
+void yosemitechFaultStream::flush(void) {
+    _stream.flush();
+}
+
+// cspell: ignore xorshift Marsaglia's
@@ -0,0 +1,162 @@
+/**
+ * @file YosemitechFaultStream.h
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the declarations of a Stream that injects the faults of a noisy
+ * RS485 bus into the responses of the sensors, for testing.
+ */
+
+#ifndef YosemitechFaultStream_h
+#define YosemitechFaultStream_h
+
+#include "YosemitechModbus.h"
+
+/**
+ * @brief The size of the buffers of a fault injecting stream.
+ *
+ * It has to hold the longest response, plus the echo of the request and anything
+ * else injected ahead of it; what doesn't fit is dropped.
+ */
+#ifndef YM_FAULT_BUFFER_SIZE
+#define YM_FAULT_BUFFER_SIZE 160
+#endif
+
+/**
+ * @brief The faults a #yosemitechFaultStream can inject into a response.
+ */
+typedef enum yosemitechFault {
+    YM_FAULT_DROP = 0,   ///< The response never arrives
+    YM_FAULT_BIT_FLIP,   ///< One bit of one byte of the response is flipped
+    YM_FAULT_TRUNCATE,   ///< The response is cut off partway through
+    YM_FAULT_DELAY,      ///< The response stalls partway through (or before the
+                         ///< first byte) for the fault delay
+    YM_FAULT_DUPLICATE,  ///< A copy of the last response arrives ahead of this one
+    YM_FAULT_STRAY,      ///< One to three random bytes arrive ahead of the response
+    YM_FAULT_ECHO,       ///< The request is echoed back ahead of the response, like
+                         ///< a transceiver that doesn't turn off its receiver
+    YM_FAULT_COUNT       ///< The number of kinds of fault
+} yosemitechFault;
+
+/**
+ * @brief A Stream wrapped around the one the sensors are on, which injects faults
+ * into their responses at set probabilities.
+ *
+ * Everything written to the stream is passed straight through.  The first write
+ * after reading starts a new request, and each kind of fault is then decided for the
+ * response to it, independently, at its probability.  Where in the response a bit
+ * is flipped, a response is cut off, or a stall starts is chosen at random within
+ * the length of the last response.
+ *
+ * The faults come from a small pseudo-random generator of its own, so a test with
+ * the same seed and the same sensor answers injects the same faults.
+ *
+ * @code{.cpp}
+ * yosemitechFaultStream faulty(Serial1);
+ * yosemitech            sensor;
+ * faulty.setAllFaults(0.02);        // 2% of responses get each kind of fault
+ * faulty.setFault(YM_FAULT_DROP, 0);
+ * sensor.begin(Y511, 0x01, faulty);
+ * @endcode
+ */
+class yosemitechFaultStream : public Stream {
+
+ public:
+    /**
+     * @brief Constructs a new fault injecting stream with no faults.
+     *
+     * @param stream The stream the sensors are on
+     * @param seed The seed of the fault generator.  Optional with a default value of
+     * 1.
+     */
+    explicit yosemitechFaultStream(Stream& stream, uint32_t seed = 1);
+
+    /**
+     * @brief Sets how likely a response is to get one kind of fault.
+     *
+     * @param fault The kind of fault
+     * @param probability The probability, from 0 for never to 1 for every response
+     */
+    void setFault(yosemitechFault fault, float probability);
+    /**
+     * @brief Sets how likely a response is to get each kind of fault.
+     *
+     * @param probability The probability, from 0 for never to 1 for every response
+     */
+    void setAllFaults(float probability);
+    /**
+     * @brief Sets how long a stalled response stalls for.
+     *
+     * @param delay The stall in milliseconds; the default is 100.
+     */
+    void setDelay(uint32_t delay);
+    /**
+     * @brief Restarts the fault generator and clears the counts.
+     *
+     * @param seed The seed of the fault generator
+     */
+    void setSeed(uint32_t seed);
+    /**
+     * @brief Sets the clock stalls are timed with, which should be the sensors'.
+     *
+     * @param clock The clock; the default is yosemitechClock::system.
+     */
+    void setClock(yosemitechClock& clock);
+
+    /**
+     * @brief Gets the number of requests made through the stream.
+     *
+     * @return *uint32_t* The number of requests
+     */
+    uint32_t getRequests(void);
+    /**
+     * @brief Gets the number of times one kind of fault has been injected.
+     *
+     * @param fault The kind of fault
+     * @return *uint32_t* The number of responses it was injected into
+     */
+    uint32_t getInjected(yosemitechFault fault);
+
+    int    available(void) override;
+    int    read(void) override;
+    int    peek(void) override;
+    size_t write(uint8_t value) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    void   flush(void) override;
+
+    using Print::write;
+
+ private:
+    uint32_t random32(void);
+    void     startRequest(void);
+    void     startResponse(void);
+    void     inject(const byte* bytes, uint16_t length);
+    void     receive(void);
+
+    Stream&          _stream;               ///< The stream the sensors are on
+    yosemitechClock* _clock;                ///< The clock stalls are timed with
+    uint32_t _threshold[YM_FAULT_COUNT];    ///< Each probability, out of 65536
+    uint32_t _injected[YM_FAULT_COUNT];     ///< Responses given each fault
+    uint32_t _requests;                     ///< Requests made
+    uint32_t _random;                       ///< The state of the fault generator
+    uint32_t _delay;                        ///< How long a stall lasts
+    uint32_t _stallStart;                   ///< When the current stall started
+    bool     _stalled;                      ///< Whether the stall has started
+    bool     _writing;                      ///< Whether a request is being written
+    uint8_t  _faults;                       ///< The faults of this response, a bit each
+    byte     _flipMask;                     ///< The bit to flip
+    uint16_t _flipAt;                       ///< The byte of the response to flip
+    uint16_t _cutAt;                        ///< Where to cut off the response
+    uint16_t _stallAt;                      ///< How many bytes to read before stalling
+    uint16_t _received;                     ///< Bytes of the response received
+    uint16_t _delivered;                    ///< Bytes read since the request
+    byte     _last[YM_FAULT_BUFFER_SIZE];   ///< The response as the sensor sent it
+    uint16_t _lastLength;                   ///< The length of the last response
+    byte     _queue[YM_FAULT_BUFFER_SIZE];  ///< Bytes ready to be read
+    uint16_t _queueStart;                   ///< The next byte of _queue to read
+    uint16_t _queueEnd;                     ///< The end of the bytes in _queue
+};
+
+#endif
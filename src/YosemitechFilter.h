@@ -0,0 +1,560 @@
+/**
+ * @file YosemitechFilter.h
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the streaming filters, used to clean spikes and noise out of the
+ * values of a sensor as they are read, before they are logged or sent.
+ */
+
+#ifndef YosemitechFilter_h
+#define YosemitechFilter_h
+
+#include "YosemitechModbus.h"
+
+/**
+ * @brief The last N values of a channel, kept both in the order they came and in
+ * sorted order, so the median and the median absolute deviation can be found without
+ * sorting.
+ *
+ * Adding a value takes one pass over the sorted values to take out the oldest and
+ * one to put in the newest.
+ *
+ * @tparam N The number of values kept; 3 to 255.
+ */
+template <uint8_t N>
+class yosemitechFilterWindow {
+
+    static_assert(N >= 3, "A filter window must hold at least 3 values");
+
+ public:
+    yosemitechFilterWindow() : _next(0), _count(0) {}
+
+    /**
+     * @brief Adds a value, dropping the oldest once the window is full.
+     *
+     * @param value The value
+     */
+    void push(float value) {
+        uint8_t n = _count;
+        if (n == N) {
+            // Take the oldest value out of the sorted values
+            float   oldest = _ring[_next];
+            uint8_t i      = 0;
+            while (i < n - 1 && _sorted[i] != oldest) i++;
+            for (; i < n - 1; i++) _sorted[i] = _sorted[i + 1];
+            n--;
+        } else {
+            _count++;
+        }
+        _ring[_next] = value;
+        _next        = _next + 1 == N ? 0 : _next + 1;
+
+        uint8_t j = n;
+        while (j > 0 && _sorted[j - 1] > value) {
+            _sorted[j] = _sorted[j - 1];
+            j--;
+        }
+        _sorted[j] = value;
+    }
+
+    /**
+     * @brief Gets the median of the values in the window.
+     *
+     * @return *float* The median; the mean of the middle two for an even number of
+     * values.  Undefined when the window is empty.
+     */
+    float median(void) {
+        uint8_t n = _count;
+        if (n & 1) return _sorted[n / 2];
+        return (_sorted[n / 2 - 1] + _sorted[n / 2]) / 2;
+    }
+
+    /**
+     * @brief Gets the median absolute deviation of the values in the window.
+     *
+     * The deviations below and above the median are each already in order in the
+     * sorted values, so walking outwards from the median merges them.
+     *
+     * @param median The median of the window, from median()
+     * @return *float* The median absolute deviation
+     */
+    float mad(float median) {
+        int16_t lo = (_count - 1) / 2;
+        int16_t hi = lo + 1;
+        uint8_t k1 = (_count - 1) / 2;
+        uint8_t k2 = _count / 2;
+        float   d1 = 0;
+        float   d  = 0;
+        for (uint8_t k = 0; k <= k2; k++) {
+            bool below = hi >= _count ||
+                (lo >= 0 && median - _sorted[lo] <= _sorted[hi] - median);
+            if (below) {
+                d = median - _sorted[lo--];
+            } else {
+                d = _sorted[hi++] - median;
+            }
+            if (k == k1) d1 = d;
+        }
+        return (d1 + d) / 2;
+    }
+
+    /**
+     * @brief Gets the number of values in the window.
+     *
+     * @return *uint8_t* The number of values, up to N
+     */
+    uint8_t size(void) {
+        return _count;
+    }
+
+    /**
+     * @brief Empties the window.
+     */
+    void reset(void) {
+        _next  = 0;
+        _count = 0;
+    }
+
+ private:
+    float   _ring[N];    ///< The values in the order they came
+    float   _sorted[N];  ///< The same values in ascending order
+    uint8_t _next;       ///< The position in _ring of the next value
+    uint8_t _count;      ///< The number of values held
+};
+
+
+/**
+ * @brief A filter stage giving the median of the last N values.
+ *
+ * Spikes shorter than half the window disappear completely, and steps come through
+ * sharp, but late by half the window.
+ *
+ * Like every filter stage, it has an apply() taking a value and the time of its
+ * reading and giving back the filtered value, and a reset(); stages are chained by a
+ * #yosemitechFilterChain.
+ *
+ * @tparam N The number of values to take the median of; 3 to 255, and best odd.
+ */
+template <uint8_t N>
+class yosemitechMedian {
+
+ public:
+    /**
+     * @brief Filters one value.
+     *
+     * @param value The value
+     * @return *float* The median of it and the N - 1 values before it
+     */
+    float apply(float value, uint32_t) {
+        _window.push(value);
+        return _window.median();
+    }
+
+    /**
+     * @brief Forgets every value so far.
+     */
+    void reset(void) {
+        _window.reset();
+    }
+
+ private:
+    yosemitechFilterWindow<N> _window;  ///< The last N values
+};
+
+
+/**
+ * @brief A filter stage that replaces outliers with the median of the last N values,
+ * a Hampel filter.
+ *
+ * A value is an outlier when it is further from the median of the N values before it
+ * than the threshold times their median absolute deviation, scaled to match the
+ * standard deviation of normally distributed values.  Everything else comes through
+ * unchanged, so unlike #yosemitechMedian it adds no lag to values that aren't spikes.
+ * Outliers still go into the window, so a real step is let through once it fills half
+ * of it.
+ *
+ * Values that only take a few steps, like a pH that reads 7.00 for an hour, have no
+ * deviation at all; then any change is an outlier until it has lasted half the window.
+ *
+ * @tparam N The number of values before each one to compare it with; 3 to 255.
+ */
+template <uint8_t N>
+class yosemitechHampel {
+
+ public:
+    yosemitechHampel() : _threshold(3), _rejected(0) {}
+
+    /**
+     * @brief Sets how far from the median a value must be to be an outlier.
+     *
+     * @param threshold The distance, in standard deviations; 3 to start with.
+     */
+    void setThreshold(float threshold) {
+        _threshold = threshold;
+    }
+
+    /**
+     * @brief Filters one value.
+     *
+     * The first 3 values come through unchanged, since there isn't enough to judge
+     * them by.
+     *
+     * @param value The value
+     * @return *float* The value, or the median of the window if it is an outlier
+     */
+    float apply(float value, uint32_t) {
+        float out = value;
+        if (_window.size() >= 3) {
+            float median = _window.median();
+            float limit  = _threshold * 1.4826f * _window.mad(median);
+            float change = value - median;
+            if (change > limit || change < -limit) {
+                out = median;
+                _rejected++;
+            }
+        }
+        _window.push(value);
+        return out;
+    }
+
+    /**
+     * @brief Forgets every value so far.
+     */
+    void reset(void) {
+        _window.reset();
+    }
+
+    /**
+     * @brief Gets the number of values replaced as outliers.
+     *
+     * @return *uint32_t* The number of outliers
+     */
+    uint32_t getRejected(void) {
+        return _rejected;
+    }
+
+ private:
+    yosemitechFilterWindow<N> _window;     ///< The last N values
+    float                     _threshold;  ///< The outlier threshold
+    uint32_t                  _rejected;   ///< Values replaced as outliers
+};
+
+
+/**
+ * @brief A filter stage giving an exponentially weighted moving average, to smooth
+ * noise in one float of memory.
+ *
+ * Each value moves the average the weight of the way towards itself.  A weight of
+ * 1 / N smooths about as much as a mean of the last 2N - 1 values.
+ */
+class yosemitechEWMA {
+
+ public:
+    yosemitechEWMA() : _weight(0.25f), _average(0), _started(false) {}
+
+    /**
+     * @brief Sets the weight of each new value.
+     *
+     * @param weight The weight, from just over 0 for the most smoothing to 1 for
+     * none; 0.25 to start with.
+     */
+    void setWeight(float weight) {
+        _weight = weight;
+    }
+
+    /**
+     * @brief Filters one value.
+     *
+     * @param value The value
+     * @return *float* The average; the value itself the first time.
+     */
+    float apply(float value, uint32_t) {
+        if (_started) {
+            _average += _weight * (value - _average);
+        } else {
+            _average = value;
+            _started = true;
+        }
+        return _average;
+    }
+
+    /**
+     * @brief Forgets the average, so the next value starts it again.
+     */
+    void reset(void) {
+        _started = false;
+    }
+
+ private:
+    float _weight;   ///< The weight of each new value
+    float _average;  ///< The average so far
+    bool  _started;  ///< Whether there is an average yet
+};
+
+
+/**
+ * @brief A filter stage limiting how fast a value can change, for quantities that
+ * can't physically move faster than some rate, like water temperature.
+ *
+ * The time each value was read, from #yosemitechReading::time, sets how far it may
+ * move from the last value given back; so after a gap in the readings it can catch
+ * up at once.
+ */
+class yosemitechRateLimit {
+
+ public:
+    yosemitechRateLimit() : _limit(0), _value(0), _time(0), _started(false),
+                            _limited(0) {}
+
+    /**
+     * @brief Sets the fastest the value may change.
+     *
+     * @param limit The change, in the units of the value per second, or 0 for no
+     * limit; 0 to start with.
+     */
+    void setLimit(float limit) {
+        _limit = limit;
+    }
+
+    /**
+     * @brief Filters one value.
+     *
+     * @param value The value
+     * @param time The value of millis() when it was read
+     * @return *float* The value, or as close to it as the last value given back can
+     * get by this time
+     */
+    float apply(float value, uint32_t time) {
+        if (_started && _limit > 0) {
+            float step   = _limit * (uint32_t)(time - _time) / 1000;
+            float change = value - _value;
+            if (change > step) {
+                value = _value + step;
+                _limited++;
+            } else if (change < -step) {
+                value = _value - step;
+                _limited++;
+            }
+        }
+        _value   = value;
+        _time    = time;
+        _started = true;
+        return value;
+    }
+
+    /**
+     * @brief Forgets the last value, so the next one comes through unchanged.
+     */
+    void reset(void) {
+        _started = false;
+    }
+
+    /**
+     * @brief Gets the number of values held back by the limit.
+     *
+     * @return *uint32_t* The number of values changed
+     */
+    uint32_t getLimited(void) {
+        return _limited;
+    }
+
+ private:
+    float    _limit;    ///< The fastest change allowed, per second
+    float    _value;    ///< The last value given back
+    uint32_t _time;     ///< When the last value was read
+    bool     _started;  ///< Whether there has been a value
+    uint32_t _limited;  ///< Values held back by the limit
+};
+
+
+template <uint8_t I, typename Chain>
+struct yosemitechFilterStage;
+
+/**
+ * @brief Filter stages run one after the other, each on the output of the one before.
+ *
+ * The stages are members and are called directly, so the compiler can inline the
+ * whole chain; there are no virtual functions, and a chain takes only the memory of
+ * its stages.
+ *
+ * @code{.cpp}
+ * yosemitechFilterChain<yosemitechHampel<7>, yosemitechEWMA> chain;
+ * chain.stage<0>().setThreshold(2.5);
+ * chain.stage<1>().setWeight(0.3);
+ * float clean = chain.apply(value, millis());
+ * @endcode
+ *
+ * @tparam First The first stage
+ * @tparam Rest The stages after it, if any
+ */
+template <typename First, typename... Rest>
+class yosemitechFilterChain {
+
+ public:
+    typedef First                           Head;  ///< The first stage
+    typedef yosemitechFilterChain<Rest...> Tail;  ///< The rest of the chain
+
+    /**
+     * @brief Filters one value through every stage.
+     *
+     * @param value The value
+     * @param time The value of millis() when it was read
+     * @return *float* The value given back by the last stage
+     */
+    float apply(float value, uint32_t time) {
+        return _tail.apply(_head.apply(value, time), time);
+    }
+
+    /**
+     * @brief Resets every stage.
+     */
+    void reset(void) {
+        _head.reset();
+        _tail.reset();
+    }
+
+    /**
+     * @brief Gets one of the stages, to set it up or read its counts.
+     *
+     * @tparam I The position of the stage, from 0
+     * @return The stage
+     */
+    template <uint8_t I>
+    typename yosemitechFilterStage<I, yosemitechFilterChain>::Type& stage(void) {
+        return yosemitechFilterStage<I, yosemitechFilterChain>::get(*this);
+    }
+
+    /// @brief Gets the first stage.
+    Head& head(void) {
+        return _head;
+    }
+    /// @brief Gets the rest of the chain.
+    Tail& tail(void) {
+        return _tail;
+    }
+
+ private:
+    Head _head;  ///< The first stage
+    Tail _tail;  ///< The stages after it
+};
+
+/**
+ * @brief The end of a chain of filter stages.
+ *
+ * @tparam Last The last stage
+ */
+template <typename Last>
+class yosemitechFilterChain<Last> {
+
+ public:
+    typedef Last Head;  ///< The last stage
+
+    float apply(float value, uint32_t time) {
+        return _head.apply(value, time);
+    }
+
+    void reset(void) {
+        _head.reset();
+    }
+
+    template <uint8_t I>
+    typename yosemitechFilterStage<I, yosemitechFilterChain>::Type& stage(void) {
+        return yosemitechFilterStage<I, yosemitechFilterChain>::get(*this);
+    }
+
+    Head& head(void) {
+        return _head;
+    }
+
+ private:
+    Head _head;  ///< The last stage
+};
+
+/**
+ * @brief Finds a stage in a chain by its position, for yosemitechFilterChain::stage().
+ */
+template <uint8_t I, typename Chain>
+struct yosemitechFilterStage {
+    typedef yosemitechFilterStage<I - 1, typename Chain::Tail> Next;
+    typedef typename Next::Type                                Type;
+    static Type& get(Chain& chain) {
+        return Next::get(chain.tail());
+    }
+};
+
+template <typename Chain>
+struct yosemitechFilterStage<0, Chain> {
+    typedef typename Chain::Head Type;
+    static Type& get(Chain& chain) {
+        return chain.head();
+    }
+};
+
+
+/**
+ * @brief A chain of filter stages attached to one value of a sensor's readings.
+ *
+ * filter() replaces the value in a #yosemitechReading with the filtered value, in
+ * place, so the filters run before anything logs or sends the reading.  Each channel
+ * to clean up gets its own filter, with the stages that suit it.  Values of -9999,
+ * from failed readings, are left alone and don't reach the stages.
+ *
+ * @code{.cpp}
+ * // Y511: turbidity spikes from bubbles and debris, and a noisy temperature
+ * yosemitechChannelFilter<yosemitechHampel<7>, yosemitechMedian<3>> turbidity(1);
+ * yosemitechChannelFilter<yosemitechEWMA> temperature(0);
+ * temperature.stage<0>().setWeight(0.5);
+ *
+ * yosemitechReading reading;
+ * if (sensor.getReading(reading)) {
+ *     turbidity.filter(reading);
+ *     temperature.filter(reading);
+ *     logReading(reading);
+ * }
+ * @endcode
+ *
+ * @tparam Stages The filter stages, in the order they run
+ */
+template <typename... Stages>
+class yosemitechChannelFilter : public yosemitechFilterChain<Stages...> {
+
+ public:
+    /**
+     * @brief Constructs a new channel filter.
+     *
+     * @param channel The position of the value in a #yosemitechReading
+     */
+    explicit yosemitechChannelFilter(uint8_t channel) : _channel(channel) {}
+
+    /**
+     * @brief Filters the channel's value in a reading.
+     *
+     * @param reading The reading, whose value is replaced with the filtered value
+     * @return *bool* True if the value was filtered, false if the reading has no such
+     * value or it is -9999.
+     */
+    bool filter(yosemitechReading& reading) {
+        if (_channel >= reading.numValues || _channel >= YM_MAX_VALUES) return false;
+        float& value = reading.values[_channel];
+        if (value == -9999 || value != value) return false;
+        value = this->apply(value, reading.time);
+        return true;
+    }
+
+    /**
+     * @brief Gets the channel filtered.
+     *
+     * @return *uint8_t* The position of the value in a #yosemitechReading
+     */
+    uint8_t getChannel(void) {
+        return _channel;
+    }
+
+ private:
+    uint8_t _channel;  ///< The position of the value filtered
+};
+
+#endif
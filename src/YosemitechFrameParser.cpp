@@ -0,0 +1,113 @@
+/**
+ * @file YosemitechFrameParser.cpp
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the definitions of the incremental Modbus RTU frame parser.
+ */
+
+#include "YosemitechFrameParser.h"
+
+
+yosemitechFrameParser::yosemitechFrameParser(byte* buffer, uint16_t size)
+    : _buffer(buffer),
+      _size(size),
+      _slaveID(0),
+      _function(0),
+      _length(0),
+      _frameLength(0),
+      _count(0),
+      _crc(0xFFFF),
+      _skipped(0) {}
+
+
+void yosemitechFrameParser::begin(byte slaveID, byte function, uint16_t length) {
+    _slaveID  = slaveID;
+    _function = function;
+    _length   = length;
+    _skipped  = 0;
+    reset();
+}
+
+
+// This checks the new byte against the header as far as it goes, dropping bytes from
+// the front until what's held could be the start of the response, and checks the CRC
+// once the frame is long enough.  A bad CRC means the frame started later.
+yosemitechFrameStatus yosemitechFrameParser::add(byte value) {
+    if (_count == _size) drop();
+    _buffer[_count++] = value;
+    _crc              = crcUpdate(_crc, value);
+    for (;;) {
+        while (_count > 0 && !plausible()) drop();
+        if (_frameLength == 0 || _count < _frameLength) return YM_FRAME_INCOMPLETE;
+        if (_crc == 0) {
+            return (_buffer[1] & 0x80) ? YM_FRAME_EXCEPTION : YM_FRAME_COMPLETE;
+        }
+        drop();
+    }
+}
+
+
+void yosemitechFrameParser::reset(void) {
+    _skipped += _count;
+    _count       = 0;
+    _frameLength = 0;
+    _crc         = 0xFFFF;
+}
+
+
+uint16_t yosemitechFrameParser::getLength(void) {
+    return _count;
+}
+
+
+uint16_t yosemitechFrameParser::getSkipped(void) {
+    return _skipped;
+}
+
+
+uint16_t yosemitechFrameParser::crcUpdate(uint16_t crc, byte value) {
+    crc ^= value;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+        crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+    }
+    return crc;
+}
+
+
+// This checks whether the bytes held could be the start of the response, working out
+// its length as soon as the header gives it
+bool yosemitechFrameParser::plausible(void) {
+    _frameLength = 0;
+    // Any slave can answer a broadcast
+    bool fromSlave = _slaveID == 0xFF ? _buffer[0] >= 1 && _buffer[0] <= 247
+                                      : _buffer[0] == _slaveID;
+    if (!fromSlave) return false;
+    if (_count < 2) return true;
+
+    if (_buffer[1] == (_function | 0x80)) {
+        _frameLength = 5;
+    } else if (_buffer[1] != _function) {
+        return false;
+    } else if (_function == 0x03 || _function == 0x04) {
+        // A read gives its length in its byte count
+        if (_count < 3) return true;
+        if (_length != 0 && _buffer[2] + 5 != _length) return false;
+        _frameLength = _buffer[2] + 5;
+    } else {
+        _frameLength = _length;
+    }
+    return _frameLength <= _size && (_frameLength == 0 || _count <= _frameLength);
+}
+
+
+// This drops the first byte held and works out the CRC of the rest again
+void yosemitechFrameParser::drop(void) {
+    _count--;
+    _skipped++;
+    memmove(_buffer, _buffer + 1, _count);
+    _crc = 0xFFFF;
+    for (uint16_t i = 0; i < _count; i++) { _crc = crcUpdate(_crc, _buffer[i]); }
+}
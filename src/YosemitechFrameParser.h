@@ -0,0 +1,121 @@
+/**
+ * @file YosemitechFrameParser.h
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the declarations of an incremental parser for Modbus RTU response
+ * frames, used to finish a transaction as soon as the last byte of the response is
+ * in.
+ */
+
+#ifndef YosemitechFrameParser_h
+#define YosemitechFrameParser_h
+
+#include <Arduino.h>
+
+/**
+ * @brief Where a #yosemitechFrameParser has got to.
+ */
+typedef enum yosemitechFrameStatus {
+    YM_FRAME_INCOMPLETE = 0,  ///< The whole response hasn't arrived yet
+    YM_FRAME_COMPLETE,        ///< A good normal response is in the buffer
+    YM_FRAME_EXCEPTION        ///< A good exception response is in the buffer
+} yosemitechFrameStatus;
+
+/**
+ * @brief An incremental parser for the response to one Modbus RTU command.
+ *
+ * Bytes are added one at a time as they arrive.  Each byte is checked as soon as it
+ * can be: the slave ID, then the function code, then, for a read, the byte count,
+ * which gives the length of the frame.  The CRC is updated with every byte, so the
+ * response is known to be complete and good the moment its last byte is added,
+ * without waiting for the line to go quiet.
+ *
+ * Bytes that can't be the start of the response, like stray bytes, an echo of the
+ * command or a reply from another slave, are dropped from the front until what is
+ * left could be, so the parser finds the response even if it doesn't come first.
+ *
+ * @code{.cpp}
+ * yosemitechFrameParser parser(buffer, sizeof(buffer));
+ * parser.begin(0x01, 0x03, 15);  // reading 5 registers from slave 0x01
+ * while (parser.add(port.read()) == YM_FRAME_INCOMPLETE) { ... }
+ * @endcode
+ */
+class yosemitechFrameParser {
+
+ public:
+    /**
+     * @brief Constructs a new parser.
+     *
+     * @param buffer Where to put the response; it starts at the front once complete
+     * @param size The size of the buffer; longer responses are never complete
+     */
+    yosemitechFrameParser(byte* buffer, uint16_t size);
+
+    /**
+     * @brief Starts looking for the response to a new command.
+     *
+     * @param slaveID The slave ID the command was sent to; 0xFF (broadcast) takes a
+     * response from any slave
+     * @param function The function code of the command
+     * @param length The length of a normal response, including the CRC.  For a read
+     * (0x03 or 0x04) it can be 0 to take any byte count.
+     */
+    void begin(byte slaveID, byte function, uint16_t length);
+    /**
+     * @brief Adds the next byte received.
+     *
+     * @param value The byte
+     * @return *yosemitechFrameStatus* Whether the response is complete.
+     */
+    yosemitechFrameStatus add(byte value);
+    /**
+     * @brief Drops any part of a frame received so far, as after a silent interval
+     * in the middle of it.
+     */
+    void reset(void);
+
+    /**
+     * @brief Gets the number of bytes held of the frame being received, which is the
+     * length of the response once it is complete.
+     *
+     * @return *uint16_t* The number of bytes
+     */
+    uint16_t getLength(void);
+    /**
+     * @brief Gets the number of bytes dropped since begin() because they couldn't be
+     * part of the response.
+     *
+     * @return *uint16_t* The number of bytes
+     */
+    uint16_t getSkipped(void);
+
+    /**
+     * @brief Adds one byte to a Modbus CRC.
+     *
+     * Start from 0xFFFF.  The CRC of a whole frame, including its own CRC, is 0.
+     *
+     * @param crc The CRC of the bytes before
+     * @param value The next byte
+     * @return *uint16_t* The CRC with the byte added
+     */
+    static uint16_t crcUpdate(uint16_t crc, byte value);
+
+ private:
+    bool plausible(void);
+    void drop(void);
+
+    byte*    _buffer;       ///< Where the response goes
+    uint16_t _size;         ///< The size of the buffer
+    byte     _slaveID;      ///< The slave ID of the command
+    byte     _function;     ///< The function code of the command
+    uint16_t _length;       ///< The length of a normal response, or 0
+    uint16_t _frameLength;  ///< The length of the frame being received, once known
+    uint16_t _count;        ///< The bytes held of the frame being received
+    uint16_t _crc;          ///< The CRC of the bytes held
+    uint16_t _skipped;      ///< Bytes dropped since begin()
+};
+
+#endif
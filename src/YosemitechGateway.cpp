@@ -0,0 +1,566 @@
+/**
+ * @file YosemitechGateway.cpp
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the definitions of the Modbus TCP gateway.
+ *
+ * A Modbus TCP request or response is a 7 byte header followed by the same
+ * function code and data as on a serial line, without the CRC:
+ *   transaction ID (2), protocol ID (2, always 0), length (2), unit ID (1)
+ * where the length counts the unit ID and everything after it.  All of the
+ * numbers are big-endian.
+ */
+
+#include "YosemitechGateway.h"
+
+#ifdef YM_HOST_BUILD
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// Linux asks for no SIGPIPE on each send, macOS on the socket
+#ifdef MSG_NOSIGNAL
+#define YM_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define YM_SEND_FLAGS 0
+#endif
+
+// The size of the Modbus TCP header, up to and including the unit ID
+#define YM_MBAP_SIZE 7
+
+// The most registers the modbusMaster's response buffer can hold
+#define YM_FORWARD_REGISTERS ((RESPONSE_BUFFER_SIZE - 5) / 2)
+
+
+// The value registers getValues() reads for the models that don't read 5 registers
+// from 0x2600
+typedef struct valueBlock {
+    uint8_t  model;
+    uint16_t regNum;
+    uint8_t  numRegisters;
+} valueBlock;
+
+static const valueBlock valueBlocks[] = {
+    {Y4000, 0x2601, 16}, {Y4000, 0x0800, 1}, {Y502, 0x2600, 6}, {Y504, 0x2600, 6},
+    {Y513, 0x2600, 4},   {Y532, 0x2800, 2},  {Y532, 0x2400, 2}, {Y532, 0x1200, 2},
+    {Y533, 0x1200, 2},   {Y533, 0x2400, 2},  {Y560, 0x2600, 4}, {Y560, 0x2400, 2},
+    {Y560, 0x2800, 2},   {Y700, 0x2600, 6},  {Y700, 0x2400, 2},
+};
+
+
+yosemitechGateway::yosemitechGateway()
+    : _numSensors(0),
+      _numBlocks(0),
+      _stats(),
+      _listenFd(-1),
+      _running(false) {
+    _wakeFds[0] = _wakeFds[1] = -1;
+    for (uint8_t i = 0; i < YM_GATEWAY_CLIENTS; i++) {
+        _clients[i].fd   = -1;
+        _clients[i].busy = false;
+    }
+    pthread_mutex_init(&_lock, nullptr);
+    pthread_cond_init(&_requestQueued, nullptr);
+}
+
+yosemitechGateway::~yosemitechGateway() {
+    end();
+    pthread_cond_destroy(&_requestQueued);
+    pthread_mutex_destroy(&_lock);
+}
+
+
+bool yosemitechGateway::addSensor(yosemitech& sensor, uint32_t interval) {
+    // Work out the blocks first, so a sensor is added whole or not at all
+    valueBlock blocks[5];
+    uint8_t    count = 0;
+    for (size_t i = 0; i < sizeof(valueBlocks) / sizeof(valueBlocks[0]); i++) {
+        if (valueBlocks[i].model == sensor._model) blocks[count++] = valueBlocks[i];
+    }
+    if (count == 0 && sensor._model != UNKNOWN) blocks[count++] = {0, 0x2600, 5};
+    if (_running || _numBlocks + count + 2 > YM_GATEWAY_BLOCKS) return false;
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (!addCacheBlock(sensor, blocks[i].regNum, blocks[i].numRegisters, interval,
+                           true)) {
+            return false;
+        }
+    }
+    addCacheBlock(sensor, 0x0700, 2, YM_CACHE_TTL_IDENTITY, false);
+    return addCacheBlock(sensor, sensor._model == Y4000 ? 0x1400 : 0x0900, 7,
+                         YM_CACHE_TTL_IDENTITY, false);
+}
+
+
+bool yosemitechGateway::addBlock(yosemitech& sensor, uint16_t regNum,
+                                 uint8_t numRegisters, uint32_t interval) {
+    return addCacheBlock(sensor, regNum, numRegisters, interval, false);
+}
+
+
+bool yosemitechGateway::addCacheBlock(yosemitech& sensor, uint16_t regNum,
+                                      uint8_t numRegisters, uint32_t interval,
+                                      bool values) {
+    if (_running || _numBlocks >= YM_GATEWAY_BLOCKS || numRegisters == 0 ||
+        numRegisters > YM_GATEWAY_BLOCK_REGISTERS) {
+        return false;
+    }
+    if (findSensor(sensor._slaveID) != &sensor) {
+        if (_numSensors >= YM_GATEWAY_SENSORS) return false;
+        _sensors[_numSensors++] = &sensor;
+    }
+    cacheBlock& block  = _blocks[_numBlocks++];
+    block.sensor       = &sensor;
+    block.regNum       = regNum;
+    block.numRegisters = numRegisters;
+    block.values       = values;
+    block.interval     = interval;
+    block.fetched      = 0;
+    block.tried        = 0;
+    block.valid        = false;
+    block.due          = true;
+    return true;
+}
+
+
+yosemitech* yosemitechGateway::findSensor(byte slaveID) {
+    for (uint8_t i = 0; i < _numSensors; i++) {
+        if (_sensors[i]->_slaveID == slaveID) return _sensors[i];
+    }
+    return nullptr;
+}
+
+
+bool yosemitechGateway::begin(uint16_t port, const char* address) {
+    if (_running) return false;
+
+    struct sockaddr_in local = {};
+    local.sin_family         = AF_INET;
+    local.sin_port           = htons(port);
+    if (inet_pton(AF_INET, address, &local.sin_addr) != 1) return false;
+
+    _listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (_listenFd < 0) return false;
+    int on = 1;
+    setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (bind(_listenFd, (struct sockaddr*)&local, sizeof(local)) != 0 ||
+        listen(_listenFd, 16) != 0 || pipe(_wakeFds) != 0) {
+        end();
+        return false;
+    }
+    fcntl(_listenFd, F_SETFL, O_NONBLOCK);
+    fcntl(_wakeFds[0], F_SETFL, O_NONBLOCK);
+    fcntl(_wakeFds[1], F_SETFL, O_NONBLOCK);
+
+    _running = true;
+    pthread_create(&_bus, nullptr, busThread, this);
+    pthread_create(&_server, nullptr, serverThread, this);
+    return true;
+}
+
+
+void yosemitechGateway::end(void) {
+    if (_running) {
+        pthread_mutex_lock(&_lock);
+        _running = false;
+        pthread_cond_signal(&_requestQueued);
+        pthread_mutex_unlock(&_lock);
+        wakeServer();
+        pthread_join(_bus, nullptr);
+        pthread_join(_server, nullptr);
+    }
+    for (uint8_t i = 0; i < YM_GATEWAY_CLIENTS; i++) {
+        if (_clients[i].fd >= 0) closeClient(_clients[i]);
+    }
+    if (_listenFd >= 0) close(_listenFd);
+    if (_wakeFds[0] >= 0) close(_wakeFds[0]);
+    if (_wakeFds[1] >= 0) close(_wakeFds[1]);
+    _listenFd   = -1;
+    _wakeFds[0] = _wakeFds[1] = -1;
+}
+
+
+yosemitechGatewayStats yosemitechGateway::getStats(void) {
+    pthread_mutex_lock(&_lock);
+    yosemitechGatewayStats stats = _stats;
+    pthread_mutex_unlock(&_lock);
+    return stats;
+}
+
+
+void* yosemitechGateway::busThread(void* gateway) {
+    ((yosemitechGateway*)gateway)->runBus();
+    return nullptr;
+}
+
+void* yosemitechGateway::serverThread(void* gateway) {
+    ((yosemitechGateway*)gateway)->runServer();
+    return nullptr;
+}
+
+
+//----------------------------------------------------------------------------
+//                                 BUS THREAD
+//----------------------------------------------------------------------------
+
+// The bus thread is the only thing that talks to the sensors.  Requests forwarded
+// by clients go first, taking the clients in turn; otherwise it refreshes the most
+// overdue cached block, or sleeps until one is due.
+void yosemitechGateway::runBus(void) {
+    uint8_t turn = 0;
+    pthread_mutex_lock(&_lock);
+    while (_running) {
+        client* waiting = nullptr;
+        for (uint8_t i = 0; i < YM_GATEWAY_CLIENTS && waiting == nullptr; i++) {
+            client& next = _clients[(turn + i) % YM_GATEWAY_CLIENTS];
+            if (next.fd >= 0 && next.busy) waiting = &next;
+        }
+        turn = (turn + 1) % YM_GATEWAY_CLIENTS;
+        if (waiting != nullptr) {
+            pthread_mutex_unlock(&_lock);
+            forwardRequest(*waiting);
+            pthread_mutex_lock(&_lock);
+            waiting->busy = false;
+            wakeServer();
+            continue;
+        }
+
+        uint32_t    now     = millis();
+        cacheBlock* oldest  = nullptr;
+        uint32_t    overdue = 0;
+        uint32_t    sleep   = 1000;
+        for (uint16_t i = 0; i < _numBlocks; i++) {
+            cacheBlock& block = _blocks[i];
+            uint32_t    age   = now - block.tried;
+            if (block.due) age = UINT32_MAX;
+            if (age >= block.interval) {
+                if (oldest == nullptr || age - block.interval >= overdue) {
+                    oldest  = &block;
+                    overdue = age - block.interval;
+                }
+            } else if (block.interval - age < sleep) {
+                sleep = block.interval - age;
+            }
+        }
+        if (oldest != nullptr) {
+            oldest->due   = false;
+            oldest->tried = now;
+            pthread_mutex_unlock(&_lock);
+            refreshBlock(*oldest);
+            pthread_mutex_lock(&_lock);
+            continue;
+        }
+
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += sleep / 1000;
+        until.tv_nsec += (sleep % 1000) * 1000000L;
+        if (until.tv_nsec >= 1000000000L) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&_requestQueued, &_lock, &until);
+    }
+    pthread_mutex_unlock(&_lock);
+}
+
+
+// This reads a block from its sensor and, only if the read worked, replaces the
+// whole cached block at once
+bool yosemitechGateway::refreshBlock(cacheBlock& block) {
+    yosemitech& sensor = *block.sensor;
+    bool success = sensor.readRegisters(block.regNum, block.numRegisters,
+                                        block.values ? yosemitech::valuesRead
+                                                     : yosemitech::metadataRead);
+    pthread_mutex_lock(&_lock);
+    if (success) {
+        memcpy(block.data, sensor.modbus.responseBuffer + 3, block.numRegisters * 2);
+        block.fetched = millis();
+        block.valid   = true;
+        _stats.refreshes++;
+    } else {
+        _stats.refreshFailures++;
+    }
+    pthread_mutex_unlock(&_lock);
+    return success;
+}
+
+
+// This sends a client's read or write on to its sensor and answers the client.
+// The bus thread owns the client until it clears the busy flag, so it also takes
+// the request out of the client's buffer.
+void yosemitechGateway::forwardRequest(client& from) {
+    yosemitech& sensor   = *from.sensor;
+    byte*       adu      = from.adu;
+    uint16_t    length   = ((adu[4] << 8) | adu[5]) + 6;
+    byte        function = adu[7];
+    uint16_t    regNum   = (adu[8] << 8) | adu[9];
+    uint16_t    count    = function == 0x06 ? 1 : (adu[10] << 8) | adu[11];
+
+    bool success;
+    byte response[2 + 2 * YM_FORWARD_REGISTERS];
+    if (function == 0x03) {
+        success = sensor.readRegisters(regNum, count, yosemitech::metadataRead);
+        if (success) {
+            response[0] = 0x03;
+            response[1] = count * 2;
+            memcpy(response + 2, sensor.modbus.responseBuffer + 3, count * 2);
+            sendResponse(from, response, 2 + count * 2);
+        }
+    } else {
+        success = sensor.writeRegisters(regNum, count,
+                                        adu + (function == 0x06 ? 10 : 13));
+        // What was cached for the written registers is no longer right
+        pthread_mutex_lock(&_lock);
+        for (uint16_t i = 0; i < _numBlocks; i++) {
+            cacheBlock& block = _blocks[i];
+            if (block.sensor == &sensor && regNum < block.regNum + block.numRegisters &&
+                block.regNum < regNum + count) {
+                block.due = true;
+            }
+        }
+        pthread_mutex_unlock(&_lock);
+        // A write is answered with the start of its own request
+        if (success) sendResponse(from, adu + YM_MBAP_SIZE, 5);
+    }
+    if (!success) {
+        yosemitechError error = sensor.getLastError();
+        sendException(from, error < YM_NO_RESPONSE ? error : YM_GATEWAY_TARGET_FAILED);
+    }
+
+    memmove(adu, adu + length, from.received - length);
+    from.received -= length;
+}
+
+
+//----------------------------------------------------------------------------
+//                               SERVER THREAD
+//----------------------------------------------------------------------------
+
+// The server thread accepts clients, reads their requests and answers the ones it
+// can from the cache.  Clients with a request at the bus thread aren't listened to
+// until it has been answered, so each client's responses come back in order.
+void yosemitechGateway::runServer(void) {
+    struct pollfd fds[2 + YM_GATEWAY_CLIENTS];
+    client*       owners[2 + YM_GATEWAY_CLIENTS];
+    while (_running) {
+        nfds_t count      = 0;
+        fds[count].fd     = _listenFd;
+        fds[count].events = POLLIN;
+        owners[count++]   = nullptr;
+        fds[count].fd     = _wakeFds[0];
+        fds[count].events = POLLIN;
+        owners[count++]   = nullptr;
+        pthread_mutex_lock(&_lock);
+        for (uint8_t i = 0; i < YM_GATEWAY_CLIENTS; i++) {
+            if (_clients[i].fd < 0 || _clients[i].busy) continue;
+            // Answer anything that arrived while the client was waiting on the bus
+            if (_clients[i].received > 0) {
+                pthread_mutex_unlock(&_lock);
+                bool open = handleRequests(_clients[i]);
+                pthread_mutex_lock(&_lock);
+                if (!open) {
+                    closeClient(_clients[i]);
+                    continue;
+                }
+                if (_clients[i].busy) continue;
+            }
+            fds[count].fd     = _clients[i].fd;
+            fds[count].events = POLLIN;
+            owners[count++]   = &_clients[i];
+        }
+        pthread_mutex_unlock(&_lock);
+
+        if (poll(fds, count, 1000) <= 0) continue;
+
+        if (fds[1].revents & POLLIN) {
+            byte drain[64];
+            while (read(_wakeFds[0], drain, sizeof(drain)) > 0) {}
+        }
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(_listenFd, nullptr, nullptr);
+            if (fd >= 0) {
+                int on = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+#ifdef SO_NOSIGPIPE
+                setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+                fcntl(fd, F_SETFL, O_NONBLOCK);
+                pthread_mutex_lock(&_lock);
+                uint8_t slot = 0;
+                while (slot < YM_GATEWAY_CLIENTS && _clients[slot].fd >= 0) slot++;
+                if (slot < YM_GATEWAY_CLIENTS) {
+                    _clients[slot].fd       = fd;
+                    _clients[slot].busy     = false;
+                    _clients[slot].received = 0;
+                    _stats.connections++;
+                    _stats.clients++;
+                } else {
+                    close(fd);  // full up
+                }
+                pthread_mutex_unlock(&_lock);
+            }
+        }
+        for (nfds_t i = 2; i < count; i++) {
+            if (fds[i].revents == 0) continue;
+            client& from = *owners[i];
+            ssize_t got  = recv(from.fd, from.adu + from.received,
+                                sizeof(from.adu) - from.received, 0);
+            bool open = (got > 0 || (got < 0 && (errno == EAGAIN || errno == EINTR)));
+            if (got > 0) {
+                from.received += got;
+                open = handleRequests(from);
+            }
+            if (!open) {
+                pthread_mutex_lock(&_lock);
+                closeClient(from);
+                pthread_mutex_unlock(&_lock);
+            }
+        }
+    }
+}
+
+
+// This answers every whole request in a client's buffer, stopping early if one has
+// to go to the bus.  It returns false if the client sent something that isn't Modbus
+// TCP and should be disconnected.
+bool yosemitechGateway::handleRequests(client& from) {
+    while (from.received >= YM_MBAP_SIZE + 1) {
+        byte*    adu    = from.adu;
+        uint16_t length = (adu[4] << 8) | adu[5];
+        if (adu[2] != 0 || adu[3] != 0 || length < 2 || length > 254) return false;
+        length += 6;
+        if (from.received < length) return true;
+
+        byte        function  = adu[7];
+        uint16_t    regNum    = (adu[8] << 8) | adu[9];
+        uint16_t    count     = (adu[10] << 8) | adu[11];
+        yosemitech* sensor    = findSensor(adu[6]);
+        byte        exception = 0;
+        bool        forward   = false;
+        pthread_mutex_lock(&_lock);
+        _stats.requests++;
+        pthread_mutex_unlock(&_lock);
+
+        if (sensor == nullptr) {
+            exception = YM_GATEWAY_PATH_UNAVAILABLE;
+        } else if (function == 0x03) {
+            if (length != 12 || count == 0 || count > 125) {
+                exception = YM_ILLEGAL_DATA_VALUE;
+            } else {
+                // Answer from the one cached block holding every register asked for
+                byte response[2 + 2 * 125];
+                bool found = false;
+                pthread_mutex_lock(&_lock);
+                for (uint16_t i = 0; i < _numBlocks && !found; i++) {
+                    cacheBlock& block = _blocks[i];
+                    if (block.sensor != sensor || regNum < block.regNum ||
+                        regNum + count > block.regNum + block.numRegisters) {
+                        continue;
+                    }
+                    found = true;
+                    if (!block.valid || millis() - block.fetched > 3 * block.interval) {
+                        exception = YM_GATEWAY_TARGET_FAILED;
+                    } else {
+                        response[0] = 0x03;
+                        response[1] = count * 2;
+                        memcpy(response + 2, block.data + (regNum - block.regNum) * 2,
+                               count * 2);
+                        _stats.cacheReads++;
+                    }
+                }
+                pthread_mutex_unlock(&_lock);
+                if (found && exception == 0) {
+                    if (!sendResponse(from, response, 2 + count * 2)) return false;
+                } else if (!found) {
+                    if (count > YM_FORWARD_REGISTERS) {
+                        exception = YM_ILLEGAL_DATA_VALUE;
+                    } else {
+                        forward = true;
+                    }
+                }
+            }
+        } else if (function == 0x06) {
+            if (length != 12) {
+                exception = YM_ILLEGAL_DATA_VALUE;
+            } else {
+                forward = true;
+            }
+        } else if (function == 0x10) {
+            if (count == 0 || count > 123 || adu[12] != count * 2 ||
+                length != 13 + count * 2) {
+                exception = YM_ILLEGAL_DATA_VALUE;
+            } else {
+                forward = true;
+            }
+        } else {
+            exception = YM_ILLEGAL_FUNCTION;
+        }
+
+        if (forward) {
+            // The bus thread answers it and takes it out of the buffer
+            pthread_mutex_lock(&_lock);
+            from.sensor = sensor;
+            from.busy   = true;
+            _stats.forwarded++;
+            pthread_cond_signal(&_requestQueued);
+            pthread_mutex_unlock(&_lock);
+            return true;
+        }
+        if (exception != 0 && !sendException(from, exception)) return false;
+        memmove(adu, adu + length, from.received - length);
+        from.received -= length;
+    }
+    return true;
+}
+
+
+// This sends a response to the client's current request, with its transaction and
+// unit IDs
+bool yosemitechGateway::sendResponse(client& to, const byte* pdu, uint16_t length) {
+    byte frame[YM_MBAP_SIZE + 2 + 2 * 125];
+    memcpy(frame, to.adu, 4);  // the transaction ID and protocol ID
+    frame[4] = (length + 1) >> 8;
+    frame[5] = (length + 1) & 0xFF;
+    frame[6] = to.adu[6];
+    memcpy(frame + YM_MBAP_SIZE, pdu, length);
+    ssize_t sent = send(to.fd, frame, YM_MBAP_SIZE + length, YM_SEND_FLAGS);
+    return sent == YM_MBAP_SIZE + length;
+}
+
+
+bool yosemitechGateway::sendException(client& to, byte exception) {
+    byte pdu[2] = {(byte)(to.adu[7] | 0x80), exception};
+    return sendResponse(to, pdu, 2);
+}
+
+
+// This frees a client's slot; the lock must be held
+void yosemitechGateway::closeClient(client& which) {
+    close(which.fd);
+    which.fd       = -1;
+    which.busy     = false;
+    which.received = 0;
+    _stats.clients--;
+}
+
+
+void yosemitechGateway::wakeServer(void) {
+    byte wake = 0;
+    if (_wakeFds[1] >= 0 && write(_wakeFds[1], &wake, 1) < 0) {}
+}
+
+#endif
+
+// cspell: ignore MBAP NOSIGNAL NOSIGPIPE REUSEADDR NODELAY SETFL nfds revents
+// cspell: ignore pthread timedwait
@@ -0,0 +1,222 @@
+/**
+ * @file YosemitechGateway.h
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the declarations of a Modbus TCP gateway, for sharing the sensors
+ * on one serial bus with any number of network clients from a host build.
+ */
+
+#ifndef YosemitechGateway_h
+#define YosemitechGateway_h
+
+#include "YosemitechModbus.h"
+
+#ifdef YM_HOST_BUILD
+
+#include <pthread.h>
+
+/**
+ * @brief The most sensors one gateway can serve.
+ */
+#ifndef YM_GATEWAY_SENSORS
+#define YM_GATEWAY_SENSORS 32
+#endif
+
+/**
+ * @brief The most cached blocks of registers one gateway can keep.
+ *
+ * Each sensor added with yosemitechGateway::addSensor() uses 2 to 5 blocks.
+ */
+#ifndef YM_GATEWAY_BLOCKS
+#define YM_GATEWAY_BLOCKS 128
+#endif
+
+/**
+ * @brief The most registers in one cached block.
+ */
+#ifndef YM_GATEWAY_BLOCK_REGISTERS
+#define YM_GATEWAY_BLOCK_REGISTERS 32
+#endif
+
+/**
+ * @brief The most Modbus TCP clients connected at once.
+ */
+#ifndef YM_GATEWAY_CLIENTS
+#define YM_GATEWAY_CLIENTS 64
+#endif
+
+/**
+ * @brief Counters of what a gateway has done, to see how much bus traffic the cache
+ * is saving.
+ */
+typedef struct yosemitechGatewayStats {
+    uint32_t connections;      ///< The number of clients that have connected
+    uint32_t clients;          ///< The number of clients connected now
+    uint32_t requests;         ///< The number of requests from all clients
+    uint32_t cacheReads;       ///< Reads answered from the cache
+    uint32_t forwarded;        ///< Reads and writes sent on to a sensor
+    uint32_t refreshes;        ///< Cached blocks read from the sensors
+    uint32_t refreshFailures;  ///< Cached blocks that couldn't be read
+} yosemitechGatewayStats;
+
+/**
+ * @brief Serves the sensors on one serial bus to Modbus TCP clients, like a SCADA
+ * system, a historian and an engineering laptop all at once.
+ *
+ * The gateway owns the bus: once it has begun, only its bus thread talks to the
+ * sensors.  It keeps a cache of blocks of registers for each sensor - the values
+ * and the version and serial number registers, plus any blocks added with
+ * addBlock() - and refreshes each block from the sensor on its own interval.
+ *
+ * A client's read of holding registers (function 0x03) that falls within one cached
+ * block is answered straight from the cache, so every register in the response came
+ * from the same read of the sensor and the bus traffic doesn't grow with the number
+ * of clients.  Writes (functions 0x06 and 0x10) and reads outside the cache are
+ * queued and sent to the sensors one at a time between refreshes; a write also
+ * makes the cached blocks it overlaps refresh next.
+ *
+ * The Modbus TCP unit ID of a request is the slave ID of the sensor.  Exceptions
+ * from a sensor are passed back to the client; a sensor that doesn't answer, or
+ * whose cached block is too old (3 refresh intervals) is reported with exception
+ * 0x0B (gateway target failed to respond) and an unknown unit ID with 0x0A
+ * (gateway path unavailable).
+ *
+ * @code{.cpp}
+ * yosemitechSerialStream port("/dev/ttyUSB0");
+ * yosemitech             sonde;
+ * yosemitechGateway      gateway;
+ * port.begin(9600);
+ * sonde.begin(Y4000, 0x05, port);
+ * gateway.addSensor(sonde, 15000);  // refresh the values every 15 s
+ * gateway.begin(502);
+ * @endcode
+ */
+class yosemitechGateway {
+
+ public:
+    /**
+     * @brief Constructs a new gateway with no sensors.
+     */
+    yosemitechGateway();
+    ~yosemitechGateway();
+    yosemitechGateway(const yosemitechGateway&)            = delete;
+    yosemitechGateway& operator=(const yosemitechGateway&) = delete;
+
+    /**
+     * @brief Adds a sensor, with cached blocks for its values and its version and
+     * serial number registers.
+     *
+     * The value registers are the ones getValues() reads for the sensor's model:
+     * 0x2601 for the Y4000 and 0x2600 for most others.  The version and serial
+     * number are refreshed once a day.  Sensors can only be added before begin().
+     *
+     * @param sensor The sensor, already begun on the gateway's bus
+     * @param interval How often to refresh the values, in milliseconds
+     * @return *bool* True if the sensor was added, false if there was no room.
+     */
+    bool addSensor(yosemitech& sensor, uint32_t interval);
+
+    /**
+     * @brief Adds another block of holding registers to cache for a sensor, for
+     * example its calibration.
+     *
+     * The sensor is added too if it hasn't been already.  Blocks can only be added
+     * before begin().
+     *
+     * @param sensor The sensor, already begun on the gateway's bus
+     * @param regNum The first register of the block
+     * @param numRegisters The number of registers, up to #YM_GATEWAY_BLOCK_REGISTERS
+     * @param interval How often to refresh the block, in milliseconds
+     * @return *bool* True if the block was added, false if there was no room.
+     */
+    bool addBlock(yosemitech& sensor, uint16_t regNum, uint8_t numRegisters,
+                  uint32_t interval);
+
+    /**
+     * @brief Starts listening for clients and starts the bus and server threads.
+     *
+     * @param port The TCP port to listen on; 502 is the standard Modbus TCP port
+     * @param address The address to listen on.  Optional with a default value of
+     * "127.0.0.1", for clients on the same computer; use "0.0.0.0" for any.
+     * @return *bool* True if the gateway started, false if not.
+     */
+    bool begin(uint16_t port, const char* address = "127.0.0.1");
+
+    /**
+     * @brief Disconnects all clients and stops the threads.
+     */
+    void end(void);
+
+    /**
+     * @brief Gets the gateway's counters.
+     *
+     * @return *yosemitechGatewayStats* A copy of the counters
+     */
+    yosemitechGatewayStats getStats(void);
+
+ private:
+    /**
+     * @brief One block of registers in the cache.
+     */
+    typedef struct cacheBlock {
+        yosemitech* sensor;        ///< The sensor the registers are on
+        uint16_t    regNum;        ///< The first register
+        uint8_t     numRegisters;  ///< The number of registers
+        bool        values;        ///< True for measured values, false for metadata
+        uint32_t    interval;      ///< How often to refresh the block, in ms
+        uint32_t    fetched;       ///< The millis() value when it was last read
+        uint32_t    tried;         ///< The millis() value when it was last tried
+        bool        valid;         ///< True once the block has been read
+        bool        due;           ///< True to refresh it as soon as possible
+        byte        data[YM_GATEWAY_BLOCK_REGISTERS * 2];  ///< The register data
+    } cacheBlock;
+
+    /**
+     * @brief One connected client and the request it is waiting on, if any.
+     */
+    typedef struct client {
+        int         fd;        ///< The client's socket, or -1 for a free slot
+        bool        busy;      ///< True while its request is with the bus thread
+        uint16_t    received;  ///< The bytes of the next request received so far
+        byte        adu[260];  ///< The request being received or forwarded
+        yosemitech* sensor;    ///< The sensor a forwarded request is for
+    } client;
+
+    static void* busThread(void* gateway);
+    static void* serverThread(void* gateway);
+    void         runBus(void);
+    void         runServer(void);
+    bool         addCacheBlock(yosemitech& sensor, uint16_t regNum,
+                               uint8_t numRegisters, uint32_t interval, bool values);
+    yosemitech*  findSensor(byte slaveID);
+    bool         handleRequests(client& from);
+    void         forwardRequest(client& from);
+    bool         refreshBlock(cacheBlock& block);
+    bool         sendResponse(client& to, const byte* pdu, uint16_t length);
+    bool         sendException(client& to, byte exception);
+    void         closeClient(client& which);
+    void         wakeServer(void);
+
+    yosemitech* _sensors[YM_GATEWAY_SENSORS];  ///< The sensors on the bus
+    uint8_t     _numSensors;                   ///< The number of sensors
+    cacheBlock  _blocks[YM_GATEWAY_BLOCKS];    ///< The cached blocks
+    uint16_t    _numBlocks;                    ///< The number of cached blocks
+    client      _clients[YM_GATEWAY_CLIENTS];  ///< The client slots
+
+    yosemitechGatewayStats _stats;  ///< The counters
+
+    int             _listenFd;       ///< The listening socket, or -1
+    int             _wakeFds[2];     ///< A pipe the bus thread wakes the server with
+    bool            _running;        ///< True while the threads should run
+    pthread_t       _bus;            ///< The thread that owns the serial bus
+    pthread_t       _server;         ///< The thread that serves the clients
+    pthread_mutex_t _lock;           ///< Guards the cache, clients and counters
+    pthread_cond_t  _requestQueued;  ///< Signals the bus thread that work is waiting
+};
+
+#endif
+
+#endif
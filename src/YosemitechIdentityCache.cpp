@@ -0,0 +1,111 @@
+/**
+ * @file YosemitechIdentityCache.cpp
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the identity cache definitions.
+ */
+
+#include "YosemitechIdentityCache.h"
+
+// The layout version of a stored identity.  Change this whenever the record layout
+// or the order of the yosemitechModel enum changes so old records are ignored.
+#define YM_IDENTITY_LAYOUT 0x01
+
+
+// This calculates a Fletcher-16 checksum
+static uint16_t fletcher16(const byte data[], int length) {
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+    for (int i = 0; i < length; i++) {
+        sum1 = (sum1 + data[i]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+    return (sum2 << 8) | sum1;
+}
+
+
+// This packs an identity into a record
+//   byte 0      layout version
+//   byte 1      slave ID
+//   byte 2      model
+//   bytes 3-16  serial number (not null terminated)
+//   bytes 17-20 hardware version
+//   bytes 21-24 software version
+//   bytes 25-26 Fletcher-16 checksum of bytes 0-24
+void yosemitechIdentityCache::encode(const yosemitechIdentity& identity,
+                                     byte                      record[]) {
+    record[0] = YM_IDENTITY_LAYOUT;
+    record[1] = identity.slaveID;
+    record[2] = identity.model;
+    memcpy(record + 3, identity.serialNumber, 14);
+    memcpy(record + 17, &identity.hardwareVersion, 4);
+    memcpy(record + 21, &identity.softwareVersion, 4);
+    uint16_t checksum = fletcher16(record, recordSize - 2);
+    record[25]        = checksum >> 8;
+    record[26]        = checksum & 0xFF;
+}
+
+
+// This unpacks a record, checking the layout version and checksum
+bool yosemitechIdentityCache::decode(const byte          record[],
+                                     yosemitechIdentity& identity) {
+    if (record[0] != YM_IDENTITY_LAYOUT) return false;
+    uint16_t checksum = fletcher16(record, recordSize - 2);
+    if (record[25] != (checksum >> 8) || record[26] != (checksum & 0xFF)) {
+        return false;
+    }
+    identity.slaveID = record[1];
+    identity.model   = record[2];
+    memcpy(identity.serialNumber, record + 3, 14);
+    identity.serialNumber[14] = '\0';
+    memcpy(&identity.hardwareVersion, record + 17, 4);
+    memcpy(&identity.softwareVersion, record + 21, 4);
+    return true;
+}
+
+
+#ifdef YM_HOST_BUILD
+// This opens the file behind the store, creating it if needed
+yosemitechFileStore::yosemitechFileStore(const char* path, int size) : _size(size) {
+    _file = fopen(path, "r+b");
+    if (_file == nullptr) {
+        _file = fopen(path, "w+b");
+        if (_file == nullptr) return;
+    }
+    // Pad a new or short file out to the full size with "erased" bytes
+    fseek(_file, 0, SEEK_END);
+    for (long i = ftell(_file); i < _size; i++) { fputc(0xFF, _file); }
+    fflush(_file);
+}
+
+yosemitechFileStore::~yosemitechFileStore() {
+    if (_file != nullptr) fclose(_file);
+}
+
+
+// This reads one byte from the file
+uint8_t yosemitechFileStore::read(int address) {
+    if (_file == nullptr || address < 0 || address >= _size) return 0xFF;
+    fseek(_file, address, SEEK_SET);
+    int value = fgetc(_file);
+    return value == EOF ? 0xFF : (uint8_t)value;
+}
+
+
+// This writes one byte to the file
+void yosemitechFileStore::write(int address, uint8_t value) {
+    if (_file == nullptr || address < 0 || address >= _size) return;
+    fseek(_file, address, SEEK_SET);
+    fputc(value, _file);
+    fflush(_file);
+}
+
+
+// This returns the size of the store
+int yosemitechFileStore::length(void) {
+    return _file == nullptr ? 0 : _size;
+}
+#endif
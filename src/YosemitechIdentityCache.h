@@ -0,0 +1,271 @@
+/**
+ * @file YosemitechIdentityCache.h
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the identity cache declarations, used to skip identifying sensors
+ * of unknown model every time they are started.
+ */
+
+#ifndef YosemitechIdentityCache_h
+#define YosemitechIdentityCache_h
+
+#include <Arduino.h>
+
+/**
+ * @brief Defined when the library is built for a desktop operating system (for
+ * example, with an Arduino API emulation on Linux) instead of a microcontroller.
+ *
+ * Parts of the library that need an operating system are only built when this is
+ * defined.
+ */
+#if !defined(YM_HOST_BUILD) && (defined(__linux__) || defined(__APPLE__))
+#define YM_HOST_BUILD
+#endif
+
+#ifdef YM_HOST_BUILD
+#include <stdio.h>
+#endif
+
+/**
+ * @brief The number of sensors a byte store identity cache holds by default.
+ */
+#ifndef YM_IDENTITY_CACHE_SLOTS
+#define YM_IDENTITY_CACHE_SLOTS 4
+#endif
+
+/**
+ * @brief What a sensor told us about itself when it was identified.
+ */
+typedef struct yosemitechIdentity {
+    byte    slaveID;           ///< The modbus slave ID of the sensor
+    uint8_t model;             ///< The #yosemitechModel found from the serial number
+    char    serialNumber[15];  ///< The 14 character serial number, null terminated
+    float   hardwareVersion;   ///< The hardware version
+    float   softwareVersion;   ///< The software version
+} yosemitechIdentity;
+
+/**
+ * @brief The interface for somewhere to keep the identities of sensors between
+ * resets.
+ *
+ * Give one of these to yosemitech::setIdentityCache() before calling
+ * yosemitech::begin() with an #UNKNOWN model.
+ */
+class yosemitechIdentityCache {
+
+ public:
+    /**
+     * @brief The size of one stored identity, in bytes.
+     *
+     * A layout version, the slave ID, the model, 14 serial number characters, two
+     * 4-byte floats, and a 2-byte Fletcher-16 checksum.
+     */
+    static const int recordSize = 27;
+
+    virtual ~yosemitechIdentityCache() {}
+
+    /**
+     * @brief Looks up the identity of a sensor.
+     *
+     * @param slaveID The modbus slave ID to look up
+     * @param identity The identity to fill in if one is found
+     * @return *bool* True if a valid identity was found, false if not.
+     */
+    virtual bool load(byte slaveID, yosemitechIdentity& identity) = 0;
+
+    /**
+     * @brief Saves the identity of a sensor, replacing any older one for the same
+     * slave ID.
+     *
+     * @param identity The identity to save
+     * @return *bool* True if the identity was saved, false if not.
+     */
+    virtual bool store(const yosemitechIdentity& identity) = 0;
+
+    /**
+     * @brief Forgets the identity of a sensor.
+     *
+     * @param slaveID The modbus slave ID to forget
+     */
+    virtual void invalidate(byte slaveID) = 0;
+
+ protected:
+    /**
+     * @brief Packs an identity into a checksummed record.
+     *
+     * @param identity The identity to pack
+     * @param record A buffer of #recordSize bytes to fill
+     */
+    static void encode(const yosemitechIdentity& identity, byte record[]);
+
+    /**
+     * @brief Unpacks a record, checking its layout version and checksum.
+     *
+     * @param record A buffer of #recordSize bytes
+     * @param identity The identity to fill in
+     * @return *bool* True if the record was valid, false if not.
+     */
+    static bool decode(const byte record[], yosemitechIdentity& identity);
+};
+
+
+/**
+ * @brief An identity cache kept in an EEPROM-like byte store.
+ *
+ * The store can be any object with `read(address)`, `write(address, value)` and
+ * `length()` functions - like the Arduino `EEPROM` object or a
+ * #yosemitechFileStore.  Bytes are only written when they change, to save EEPROM
+ * wear.
+ *
+ * @note On boards that emulate EEPROM in flash (ESP8266, ESP32) you must call
+ * `EEPROM.begin(size)` before using the cache and `EEPROM.commit()` after the
+ * sensors have been started.
+ *
+ * @tparam Store The type of the byte store
+ */
+template <class Store>
+class yosemitechByteStoreCache : public yosemitechIdentityCache {
+
+ public:
+    /**
+     * @brief Constructs a new byte store identity cache.
+     *
+     * @param store The byte store to use
+     * @param startAddress The first address in the store to use
+     * @param numSlots The number of sensor identities to make room for; the cache
+     * takes up numSlots * #recordSize bytes.
+     */
+    explicit yosemitechByteStoreCache(Store& store, int startAddress = 0,
+                                      uint8_t numSlots = YM_IDENTITY_CACHE_SLOTS)
+        : _store(store),
+          _startAddress(startAddress),
+          _numSlots(numSlots) {}
+
+    bool load(byte slaveID, yosemitechIdentity& identity) override {
+        byte record[recordSize];
+        for (uint8_t slot = 0; slot < _numSlots; slot++) {
+            readSlot(slot, record);
+            if (decode(record, identity) && identity.slaveID == slaveID) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool store(const yosemitechIdentity& identity) override {
+        // Use the slot already holding this sensor, else the first empty one, else
+        // the one the slave ID hashes to
+        byte               record[recordSize];
+        yosemitechIdentity existing;
+        int                target = -1;
+        for (uint8_t slot = 0; slot < _numSlots; slot++) {
+            readSlot(slot, record);
+            bool valid = decode(record, existing);
+            if (valid && existing.slaveID == identity.slaveID) {
+                target = slot;
+                break;
+            }
+            if (!valid && target < 0) target = slot;
+        }
+        if (target < 0) target = identity.slaveID % _numSlots;
+        if (!slotFits(target)) return false;
+
+        encode(identity, record);
+        int address = _startAddress + target * recordSize;
+        for (int i = 0; i < recordSize; i++) {
+            if (_store.read(address + i) != record[i]) {
+                _store.write(address + i, record[i]);
+            }
+        }
+        return true;
+    }
+
+    void invalidate(byte slaveID) override {
+        byte               record[recordSize];
+        yosemitechIdentity existing;
+        for (uint8_t slot = 0; slot < _numSlots; slot++) {
+            readSlot(slot, record);
+            if (decode(record, existing) && existing.slaveID == slaveID) {
+                // Zeroing the layout version is enough to fail the check
+                _store.write(_startAddress + slot * recordSize, 0x00);
+            }
+        }
+    }
+
+ private:
+    bool slotFits(int slot) {
+        return _startAddress + (slot + 1) * recordSize <= (int)_store.length();
+    }
+    void readSlot(uint8_t slot, byte record[]) {
+        if (!slotFits(slot)) {
+            memset(record, 0, recordSize);
+            return;
+        }
+        int address = _startAddress + slot * recordSize;
+        for (int i = 0; i < recordSize; i++) { record[i] = _store.read(address + i); }
+    }
+
+    Store&  _store;         ///< The byte store holding the records
+    int     _startAddress;  ///< The first address used in the store
+    uint8_t _numSlots;      ///< The number of records
+};
+
+
+#ifdef YM_HOST_BUILD
+/**
+ * @brief An EEPROM-like byte store backed by a file, for host builds.
+ *
+ * Use it with a #yosemitechByteStoreCache to keep sensor identities in a file:
+ * @code{.cpp}
+ * yosemitechFileStore                           idStore("sensors.cache");
+ * yosemitechByteStoreCache<yosemitechFileStore> idCache(idStore);
+ * @endcode
+ *
+ * The file is created, filled with 0xFF like an erased EEPROM, if it doesn't exist.
+ * Every write is flushed to the file right away.
+ */
+class yosemitechFileStore {
+
+ public:
+    /**
+     * @brief Opens (or creates) the file behind the byte store.
+     *
+     * @param path The path of the file
+     * @param size The size of the store, in bytes
+     */
+    explicit yosemitechFileStore(const char* path, int size = 256);
+    ~yosemitechFileStore();
+    yosemitechFileStore(const yosemitechFileStore&)            = delete;
+    yosemitechFileStore& operator=(const yosemitechFileStore&) = delete;
+
+    /**
+     * @brief Reads one byte.
+     *
+     * @param address The address to read
+     * @return *uint8_t* The byte, or 0xFF if the file couldn't be read.
+     */
+    uint8_t read(int address);
+    /**
+     * @brief Writes one byte.
+     *
+     * @param address The address to write
+     * @param value The byte to write
+     */
+    void write(int address, uint8_t value);
+    /**
+     * @brief Gets the size of the store.
+     *
+     * @return *int* The size of the store in bytes, 0 if the file couldn't be opened.
+     */
+    int length(void);
+
+ private:
+    FILE* _file;  ///< The open file
+    int   _size;  ///< The size of the store
+};
+#endif
+
+#endif
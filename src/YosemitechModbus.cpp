@@ -23,11 +23,22 @@ bool yosemitech::begin(yosemitechModel model, byte modbusSlaveID, Stream* stream
                        int enablePin) {
     // Give values to variables;
     _model   = model;
-    _slaveID = modbusSlaveID;
+    _slaveID   = modbusSlaveID;
+    _stream    = stream;
+    _enablePin = enablePin;
     // Start up the modbus instance
     bool success = modbus.begin(modbusSlaveID, stream, enablePin);
+    // Save the default timeout and retries; the library does its own retries so it
+    // can stop early for exceptions and deadlines
+    if (_commandTimeout == 0) {
+        _commandTimeout = modbus.getCommandTimeout();
+        _commandRetries = modbus.getCommandRetries();
+    }
+    modbus.setCommandRetries(0);
+    // This may be a different sensor than before
+    clearRegisterCache();
     // Get the model type from the serial number if it's not known
-    if (_model == UNKNOWN) getSerialNumber();
+    if (_model == UNKNOWN) identify();
 
     return success;
 }
@@ -37,6 +48,50 @@ bool yosemitech::begin(yosemitechModel model, byte modbusSlaveID, Stream& stream
 }
 
 
+// This sets a cache to remember the identities of sensors of unknown model
+void yosemitech::setIdentityCache(yosemitechIdentityCache* cache, bool verify) {
+    _identityCache  = cache;
+    _verifyIdentity = verify;
+}
+
+
+// This works out the model of a sensor, from the cache if it can
+void yosemitech::identify(void) {
+    yosemitechIdentity identity;
+    if (_identityCache != nullptr && _identityCache->load(_slaveID, identity)) {
+        bool valid = true;
+        if (_verifyIdentity) {
+            // Re-reading the 2 version registers is much cheaper than reading and
+            // parsing the 7 register serial number
+            float hardwareVersion, softwareVersion;
+            valid = getVersion(hardwareVersion, softwareVersion) &&
+                hardwareVersion == identity.hardwareVersion &&
+                softwareVersion == identity.softwareVersion;
+        }
+        if (valid && identity.model < UNKNOWN) {
+            _model = identity.model;
+            return;
+        }
+    }
+
+    // Get the model type from the serial number
+    String SN = getSerialNumber();
+    if (_identityCache == nullptr) return;
+    if (_model == UNKNOWN) {
+        _identityCache->invalidate(_slaveID);
+        return;
+    }
+
+    // Save what was found for next time
+    identity.slaveID = _slaveID;
+    identity.model   = _model;
+    SN.toCharArray(identity.serialNumber, sizeof(identity.serialNumber));
+    if (getVersion(identity.hardwareVersion, identity.softwareVersion)) {
+        _identityCache->store(identity);
+    }
+}
+
+
 // This returns a pretty string with the model information
 String yosemitech::getModel(void) {
     switch (_model) {
@@ -253,26 +308,11 @@ byte yosemitech::getSlaveID(void) {
     // The size of the returned frame should be:
     // # Registers X 2 bytes/register + 5 bytes of modbus RTU frame
 
-    // Try up to 10 times to get the right results
-    int     tries    = 0;
-    int16_t respSize = 0;
-    while (respSize != (numRegisters * 2 + 5) && tries < 10) {
-        // Send out the command (this adds the CRC)
-        // TODO: figure out how to get around this modbusMaster error:
-        // "Response is not from the correct modbus slave!" error
-        // and why it causes respSize = 0
-        // Serial.println(respSize);
-        respSize = modbus.sendCommand(command, 8);
-        tries++;
-        delay(25);
-    }
-    if (respSize == (numRegisters * 2 + 5)) {
-        // Serial.print(F("Success!"));
-        return modbus.responseBuffer[3];
-    } else {
-        // Serial.print(F("Failed!"));
-        return modbus.responseBuffer[3];
-    }
+    // sendCommand() already retries and stops at the deadline, so this asks once
+    int16_t respSize = sendCommand(command, 8, metadataRead);
+    // Whatever went wrong, the buffer has no address in it
+    if (respSize != (numRegisters * 2 + 5)) return 0xFF;
+    return modbus.responseBuffer[3];
 }
 
 
@@ -280,7 +320,9 @@ byte yosemitech::getSlaveID(void) {
 // The slaveID is in register 0x3000 (12288)
 bool yosemitech::setSlaveID(byte newSlaveID) {
     byte dataToSend[2] = {newSlaveID, 0x00};
-    return modbus.setRegisters(0x3000, 1, dataToSend, true);
+    // Anything cached came from the sensor at its old address
+    clearRegisterCache();
+    return writeRegisters(0x3000, 1, dataToSend);
 }
 
 
@@ -291,10 +333,14 @@ String yosemitech::getSerialNumber(void) {
     String SN;
     switch (_model) {
         case Y4000:
-            SN = modbus.StringFromRegister(0x03, 0x1400, 14);
+            if (readRegisters(0x1400, 7, metadataRead, cacheIdentity)) {
+                SN = modbus.StringFromFrame(14);
+            }
             break;  // for Y4000 Sonde
         default:
-            SN = modbus.StringFromRegister(0x03, 0x0900, 14);
+            if (readRegisters(0x0900, 7, metadataRead, cacheIdentity)) {
+                SN = modbus.StringFromFrame(14);
+            }
             break;  // for all sensors except Y4000
     }
 
@@ -351,7 +397,7 @@ bool yosemitech::getVersion(float& hardwareVersion, float& softwareVersion) {
     // Parse into version numbers
     // These aren't actually little endian responses.  The first byte is the
     // major version and the second byte is the minor version.
-    if (modbus.getRegisters(0x03, 0x0700, 2)) {
+    if (readRegisters(0x0700, 2, metadataRead, cacheIdentity)) {
         hardwareVersion = modbus.byteFromFrame(3) +
             (float)modbus.byteFromFrame(4) / 100;
         softwareVersion = modbus.byteFromFrame(5) +
@@ -372,7 +418,7 @@ bool yosemitech::startMeasurement(void) {
             byte startMeasurementW[9] = {_slaveID, 0x10, 0x1C, 0x00, 0x00,
                                          0x00,     0x00, 0x00, 0x00};
             // _slaveID, Write, Reg 7168 ,0 Registers, 0byte,    CRC
-            int respSize = modbus.sendCommand(startMeasurementW, 9);
+            int respSize = sendCommand(startMeasurementW, 9);
             if (respSize == 8 && modbus.responseBuffer[0] == _slaveID)
                 return true;
             else
@@ -403,7 +449,7 @@ bool yosemitech::startMeasurement(void) {
             byte startMeasurementR[8] = {_slaveID, 0x03, 0x25, 0x00,
                                          0x00,     0x00, 0x00, 0x00};
             // _slaveID, Read,  Reg 9472 ,   0 Regs  ,    CRC
-            int respSize = modbus.sendCommand(startMeasurementR, 8);
+            int respSize = sendCommand(startMeasurementR, 8);
             if (respSize == 5 && modbus.responseBuffer[0] == _slaveID) {
                 return true;
             } else {
@@ -439,7 +485,7 @@ bool yosemitech::stopMeasurement(void) {
             byte stopMeasurement[8] = {_slaveID, 0x03, 0x2E, 0x00,
                                        0x00,     0x01, 0x00, 0x00};
             // _slaveID, Read,  Reg 11776,   1 Reg   ,    CRC
-            int respSize = modbus.sendCommand(stopMeasurement, 8);
+            int respSize = sendCommand(stopMeasurement, 8);
             // if (respSize == 5 && modbus.responseBuffer[0] == _slaveID) return true;
             if (respSize == 7 && modbus.responseBuffer[0] == _slaveID)
                 return true;
@@ -483,14 +529,18 @@ bool yosemitech::getValues(float& parmValue, float& tempValue, float& thirdValue
         case Y560: {
             // Y560 Ammonium has many parameters, but this will return the
             // three most important (NH4_N, Temp, pH). Other options are below.
-            if (modbus.getRegisters(0x03, 0x2600, 4)) {
+            if (readRegisters(0x2600, 4, valuesRead)) {
                 // default register gives potential & pH
                 // pH in registers 3-4 of 4 (starting in byte 7 of total response frame)
                 thirdValue = modbus.float32FromFrame(littleEndian, 7);
                 // Get temperature at register 0x2400. 32 bits = 4 bytes = 2 registers
-                tempValue = modbus.float32FromRegister(0x03, 0x2400, littleEndian);
+                if (readRegisters(0x2400, 2, valuesRead)) {
+                    tempValue = modbus.float32FromFrame(littleEndian, 3);
+                }
                 // Get NH3_N (mg/L) at register 0x2800
-                parmValue = modbus.float32FromRegister(0x03, 0x2800, littleEndian);
+                if (readRegisters(0x2800, 2, valuesRead)) {
+                    parmValue = modbus.float32FromFrame(littleEndian, 3);
+                }
                 errorCode = 0x00;  // No error code is provided
                 return true;
             }
@@ -500,11 +550,13 @@ bool yosemitech::getValues(float& parmValue, float& tempValue, float& thirdValue
         case Y550:
         // Y551 COD, with turbidity
         case Y551: {
-            if (modbus.getRegisters(0x03, 0x2600, 5)) {
+            if (readRegisters(0x2600, 5, valuesRead)) {
                 tempValue  = modbus.float32FromFrame(littleEndian, 3);
                 parmValue  = modbus.float32FromFrame(littleEndian, 7);
                 errorCode  = modbus.byteFromFrame(11);
-                thirdValue = modbus.float32FromRegister(0x03, 0x1200, littleEndian);
+                if (readRegisters(0x1200, 2, valuesRead)) {
+                    thirdValue = modbus.float32FromFrame(littleEndian, 3);
+                }
                 return true;
             }
             break;
@@ -513,12 +565,16 @@ bool yosemitech::getValues(float& parmValue, float& tempValue, float& thirdValue
         case Y532: {
             // According to the modbus manual we can get pH & potential starting at
             // Register 0x2600, but it appears that the manual is not accurate.
-            if (modbus.getRegisters(0x03, 0x2800, 2)) {
+            if (readRegisters(0x2800, 2, valuesRead)) {
                 parmValue = modbus.float32FromFrame(littleEndian, 3);
                 // Get temperature at register 0x2400
-                tempValue = modbus.float32FromRegister(0x03, 0x2400, littleEndian);
+                if (readRegisters(0x2400, 2, valuesRead)) {
+                    tempValue = modbus.float32FromFrame(littleEndian, 3);
+                }
                 // Get potential (mV) at register 0x1200
-                thirdValue = modbus.float32FromRegister(0x03, 0x1200, littleEndian);
+                if (readRegisters(0x1200, 2, valuesRead)) {
+                    thirdValue = modbus.float32FromFrame(littleEndian, 3);
+                }
                 errorCode  = 0x00;  // No error code is provided
                 return true;
             }
@@ -526,9 +582,11 @@ bool yosemitech::getValues(float& parmValue, float& tempValue, float& thirdValue
         }
         // Y533 (ORP)
         case Y533: {
-            if (modbus.getRegisters(0x03, 0x1200, 2)) {
+            if (readRegisters(0x1200, 2, valuesRead)) {
                 parmValue = modbus.float32FromFrame(littleEndian, 3);
-                tempValue = modbus.float32FromRegister(0x03, 0x2400, littleEndian);
+                if (readRegisters(0x2400, 2, valuesRead)) {
+                    tempValue = modbus.float32FromFrame(littleEndian, 3);
+                }
                 errorCode = 0x00;  // No error code is provided
                 return true;
             }
@@ -537,7 +595,7 @@ bool yosemitech::getValues(float& parmValue, float& tempValue, float& thirdValue
         // Y504 (DO)
         case Y502:
         case Y504: {
-            if (modbus.getRegisters(0x03, 0x2600, 6)) {
+            if (readRegisters(0x2600, 6, valuesRead)) {
                 tempValue       = modbus.float32FromFrame(littleEndian, 3);
                 float DOpercent = modbus.float32FromFrame(littleEndian, 7);
                 parmValue       = DOpercent * 100;  // Because it returns number not %
@@ -619,18 +677,20 @@ bool yosemitech::getValues(float& parmValue, float& tempValue, float& thirdValue
         }
         // Y700 Pressure/Depth
         case Y700: {
-            if (modbus.getRegisters(0x03, 0x2600, 6)) {
+            if (readRegisters(0x2600, 6, valuesRead)) {
                 parmValue = modbus.float32FromFrame(littleEndian, 7);
                 errorCode = modbus.byteFromFrame(11);
                 // Get temperature at register 0x2400, after Frame is read
-                tempValue = modbus.float32FromRegister(0x03, 0x2400, littleEndian);
+                if (readRegisters(0x2400, 2, valuesRead)) {
+                    tempValue = modbus.float32FromFrame(littleEndian, 3);
+                }
                 return true;
             }
             break;
         }
         // Y513 BGA
         case Y513: {
-            if (modbus.getRegisters(0x03, 0x2600, 4)) {
+            if (readRegisters(0x2600, 4, valuesRead)) {
                 tempValue = modbus.float32FromFrame(littleEndian, 3);
                 parmValue = modbus.float32FromFrame(littleEndian, 7);
                 errorCode = 0x00;  // No error code is provided
@@ -641,7 +701,7 @@ bool yosemitech::getValues(float& parmValue, float& tempValue, float& thirdValue
         // All other sensors not listed above: Y510, Y511, Y513
         // NOTE: new Y510/Y511 manual shows command similar to Y513 above
         default: {
-            if (modbus.getRegisters(0x03, 0x2600, 5)) {
+            if (readRegisters(0x2600, 5, valuesRead)) {
                 tempValue = modbus.float32FromFrame(littleEndian, 3);
                 parmValue = modbus.float32FromFrame(littleEndian, 7);
                 errorCode = modbus.byteFromFrame(11);
@@ -696,7 +756,7 @@ bool yosemitech::getValues(float& DOmgL, float& Turbidity, float& Cond, float& p
         case Y4000:  // Y4000 Multiparameter sonde
         {
             // Sonde's 8 values begin in register 260
-            if (modbus.getRegisters(0x03, 0x2601, 16))  // Modbus manual has error!
+            if (readRegisters(0x2601, 16, valuesRead))  // Modbus manual has error!
             {
                 DOmgL     = modbus.float32FromFrame(littleEndian, 3);   // DOmgL
                 Turbidity = modbus.float32FromFrame(littleEndian, 7);   // Turbidity
@@ -707,7 +767,9 @@ bool yosemitech::getValues(float& DOmgL, float& Turbidity, float& Cond, float& p
                 Chlorophyll = modbus.float32FromFrame(littleEndian, 27);  // Chlorophyll
                 BGA         = modbus.float32FromFrame(littleEndian, 31);  // Blue Green
                 // Error code is separately stored in register 0x0800
-                errorCode = modbus.byteFromRegister(0x03, 0x0800, 1);
+                if (readRegisters(0x0800, 1, valuesRead)) {
+                    errorCode = modbus.byteFromFrame(3);
+                }
                 return true;
             }
             break;
@@ -727,6 +789,22 @@ bool yosemitech::getValues(float& firstValue, float& secondValue, float& thirdVa
 }
 
 
+// This gets however many values the sensor has into a reading
+bool yosemitech::getReading(yosemitechReading& reading) {
+    reading.time    = _clock->millis();
+    reading.slaveID = _slaveID;
+    for (uint8_t i = 0; i < YM_MAX_VALUES; i++) { reading.values[i] = -9999; }
+    float* v = reading.values;
+    if (_model == Y4000) {
+        reading.numValues = 8;
+        return getValues(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7],
+                         reading.errorCode);
+    }
+    reading.numValues = 3;
+    return getValues(v[0], v[1], v[2], reading.errorCode);
+}
+
+
 // This returns the main "parameter" value as a float
 // NOTE:  This will return -9999 for a sonde!
 float yosemitech::getValue(void) {
@@ -811,7 +889,7 @@ bool yosemitech::getCalibration(float& K1, float& K2, float& K3, float& K4, floa
     switch (_model) {
         case Y532:  // pH
         {
-            if (modbus.getRegisters(0x03, 0x2900, 12)) {
+            if (readRegisters(0x2900, 12, metadataRead, cacheCalibration)) {
                 K1 = modbus.float32FromFrame(littleEndian, 3);
                 K2 = modbus.float32FromFrame(littleEndian, 7);
                 K3 = modbus.float32FromFrame(littleEndian, 11);
@@ -824,7 +902,7 @@ bool yosemitech::getCalibration(float& K1, float& K2, float& K3, float& K4, floa
         }
         case Y533:  // ORP
         {
-            if (modbus.getRegisters(0x03, 0x3400, 4)) {
+            if (readRegisters(0x3400, 4, metadataRead, cacheCalibration)) {
                 K1 = modbus.float32FromFrame(littleEndian, 3);
                 K2 = modbus.float32FromFrame(littleEndian, 7);
                 return true;
@@ -840,7 +918,7 @@ bool yosemitech::getCalibration(float& K1, float& K2, float& K3, float& K4, floa
             K4 = -9999;
             K5 = -9999;
             K6 = -9999;
-            if (modbus.getRegisters(0x03, 0x1100, 4)) {
+            if (readRegisters(0x1100, 4, metadataRead, cacheCalibration)) {
                 K1 = modbus.float32FromFrame(littleEndian, 3);
                 K2 = modbus.float32FromFrame(littleEndian, 7);
                 return true;
@@ -879,7 +957,7 @@ bool yosemitech::setCalibration(float K, float B) {
             };
             modbus.float32ToFrame(K, littleEndian, calibs, 0);
             modbus.float32ToFrame(B, littleEndian, calibs, 4);
-            return modbus.setRegisters(0x3400, 4, calibs, true);
+            return writeRegisters(0x3400, 4, calibs);
         }
         case Y4000: {
             return false;
@@ -890,7 +968,7 @@ bool yosemitech::setCalibration(float K, float B) {
             };
             modbus.float32ToFrame(K, littleEndian, calibs, 0);
             modbus.float32ToFrame(B, littleEndian, calibs, 4);
-            return modbus.setRegisters(0x1100, 4, calibs, true);
+            return writeRegisters(0x1100, 4, calibs);
         }
     }
 }
@@ -909,7 +987,7 @@ bool yosemitech::setCalibration(float K1, float K2, float K3, float K4, float K5
     modbus.float32ToFrame(K4, littleEndian, pHCalibs, 12);
     modbus.float32ToFrame(K5, littleEndian, pHCalibs, 16);
     modbus.float32ToFrame(K6, littleEndian, pHCalibs, 20);
-    return modbus.setRegisters(0x2900, 12, pHCalibs, true);
+    return writeRegisters(0x2900, 12, pHCalibs);
 }
 
 // This sets the 3 calibration points for a pH sensor
@@ -920,7 +998,14 @@ bool yosemitech::setCalibration(float K1, float K2, float K3, float K4, float K5
 //   3. Repeat for points 2 and 3 (pH of 4.00, 6.86, and 9.18 recommended)
 //   4. Read calibration status (ie, run command pHCalibrationStatus())
 bool yosemitech::pHCalibrationPoint(float pH) {
-    return modbus.float32ToRegister(0x2300, pH, littleEndian);
+    byte pHBytes[4] = {
+        0x00,
+    };
+    modbus.float32ToFrame(pH, littleEndian, pHBytes, 0);
+    // The sensor works out new coefficients from the points, so any cached ones are
+    // out of date
+    invalidateCache(0x2900, 12);
+    return writeRegisters(0x2300, 2, pHBytes);
 }
 
 // This verifies the success of a calibration
@@ -932,7 +1017,7 @@ bool yosemitech::pHCalibrationPoint(float pH) {
 //   0x05 - Error in sending command or receiving response+
 //   The calibration status is in register 0x0E00 (3584)
 byte yosemitech::pHCalibrationStatus(void) {
-    bool success = modbus.getRegisters(0x03, 0x0E00, 1);
+    bool success = readRegisters(0x0E00, 1);
 
     // Parse the response
     if (success) {
@@ -957,7 +1042,7 @@ bool yosemitech::setCapCoefficients(float K0, float K1, float K2, float K3, floa
     modbus.float32ToFrame(K5, littleEndian, capCoeffs, 20);
     modbus.float32ToFrame(K6, littleEndian, capCoeffs, 24);
     modbus.float32ToFrame(K7, littleEndian, capCoeffs, 28);
-    return modbus.setRegisters(9984, 16, capCoeffs, true);
+    return writeRegisters(9984, 16, capCoeffs);
 }
 
 // This immediately activates the cleaning brush for sensors with one.
@@ -968,7 +1053,7 @@ bool yosemitech::activateBrush(void) {
             byte activateBrush[9] = {_slaveID, 0x10, 0x2F, 0x00, 0x00,
                                      0x00,     0x00, 0x00, 0x00};
             // _slaveID, Write, Reg ???? ,0 Registers, 0byte,    CRC
-            int respSize = modbus.sendCommand(activateBrush, 9);
+            int respSize = sendCommand(activateBrush, 9);
             if (respSize == 8 && modbus.responseBuffer[0] == _slaveID)
                 return true;
             else
@@ -979,7 +1064,7 @@ bool yosemitech::activateBrush(void) {
             byte activateBrush[9] = {_slaveID, 0x10, 0x31, 0x00, 0x00,
                                      0x00,     0x00, 0x00, 0x00};
             // _slaveID, Write, Reg 7168 ,0 Registers, 0byte,    CRC
-            int respSize = modbus.sendCommand(activateBrush, 9);
+            int respSize = sendCommand(activateBrush, 9);
             if (respSize == 8 && modbus.responseBuffer[0] == _slaveID)
                 return true;
             else
@@ -995,10 +1080,18 @@ bool yosemitech::setBrushInterval(uint16_t intervalMinutes) {
     switch (_model) {
         case Y4000:  // Y4000 Multiparameter sonde
         {
-            return modbus.uint16ToRegister(0x0E00, intervalMinutes, littleEndian, true);
+            byte intervalBytes[2] = {
+                0x00,
+            };
+            modbus.uint16ToFrame(intervalMinutes, littleEndian, intervalBytes, 0);
+            return writeRegisters(0x0E00, 1, intervalBytes);
         }
         default: {
-            return modbus.uint16ToRegister(0x3200, intervalMinutes, littleEndian, true);
+            byte intervalBytes[2] = {
+                0x00,
+            };
+            modbus.uint16ToFrame(intervalMinutes, littleEndian, intervalBytes, 0);
+            return writeRegisters(0x3200, 1, intervalBytes);
         }
     }
 }
@@ -1010,12 +1103,487 @@ uint16_t yosemitech::getBrushInterval(void) {
     switch (_model) {
         case Y4000:  // Y4000 Multiparameter sonde
         {
-            return modbus.int16FromRegister(0x03, 0x0E00, littleEndian);
+            if (readRegisters(0x0E00, 1, metadataRead, cacheSetting)) {
+                return modbus.int16FromFrame(littleEndian, 3);
+            }
+            return 0;
         }
         default: {
-            return modbus.int16FromRegister(0x03, 0x3200, littleEndian);
+            if (readRegisters(0x3200, 1, metadataRead, cacheSetting)) {
+                return modbus.int16FromFrame(littleEndian, 3);
+            }
+            return 0;
+        }
+    }
+}
+
+
+// This sets an absolute deadline for all following communication
+void yosemitech::setDeadline(uint32_t deadline) {
+    _hasDeadline = true;
+    _deadline    = deadline;
+}
+
+
+// This removes the deadline
+void yosemitech::clearDeadline(void) {
+    _hasDeadline = false;
+}
+
+
+// This checks if the deadline has passed
+bool yosemitech::deadlineExpired(void) {
+    return _hasDeadline && getTimeRemaining() == 0;
+}
+
+
+// This returns the time left before the deadline
+// The subtraction is done on signed values so it survives millis() rolling over
+uint32_t yosemitech::getTimeRemaining(void) {
+    if (!_hasDeadline) return UINT32_MAX;
+    int32_t remaining = (int32_t)(_deadline - _clock->millis());
+    if (remaining <= 0) return 0;
+    return (uint32_t)remaining;
+}
+
+
+// This turns the adaptive response timeout on or off
+void yosemitech::setAdaptiveTimeout(bool enable) {
+    _adaptiveTimeout = enable;
+}
+
+
+// This sets the baud rate used to calculate the frame timing
+// Modbus RTU characters are 11 bits long (start bit, 8 data bits, parity or a second
+// stop bit, and a stop bit).  Frames must be separated by at least 3.5 characters of
+// silence and a gap of more than 1.5 characters ends a frame.  Above 19200 baud the
+// specification fixes the gaps at 1750 µs and 750 µs.
+void yosemitech::setBaudRate(uint32_t baudRate) {
+    if (baudRate == 0) return;
+    if (baudRate > 19200) {
+        _frameGap = 1750;
+    } else {
+        // 3.5 characters * 11 bits, rounded up to the next microsecond
+        _frameGap = (38500000UL + baudRate - 1) / baudRate;
+    }
+    // The modbusMaster only times frames in whole milliseconds, so it can't tell a
+    // 1.5 character gap from the end of the frame; use the 3.5 character gap.
+    modbus.setFrameTimeout((_frameGap + 999) / 1000);
+}
+
+
+// This returns the silent interval between frames in microseconds
+uint32_t yosemitech::getFrameGap(void) {
+    return _frameGap;
+}
+
+
+void yosemitech::setClock(yosemitechClock& clock) {
+    _clock = &clock;
+}
+
+
+yosemitechClock& yosemitech::getClock(void) {
+    return *_clock;
+}
+
+
+// This returns the result of the last command sent to the sensor
+yosemitechError yosemitech::getLastError(void) {
+    return _lastError;
+}
+
+
+// This returns the transaction counters
+yosemitechStats yosemitech::getStats(void) {
+    return _stats;
+}
+
+
+// This zeros the transaction counters
+void yosemitech::resetStats(void) {
+    _stats = yosemitechStats();
+}
+
+
+// This turns the register cache on or off
+void yosemitech::setRegisterCache(bool enable) {
+    _registerCacheOn = enable;
+    if (!enable) clearRegisterCache();
+}
+
+
+// This empties the register cache
+void yosemitech::clearRegisterCache(void) {
+    for (uint8_t i = 0; i < YM_REGISTER_CACHE_SIZE; i++) {
+        _registerCache[i].function = 0;
+    }
+}
+
+
+//----------------------------------------------------------------------------
+//                          PRIVATE TRANSACTION FUNCTIONS
+//----------------------------------------------------------------------------
+
+
+// This fits the modbus timeout into the time left before the deadline, waits out
+// the gap since the last frame and clears the line.  The library does its own
+// retries, so the modbusMaster is only ever asked to send a command once.
+bool yosemitech::startTransaction(transactionType type, uint16_t requestLength) {
+    // Start from the learned timeout for this kind of transaction, if there is one
+    uint32_t timeout = _commandTimeout;
+    if (_adaptiveTimeout && _rtt[type].timeout != 0) timeout = _rtt[type].timeout;
+
+    if (_hasDeadline) {
+        // The gap and the request come before the wait for the response.  A character
+        // is 2/7 of the gap, which overestimates it a little above 19200 baud.
+        uint32_t charTime  = _frameGap * 2 / 7;
+        uint32_t sending   = (_frameGap + requestLength * charTime + 999) / 1000;
+        uint32_t remaining = getTimeRemaining();
+        if (remaining <= sending) {
+            _lastError = YM_DEADLINE_EXPIRED;
+            return false;
+        }
+        // Never wait longer for a response than the time left
+        remaining -= sending;
+        if (timeout == 0 || timeout > remaining) timeout = remaining;
+    }
+    modbus.setCommandTimeout(timeout);
+    waitForFrameGap();
+    flushInput(timeout);
+
+    // Clear the last response so nothing in it can be mistaken for part of the next
+    memset(modbus.responseBuffer, 0, RESPONSE_BUFFER_SIZE);
+    return true;
+}
+
+
+// This waits out the rest of the silent interval since the last frame ended
+void yosemitech::waitForFrameGap(void) {
+    uint32_t quiet = _clock->micros() - _lastFrameEnd;
+    if (quiet >= _frameGap) return;
+    _clock->delayMicroseconds(_frameGap - quiet);
+}
+
+
+// This reads and drops bytes until the line has been quiet for a frame gap.  With
+// nothing waiting, which is almost always, it returns straight away.
+void yosemitech::flushInput(uint32_t timeout) {
+    if (_stream == nullptr || _stream->available() == 0) return;
+    uint32_t start = _clock->millis();
+    uint32_t quiet = _clock->micros();
+    uint32_t silent;
+    while ((silent = _clock->micros() - quiet) < _frameGap &&
+           _clock->millis() - start < timeout) {
+        if (_stream->available() > 0) {
+            _stream->read();
+            _stats.staleBytes++;
+            quiet = _clock->micros();
+        } else {
+            _clock->idle(_frameGap - silent);
+        }
+    }
+    _lastFrameEnd = _clock->micros();
+}
+
+
+// This drives the RS485 enable pin around the command like the modbusMaster does,
+// then feeds each byte of the response to the frame parser as it arrives
+int16_t yosemitech::exchange(const byte command[], uint8_t commandLength,
+                             const byte data[], uint16_t dataLength, int16_t length) {
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 0; i < commandLength; i++) {
+        crc = yosemitechFrameParser::crcUpdate(crc, command[i]);
+    }
+    for (uint16_t i = 0; i < dataLength; i++) {
+        crc = yosemitechFrameParser::crcUpdate(crc, data[i]);
+    }
+    byte crcBytes[2] = {(byte)(crc & 0xFF), (byte)(crc >> 8)};
+    if (_debugStream != nullptr) {
+        _debugStream->print(F("Command: "));
+        debugBytes(command, commandLength);
+        debugBytes(data, dataLength);
+        debugBytes(crcBytes, 2);
+        _debugStream->println();
+    }
+
+    if (_enablePin >= 0) digitalWrite(_enablePin, HIGH);
+    _stream->write(command, commandLength);
+    if (dataLength > 0) _stream->write(data, dataLength);
+    _stream->write(crcBytes, 2);
+    _stream->flush();
+    if (_enablePin >= 0) digitalWrite(_enablePin, LOW);
+
+    yosemitechFrameParser parser(modbus.responseBuffer, RESPONSE_BUFFER_SIZE);
+    parser.begin(command[0], command[1], length);
+    yosemitechFrameStatus status   = YM_FRAME_INCOMPLETE;
+    uint32_t              timeout  = modbus.getCommandTimeout();
+    uint32_t              start    = _clock->millis();
+    uint32_t              lastByte = 0;
+    uint16_t              received = 0;
+    uint32_t              elapsed;
+    while (status == YM_FRAME_INCOMPLETE &&
+           (elapsed = _clock->millis() - start) < timeout) {
+        if (_stream->available() > 0) {
+            status   = parser.add(_stream->read());
+            lastByte = _clock->micros();
+            received++;
+            continue;
+        }
+        // Once the line goes quiet after enough bytes for the response, it was
+        // garbled.  Short of that, a gap may just be a USB adapter holding bytes
+        // back, so allow a little longer before giving up on the rest.  The clock is
+        // only read once, so the time left can't go below zero, and it is kept short
+        // enough to fit in microseconds.
+        uint32_t wait = min(timeout - elapsed, (uint32_t)1000000UL) * 1000;
+        if (received > 0) {
+            uint32_t quiet = _clock->micros() - lastByte;
+            uint32_t limit = received >= (uint16_t)length
+                ? _frameGap
+                : max(_frameGap, (uint32_t)20000);
+            if (quiet >= limit) break;
+            if (limit - quiet < wait) wait = limit - quiet;
+        }
+        _clock->idle(wait);
+    }
+    if (parser.getSkipped() > 0) _stats.resyncs++;
+
+    if (_debugStream != nullptr) {
+        _debugStream->print(F("Response: "));
+        debugBytes(modbus.responseBuffer, parser.getLength());
+        _debugStream->println();
+    }
+    if (status == YM_FRAME_COMPLETE) return parser.getLength();
+    // Make sure nothing left in the buffer looks like an exception
+    if (status != YM_FRAME_EXCEPTION) modbus.responseBuffer[1] = 0x00;
+    return 0;
+}
+
+
+void yosemitech::debugBytes(const byte bytes[], uint16_t length) {
+    for (uint16_t i = 0; i < length; i++) {
+        if (bytes[i] < 0x10) _debugStream->print('0');
+        _debugStream->print(bytes[i], HEX);
+        _debugStream->print(' ');
+    }
+}
+
+
+// This records the result of a transaction and updates the round trip time estimate
+// for its type using the retransmission timeout algorithm from RFC 6298:
+//   RTTVAR = 3/4 * RTTVAR + 1/4 * |SRTT - R|
+//   SRTT   = 7/8 * SRTT + 1/8 * R
+//   RTO    = SRTT + 4 * RTTVAR
+// Transactions without a response double the timeout instead, up to the modbus
+// default.  An exception response is a response, so it is timed like any other but
+// it is not worth retrying.
+bool yosemitech::endTransaction(transactionType type, uint32_t start, bool success) {
+    _lastFrameEnd    = _clock->micros();
+    uint32_t elapsed = _clock->millis() - start;
+    _stats.transactions++;
+    _stats.busTime += elapsed;
+
+    // An exception response echoes the function code with the high bit set,
+    // followed by the exception code
+    bool exception = !success && (modbus.responseBuffer[1] & 0x80) &&
+        modbus.responseBuffer[2] != 0x00;
+    if (success) {
+        _lastError = YM_SUCCESS;
+    } else if (exception) {
+        _lastError = (yosemitechError)modbus.responseBuffer[2];
+        _stats.exceptions++;
+        _stats.exceptionTime += elapsed;
+    } else {
+        _lastError = YM_NO_RESPONSE;
+        _stats.timeouts++;
+        _stats.timeoutTime += elapsed;
+    }
+
+    rttEstimate& est    = _rtt[type];
+    uint32_t     maxRTO = _commandTimeout;
+    if (maxRTO > (UINT16_MAX >> 3)) maxRTO = UINT16_MAX >> 3;
+
+    if (!success && !exception) {
+        // Back off; an untimed transaction is already at the maximum
+        if (est.timeout != 0) {
+            uint32_t backedOff = (uint32_t)est.timeout * 2;
+            est.timeout        = backedOff < maxRTO ? backedOff : maxRTO;
         }
+        return true;
+    }
+    if (elapsed > maxRTO) return false;
+
+    if (est.smoothed == 0) {
+        // First measurement
+        est.smoothed = elapsed << 3;
+        est.variance = elapsed << 1;  // elapsed/2, scaled by 4
+    } else {
+        int32_t err = (int32_t)elapsed - (est.smoothed >> 3);
+        est.smoothed += err;  // += err/8, scaled by 8
+        if (err < 0) err = -err;
+        est.variance += err - (est.variance >> 2);  // += (|err| - var)/4, scaled by 4
+    }
+
+    // RTO = SRTT + 4 * RTTVAR, clamped to safe bounds
+    uint32_t rto = (est.smoothed >> 3) + est.variance;
+    if (rto < YM_MIN_RESPONSE_TIMEOUT) rto = YM_MIN_RESPONSE_TIMEOUT;
+    if (rto > maxRTO) rto = maxRTO;
+    est.timeout = rto;
+    return false;
+}
+
+
+// This returns the time a class of cached registers can be kept
+uint32_t yosemitech::cacheTTL(uint8_t lifetime) {
+    switch (lifetime) {
+        case cacheIdentity: return YM_CACHE_TTL_IDENTITY;
+        case cacheCalibration: return YM_CACHE_TTL_CALIBRATION;
+        case cacheSetting: return YM_CACHE_TTL_SETTING;
+        default: return 0;
+    }
+}
+
+
+// This looks for an unexpired register read in the cache and copies it into the
+// response buffer, with the same header a real response would have, so the frame
+// parsing functions work on it unchanged; like a real response, it clears the last
+// error.
+bool yosemitech::readFromCache(int regNum, int16_t numRegisters) {
+    if (!_registerCacheOn) return false;
+    for (uint8_t i = 0; i < YM_REGISTER_CACHE_SIZE; i++) {
+        registerCacheEntry& entry = _registerCache[i];
+        if (entry.function != 0x03 || entry.regNum != regNum ||
+            entry.numRegisters != numRegisters) {
+            continue;
+        }
+        if (_clock->millis() - entry.fetched >= cacheTTL(entry.lifetime)) {
+            entry.function = 0;  // expired
+            break;
+        }
+        modbus.responseBuffer[0] = _slaveID;
+        modbus.responseBuffer[1] = entry.function;
+        modbus.responseBuffer[2] = numRegisters * 2;
+        memcpy(modbus.responseBuffer + 3, entry.data, numRegisters * 2);
+        _stats.cacheHits++;
+        _lastError = YM_SUCCESS;
+        return true;
+    }
+    _stats.cacheMisses++;
+    return false;
+}
+
+
+// This saves the read in the response buffer into the cache, replacing an empty
+// entry if there is one or else the oldest
+void yosemitech::saveToCache(int regNum, int16_t numRegisters, cacheClass lifetime) {
+    if (!_registerCacheOn || numRegisters * 2 > YM_REGISTER_CACHE_BYTES) return;
+    uint32_t now    = _clock->millis();
+    uint8_t  slot   = 0;
+    uint32_t oldest = 0;
+    for (uint8_t i = 0; i < YM_REGISTER_CACHE_SIZE; i++) {
+        if (_registerCache[i].function == 0) {
+            slot = i;
+            break;
+        }
+        if (now - _registerCache[i].fetched >= oldest) {
+            oldest = now - _registerCache[i].fetched;
+            slot   = i;
+        }
+    }
+    registerCacheEntry& entry = _registerCache[slot];
+    entry.fetched             = now;
+    entry.regNum              = regNum;
+    entry.function            = 0x03;
+    entry.numRegisters        = numRegisters;
+    entry.lifetime            = lifetime;
+    memcpy(entry.data, modbus.responseBuffer + 3, numRegisters * 2);
+}
+
+
+// This drops cached reads that overlap a range of written registers
+void yosemitech::invalidateCache(int regNum, uint16_t numRegisters) {
+    for (uint8_t i = 0; i < YM_REGISTER_CACHE_SIZE; i++) {
+        registerCacheEntry& entry = _registerCache[i];
+        if (entry.function == 0) continue;
+        if (entry.regNum < regNum + numRegisters &&
+            regNum < entry.regNum + entry.numRegisters) {
+            entry.function = 0;
+        }
+    }
+}
+
+
+// This reads holding registers into the modbus response buffer, from the cache if
+// the registers are cacheable and have been read recently
+bool yosemitech::readRegisters(int regNum, int16_t numRegisters, transactionType type,
+                               cacheClass lifetime) {
+    if (lifetime != cacheNever && readFromCache(regNum, numRegisters)) return true;
+    byte command[6] = {_slaveID, 0x03, (byte)(regNum >> 8), (byte)regNum,
+                       (byte)(numRegisters >> 8), (byte)numRegisters};
+    bool success    = false;
+    for (uint8_t tries = 0; !success && tries <= _commandRetries; tries++) {
+        if (!startTransaction(type)) break;
+        uint32_t start = _clock->millis();
+        success        = exchange(command, 6, nullptr, 0, numRegisters * 2 + 5) > 0;
+        bool retry     = endTransaction(type, start, success);
+        YM_TRACE_TRANSACTION(0x03, _slaveID, regNum, numRegisters, _lastError, start,
+                             _clock->millis());
+        if (!retry) break;
+    }
+    if (success && lifetime != cacheNever) saveToCache(regNum, numRegisters, lifetime);
+    return success;
+}
+
+
+// This writes holding registers, always using function 0x10 (write multiple)
+bool yosemitech::writeRegisters(int regNum, uint16_t numRegisters, byte value[]) {
+    // Whether or not the write works, what's cached may no longer be right
+    invalidateCache(regNum, numRegisters);
+    byte command[7] = {_slaveID, 0x10, (byte)(regNum >> 8), (byte)regNum,
+                       (byte)(numRegisters >> 8), (byte)numRegisters,
+                       (byte)(numRegisters * 2)};
+    bool success    = false;
+    for (uint8_t tries = 0; !success && tries <= _commandRetries; tries++) {
+        if (!startTransaction(registerWrite, 9 + numRegisters * 2)) break;
+        uint32_t start = _clock->millis();
+        success        = exchange(command, 7, value, numRegisters * 2, 8) > 0;
+        bool retry     = endTransaction(registerWrite, start, success);
+        YM_TRACE_TRANSACTION(0x10, _slaveID, regNum, numRegisters, _lastError, start,
+                             _clock->millis());
+        if (!retry) break;
+    }
+    return success;
+}
+
+
+// This sends a raw command to the sensor
+// An exception response is reported as no response, so callers checking only the
+// response size can't mistake it for a short reply.
+int16_t yosemitech::sendCommand(byte command[], int commandLength,
+                                transactionType type) {
+    // The length of a normal response, for the reads and writes it can be known for
+    int16_t length = 0;
+    if (command[1] == 0x03 || command[1] == 0x04) length = command[5] * 2 + 5;
+    if (command[1] == 0x06 || command[1] == 0x10) length = 8;
+
+    int16_t respSize = 0;
+    for (uint8_t tries = 0; respSize == 0 && tries <= _commandRetries; tries++) {
+        if (!startTransaction(type, commandLength)) break;
+        uint32_t start = _clock->millis();
+        if (length > 0) {
+            respSize = exchange(command, commandLength - 2, nullptr, 0, length);
+        } else {
+            // Anything else is left to the modbusMaster to receive
+            respSize = modbus.sendCommand(command, commandLength);
+            if (respSize > 0 && (modbus.responseBuffer[1] & 0x80)) respSize = 0;
+        }
+        bool retry = endTransaction(type, start, respSize > 0);
+        // Every raw command is a standard request frame with its register and count
+        YM_TRACE_TRANSACTION(command[1], command[0], (command[2] << 8) | command[3],
+                             command[5], _lastError, start, _clock->millis());
+        if (!retry) break;
     }
+    return respSize;
 }
 
 // cspell: ignore fram Tkelvin baroPressure calibs capCoeffs
@@ -13,6 +13,65 @@
 
 #include <Arduino.h>
 #include <SensorModbusMaster.h>
+#include "YosemitechClock.h"
+#include "YosemitechFrameParser.h"
+#include "YosemitechIdentityCache.h"
+#include "YosemitechTrace.h"
+
+/**
+ * @brief The shortest response timeout in milliseconds the adaptive timeout will use.
+ *
+ * At 9600 baud just the shortest response frame takes ~7 ms to transmit.
+ */
+#ifndef YM_MIN_RESPONSE_TIMEOUT
+#define YM_MIN_RESPONSE_TIMEOUT 30
+#endif
+
+/**
+ * @brief The number of register reads each sensor object keeps in its register cache.
+ *
+ * Each entry takes about 33 bytes of RAM.  Four is enough for the version, serial
+ * number, calibration and brush interval of one sensor.
+ */
+#ifndef YM_REGISTER_CACHE_SIZE
+#define YM_REGISTER_CACHE_SIZE 4
+#endif
+
+/**
+ * @brief The largest read, in bytes, that will be kept in the register cache.
+ *
+ * The largest static read is the 12 register pH calibration.
+ */
+#ifndef YM_REGISTER_CACHE_BYTES
+#define YM_REGISTER_CACHE_BYTES 24
+#endif
+
+/**
+ * @brief How long in milliseconds the cached version and serial number are used
+ * before they are read again.
+ */
+#ifndef YM_CACHE_TTL_IDENTITY
+#define YM_CACHE_TTL_IDENTITY 86400000UL
+#endif
+
+/**
+ * @brief How long in milliseconds cached calibration coefficients are used before
+ * they are read again.
+ */
+#ifndef YM_CACHE_TTL_CALIBRATION
+#define YM_CACHE_TTL_CALIBRATION 3600000UL
+#endif
+
+/**
+ * @brief How long in milliseconds a cached brush interval is used before it is read
+ * again.
+ *
+ * This is kept short because the sensors reset the brush interval whenever they lose
+ * power.
+ */
+#ifndef YM_CACHE_TTL_SETTING
+#define YM_CACHE_TTL_SETTING 60000UL
+#endif
 
 /**
  * @brief The various Yosemitech sensors.
@@ -55,6 +114,63 @@ typedef enum yosemitechModel {
              ///<  number of an unknown model.
 } yosemitechModel;
 
+/**
+ * @brief The result of the last command sent to a sensor.
+ *
+ * Values below 0xE0 are the exception codes a sensor sends back when it refuses a
+ * request, as defined by the Modbus specification.
+ */
+typedef enum yosemitechError {
+    YM_SUCCESS                  = 0x00,  ///< A good response was received
+    YM_ILLEGAL_FUNCTION         = 0x01,  ///< The function code isn't supported
+    YM_ILLEGAL_DATA_ADDRESS     = 0x02,  ///< The register doesn't exist on the sensor
+    YM_ILLEGAL_DATA_VALUE       = 0x03,  ///< The value or register count is not allowed
+    YM_SLAVE_DEVICE_FAILURE     = 0x04,  ///< The sensor failed handling the request
+    YM_ACKNOWLEDGE              = 0x05,  ///< The request was accepted, still running
+    YM_SLAVE_DEVICE_BUSY        = 0x06,  ///< The sensor is busy with a long command
+    YM_NEGATIVE_ACKNOWLEDGE     = 0x07,  ///< The sensor can't do the requested function
+    YM_MEMORY_PARITY_ERROR      = 0x08,  ///< The sensor found a memory parity error
+    YM_GATEWAY_PATH_UNAVAILABLE = 0x0A,  ///< A gateway couldn't route the request
+    YM_GATEWAY_TARGET_FAILED    = 0x0B,  ///< The device behind a gateway didn't respond
+    YM_NO_RESPONSE              = 0xE0,  ///< No valid response came before the timeout
+    YM_DEADLINE_EXPIRED         = 0xE1,  ///< Not sent because the deadline had passed
+} yosemitechError;
+
+/**
+ * @brief Counters of the transactions with a sensor, to see where bus time goes.
+ *
+ * All times are in milliseconds, measured from sending a command to the end of its
+ * response or timeout.  Every retry is counted as its own transaction.
+ */
+typedef struct yosemitechStats {
+    uint32_t transactions;   ///< The number of commands sent
+    uint32_t exceptions;     ///< The number answered with an exception
+    uint32_t timeouts;       ///< The number that got no valid response
+    uint32_t busTime;        ///< The total time spent on all commands
+    uint32_t exceptionTime;  ///< The time spent on commands answered with exceptions
+    uint32_t timeoutTime;    ///< The time spent on commands with no response
+    uint32_t cacheHits;      ///< Reads answered from the register cache
+    uint32_t cacheMisses;    ///< Cacheable reads that had to go to the sensor
+    uint32_t resyncs;        ///< Responses found among other bytes on the line
+    uint32_t staleBytes;     ///< Bytes left on the line dropped before a command
+} yosemitechStats;
+
+/**
+ * @brief The most values any sensor returns at once (the Y4000 sonde).
+ */
+#define YM_MAX_VALUES 8
+
+/**
+ * @brief One set of values from a sensor, with when and where it came from.
+ */
+typedef struct yosemitechReading {
+    uint32_t time;                   ///< The value of millis() when it was read
+    byte     slaveID;                ///< The modbus slave ID of the sensor
+    uint8_t  numValues;              ///< The number of values used; 3 or 8
+    byte     errorCode;              ///< The error code from the sensor
+    float    values[YM_MAX_VALUES];  ///< The values, in the order of getValues()
+} yosemitechReading;
+
 /**
  * @brief The class for communication with Yosemitech sensors via modbus.
  */
@@ -95,6 +211,23 @@ class yosemitech {
     bool begin(yosemitechModel model, byte modbusSlaveID, Stream& stream,
                int enablePin = -1);
 
+    /**
+     * @brief Sets a cache to remember the identity of a sensor of #UNKNOWN model.
+     *
+     * Starting a sensor with an #UNKNOWN model normally reads and parses its serial
+     * number every time to work out the model.  With a cache, the model, serial
+     * number and versions found the first time are saved by slave ID and later calls
+     * to begin() use them without asking the sensor.
+     *
+     * This must be called before begin().
+     *
+     * @param cache The cache to use, or nullptr to stop using a cache.
+     * @param verify True to confirm a cached identity by reading the (short) version
+     * registers and comparing them to the cached versions; if they don't match, the
+     * sensor is identified again.  Optional with a default value of false.
+     */
+    void setIdentityCache(yosemitechIdentityCache* cache, bool verify = false);
+
     /**
      * @anchor metadata_fxns
      * @name Functions to get and set sensor addresses and metadata
@@ -136,9 +269,11 @@ class yosemitech {
     /**
      * @brief Gets the modbus slave ID.
      *
-     * Not supported by many sensors.
+     * Not supported by many sensors.  The request is retried like any other, and
+     * no further than the deadline if one is set.
      *
-     * @return *byte* The slave ID of the Yosemitech sensor
+     * @return *byte* The slave ID of the Yosemitech sensor, or 0xFF if it didn't
+     * answer
      */
     byte getSlaveID(void);
 
@@ -371,6 +506,16 @@ class yosemitech {
     bool getValues(float& firstValue, float& secondValue, float& thirdValue,
                    float& forthValue, float& fifthValue, float& sixthValue,
                    float& seventhValue, float& eighthValue, byte& errorCode);
+    /**
+     * @brief Gets all of the values from any sensor, with the time and slave ID.
+     *
+     * This reads 8 values from a sonde and 3 from any other sensor, and unused
+     * values are set to -9999.
+     *
+     * @param reading The reading to fill in
+     * @return *bool* True if the measurements were successfully obtained, false if not.
+     */
+    bool getReading(yosemitechReading& reading);
     /**@}*/
 
     /**
@@ -607,38 +752,427 @@ class yosemitech {
     uint16_t getBrushInterval(void);
     /**@}*/
 
+    /**
+     * @anchor deadlines
+     * @name Functions to bound the time spent talking to a sensor
+     *
+     * A sensor that stops answering normally costs the full modbus timeout for every
+     * command sent to it, and some functions (like getSlaveID()) retry several times.
+     * Setting a deadline caps the total time: every following command shortens its
+     * timeout and number of retries to fit in the time remaining and no new command
+     * is sent once the deadline has passed.  Functions that run out of time return
+     * their usual failure value.
+     */
+    /**@{*/
+
+    /**
+     * @brief Sets an absolute deadline for all following communication with the
+     * sensor.
+     *
+     * The deadline stays in effect until it is replaced or cleared.
+     *
+     * @param deadline The value of millis() by which all communication must be
+     * finished.
+     */
+    void setDeadline(uint32_t deadline);
+
+    /**
+     * @brief Removes any deadline; commands go back to the full modbus timeout and
+     * number of retries.
+     */
+    void clearDeadline(void);
+
+    /**
+     * @brief Checks whether a deadline is set and has already passed.
+     *
+     * @return *bool* True if the deadline has passed, false if there is time left or
+     * no deadline is set.
+     */
+    bool deadlineExpired(void);
+
+    /**
+     * @brief Gets the time left before the deadline.
+     *
+     * @return *uint32_t* The number of milliseconds left before the deadline; 0 if
+     * the deadline has passed or UINT32_MAX if no deadline is set.
+     */
+    uint32_t getTimeRemaining(void);
+
+    /**
+     * @brief Turns the adaptive response timeout on or off.
+     *
+     * When on (the default), the library keeps a running estimate of how long this
+     * sensor takes to answer each kind of request - the same smoothed round trip time
+     * plus variance that TCP uses for its retransmission timeout - and waits only
+     * that long for a response instead of the full modbus timeout.  The timeout is
+     * never shorter than #YM_MIN_RESPONSE_TIMEOUT or longer than the modbus default
+     * and it doubles after every failed command, so a slow or sleepy sensor quickly
+     * gets the full timeout back.  Until the first response is timed, the full
+     * modbus timeout is used.
+     *
+     * @param enable True to wait only as long as the sensor usually takes to answer,
+     * false to always wait the full modbus timeout.
+     */
+    void setAdaptiveTimeout(bool enable);
+    /**@}*/
+
+    /**
+     * @anchor register_cache
+     * @name Functions for the register cache
+     *
+     * Some registers don't change during a deployment: the version, serial number,
+     * calibration coefficients and brush interval.  Reads of these are kept in a
+     * small cache, keyed by function, register and count, and getVersion(),
+     * getSerialNumber(), getCalibration() and getBrushInterval() answer from the
+     * cache until the entry expires (see #YM_CACHE_TTL_IDENTITY,
+     * #YM_CACHE_TTL_CALIBRATION and #YM_CACHE_TTL_SETTING).  Writes through
+     * setCalibration(), setBrushInterval() and the other set functions drop any
+     * cached registers they overlap, pHCalibrationPoint() drops the cached pH
+     * coefficients it changes, and setSlaveID() or begin() empty the cache.  Hits and
+     * misses are counted in getStats().
+     */
+    /**@{*/
+
+    /**
+     * @brief Turns the register cache on or off.  It is on by default.
+     *
+     * @param enable True to answer reads of static registers from the cache, false to
+     * always read them from the sensor.
+     */
+    void setRegisterCache(bool enable);
+
+    /**
+     * @brief Empties the register cache.
+     */
+    void clearRegisterCache(void);
+    /**@}*/
+
+    /**
+     * @anchor frame_timing
+     * @name Functions for Modbus RTU frame timing
+     *
+     * Modbus RTU only requires 3.5 character times of silence between frames (about
+     * 4 ms at 9600 baud), so instead of fixed delays between commands, the library
+     * waits exactly that long after the end of the last frame before sending the next
+     * one.  Above 19200 baud the gap is fixed at 1.75 ms, as the Modbus specification
+     * requires.
+     */
+    /**@{*/
+
+    /**
+     * @brief Sets the baud rate of the modbus stream, used to calculate the silent
+     * interval between frames.
+     *
+     * This also sets the time the modbusMaster will wait between characters before
+     * deciding a frame has ended.  If this is not called, the inter-frame gap for
+     * 9600 baud is used and the modbusMaster frame timeout is left alone.
+     *
+     * @param baudRate The baud rate of the stream given to begin()
+     */
+    void setBaudRate(uint32_t baudRate);
+
+    /**
+     * @brief Gets the silent interval enforced between frames.
+     *
+     * @return *uint32_t* The inter-frame gap, in microseconds
+     */
+    uint32_t getFrameGap(void);
+
+    /**
+     * @brief Sets the clock the sensor keeps time with.
+     *
+     * Every time the sensor object takes or gives, like a deadline, the time of a
+     * reading and its timeouts, is on this clock, and every wait goes through it.
+     * Give it a #yosemitechVirtualClock, along with a simulated sensor on the same
+     * clock, to run a simulation faster than real time.
+     *
+     * @param clock The clock; it must last as long as the sensor object
+     */
+    void setClock(yosemitechClock& clock);
+
+    /**
+     * @brief Gets the clock the sensor keeps time with; yosemitechClock::system
+     * unless setClock() was called.
+     *
+     * @return *yosemitechClock&* The clock
+     */
+    yosemitechClock& getClock(void);
+    /**@}*/
+
     /**
      * @anchor debugging
      * @name Debugging functions
      */
     /**@{*/
 
+    /**
+     * @brief Gets the result of the last command sent to the sensor.
+     *
+     * When a sensor refuses a request (for example, a register it doesn't have) it
+     * answers right away with a Modbus exception.  The library recognizes these,
+     * does not retry the command, and reports the exception code here.
+     *
+     * @return *yosemitechError* The result of the last command
+     */
+    yosemitechError getLastError(void);
+
+    /**
+     * @brief Gets the counts of and time spent on commands sent to this sensor since
+     * it was started or the counters were last reset.
+     *
+     * @return *yosemitechStats* A copy of the transaction counters
+     */
+    yosemitechStats getStats(void);
+
+    /**
+     * @brief Zeros the transaction counters.
+     */
+    void resetStats(void);
+
     /**
      * @brief Set a stream for debugging information to go to.
      *
      * @param stream An Arduino stream object
      */
     void setDebugStream(Stream* stream) {
+        _debugStream = stream;
         modbus.setDebugStream(stream);
     }
     /**
      * @copydoc yosemitech::setDebugStream(Stream* stream)
      */
     void setDebugStream(Stream& stream) {
+        _debugStream = &stream;
         modbus.setDebugStream(stream);
     }
     /**
      * @brief Un-set the stream for debugging information to go to; stop debugging.
      */
     void stopDebugging(void) {
+        _debugStream = nullptr;
         modbus.stopDebugging();
     }
     /**@}*/
 
 
  private:
-    int  _model;    ///< the sensor model
-    byte _slaveID;  ///< the sensor slave id
+    // The sweeper and gateway read and write raw blocks of registers through the
+    // private transactions
+    friend class yosemitechSweeper;
+    friend class yosemitechGateway;
+
+    int     _model;                  ///< the sensor model
+    byte    _slaveID;                ///< the sensor slave id
+    Stream* _stream      = nullptr;  ///< the stream the sensor is on
+    int     _enablePin   = -1;       ///< the RS485 driver enable pin, or -1
+    Stream* _debugStream = nullptr;  ///< where to print the frames sent and received
+    /// the clock the sensor keeps time with
+    yosemitechClock* _clock = &yosemitechClock::system;
+
+    /// a cache of identities of sensors of unknown model
+    yosemitechIdentityCache* _identityCache  = nullptr;
+    bool                     _verifyIdentity = false;  ///< true to check cached ids
+
+    /**
+     * @brief Works out the model of a sensor, from the identity cache if possible
+     * and otherwise from its serial number.
+     */
+    void identify(void);
+
+    bool     _hasDeadline = false;  ///< true if a deadline has been set
+    uint32_t _deadline    = 0;      ///< the millis() value of the deadline
+    /// The modbus command timeout to use when there is no deadline
+    uint32_t _commandTimeout = 0;
+    /// The number of times to retry a command that gets no response
+    uint8_t _commandRetries = 0;
+
+    yosemitechError _lastError = YM_SUCCESS;  ///< the result of the last command
+    yosemitechStats _stats     = {};          ///< the transaction counters
+
+    uint32_t _frameGap     = 4010;  ///< the silent interval between frames, in µs
+    uint32_t _lastFrameEnd = 0;     ///< micros() at the end of the last frame
+
+    /**
+     * @brief The kinds of transactions, each of which gets its own response timeout.
+     */
+    typedef enum transactionType {
+        metadataRead = 0,  ///< reads of the versions, serial number, calibration, etc
+        valuesRead,        ///< reads of measured values
+        registerWrite,     ///< writes to holding registers
+        rawCommand,        ///< start/stop measurement and brush commands
+        numTransactionTypes
+    } transactionType;
+
+    /**
+     * @brief A running estimate of the round trip time of one kind of transaction.
+     *
+     * The smoothed time and variance are scaled by 8 and 4 (as in RFC 6298) so they
+     * can be updated with integer shifts.
+     */
+    typedef struct rttEstimate {
+        uint16_t smoothed;  ///< smoothed round trip time, in 1/8 ms; 0 if not yet timed
+        uint16_t variance;  ///< round trip time mean deviation, in 1/4 ms
+        uint16_t timeout;   ///< the response timeout to use next, in ms
+    } rttEstimate;
+
+    bool        _adaptiveTimeout = true;  ///< true to use the learned timeouts
+    rttEstimate _rtt[numTransactionTypes] = {};  ///< estimates per transaction type
+
+    /**
+     * @brief How long a register read can be cached, by what the registers hold.
+     */
+    typedef enum cacheClass {
+        cacheNever = 0,    ///< values and anything else that can change
+        cacheIdentity,     ///< version and serial number
+        cacheCalibration,  ///< calibration coefficients
+        cacheSetting       ///< the brush interval, lost on power down
+    } cacheClass;
+
+    /**
+     * @brief One cached register read.
+     */
+    typedef struct registerCacheEntry {
+        uint32_t fetched;       ///< the millis() value when the registers were read
+        uint16_t regNum;        ///< the first register read
+        uint8_t  function;      ///< the modbus function; 0 if the entry is empty
+        uint8_t  numRegisters;  ///< the number of registers read
+        uint8_t  lifetime;      ///< the #cacheClass of the registers
+        byte     data[YM_REGISTER_CACHE_BYTES];  ///< the register data
+    } registerCacheEntry;
+
+    bool _registerCacheOn = true;  ///< true to use the register cache
+    /// the register cache
+    registerCacheEntry _registerCache[YM_REGISTER_CACHE_SIZE] = {};
+
+    /**
+     * @brief Gets how long a class of registers can be cached.
+     *
+     * @param lifetime The #cacheClass of the registers
+     * @return *uint32_t* The time to live, in milliseconds
+     */
+    static uint32_t cacheTTL(uint8_t lifetime);
+    /**
+     * @brief Looks for a register read in the cache and, if it's there and hasn't
+     * expired, puts it in the modbus response buffer as if it came from the sensor.
+     *
+     * @param regNum The first register to read
+     * @param numRegisters The number of registers to read
+     * @return *bool* True if the read was found in the cache, false if not.
+     */
+    bool readFromCache(int regNum, int16_t numRegisters);
+    /**
+     * @brief Saves the register read now in the modbus response buffer to the cache.
+     *
+     * @param regNum The first register read
+     * @param numRegisters The number of registers read
+     * @param lifetime How long the read can be kept
+     */
+    void saveToCache(int regNum, int16_t numRegisters, cacheClass lifetime);
+    /**
+     * @brief Drops any cached reads overlapping a range of registers.
+     *
+     * @param regNum The first register written
+     * @param numRegisters The number of registers written
+     */
+    void invalidateCache(int regNum, uint16_t numRegisters);
+
+    /**
+     * @brief Fits the modbus timeout into the time left before the deadline, waits
+     * for the gap between frames and drops anything left on the line.
+     *
+     * This must be called before every command sent to the sensor.  The gap and the
+     * time the request takes on the line come out of the time left too, so the whole
+     * command ends by the deadline.
+     *
+     * @param type The kind of transaction about to be sent
+     * @param requestLength The number of bytes in the request, with its CRC.
+     * Optional with a default value of 8, the length of a read.
+     * @return *bool* True if there is time left for the command, false if the
+     * deadline has passed or too little is left to send it.
+     */
+    bool startTransaction(transactionType type, uint16_t requestLength = 8);
+    /**
+     * @brief Waits out whatever is left of the silent interval since the end of the
+     * last frame.
+     */
+    void waitForFrameGap(void);
+    /**
+     * @brief Drops anything left on the line, like a late reply to an earlier
+     * command, reading until the line has been quiet for a whole frame gap so the
+     * next command starts at a frame boundary.
+     *
+     * @param timeout The longest to spend on it, in milliseconds, in case the line
+     * never goes quiet
+     */
+    void flushInput(uint32_t timeout);
+    /**
+     * @brief Sends a command and reads the response into the modbus response buffer
+     * as it arrives, finishing as soon as the last byte of the response is in.
+     *
+     * The response is found with a #yosemitechFrameParser, so anything received
+     * before it, like stray bytes or a late reply from another slave, is skipped.  It
+     * is waited for until the modbus command timeout, or until the line goes quiet
+     * after a garbled or cut off response.
+     *
+     * @param command The start of the command frame, without the CRC
+     * @param commandLength The length of the start of the command frame
+     * @param data The rest of the command frame, or nullptr
+     * @param dataLength The length of the rest of the command frame
+     * @param length The length of a normal response, including the CRC
+     * @return *int16_t* The length of the response, or 0 if there was none or it was
+     * an exception.  An exception response is left in the response buffer.
+     */
+    int16_t exchange(const byte command[], uint8_t commandLength, const byte data[],
+                     uint16_t dataLength, int16_t length);
+    /**
+     * @brief Prints bytes in hexadecimal to the debugging stream.
+     *
+     * @param bytes The bytes
+     * @param length The number of bytes
+     */
+    void debugBytes(const byte bytes[], uint16_t length);
+    /**
+     * @brief Records the result of a transaction and updates its round trip time
+     * estimate.
+     *
+     * @param type The kind of transaction that was sent
+     * @param start The millis() value when the command was sent
+     * @param success True if a good response was received
+     * @return *bool* True if the command got no response and is worth retrying, false
+     * if it succeeded or the sensor answered with an exception.
+     */
+    bool endTransaction(transactionType type, uint32_t start, bool success);
+    /**
+     * @brief Reads holding registers from the sensor into the modbus response buffer.
+     *
+     * @param regNum The first register to read
+     * @param numRegisters The number of registers to read
+     * @param type The kind of transaction, for the adaptive timeout
+     * @param lifetime How long the registers can be cached; by default they aren't
+     * @return *bool* True if the registers were read, false if not.
+     */
+    bool readRegisters(int regNum, int16_t numRegisters,
+                       transactionType type     = metadataRead,
+                       cacheClass      lifetime = cacheNever);
+    /**
+     * @brief Writes holding registers on the sensor using function 0x10.
+     *
+     * @param regNum The first register to write
+     * @param numRegisters The number of registers to write
+     * @param value The bytes to write to the registers
+     * @return *bool* True if the registers were written, false if not.
+     */
+    bool writeRegisters(int regNum, uint16_t numRegisters, byte value[]);
+    /**
+     * @brief Sends a raw command (the CRC will be added) to the sensor.
+     *
+     * @param command The command frame to send
+     * @param commandLength The length of the command, including two bytes for the CRC
+     * @param type The kind of transaction, for the adaptive timeout
+     * @return *int16_t* The size of the response, 0 if there was none.
+     */
+    int16_t sendCommand(byte command[], int commandLength,
+                        transactionType type = rawCommand);
 
     modbusMaster modbus;  ///< an internal reference to the modbus communication object.
 };
@@ -0,0 +1,177 @@
+/**
+ * @file YosemitechPowerManager.cpp
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the power manager definitions.
+ */
+
+#include "YosemitechPowerManager.h"
+
+
+yosemitechPowerManager::yosemitechPowerManager()
+    : _railCount(0),
+      _adapterRail(-1),
+      _sensorCount(0) {}
+
+
+int8_t yosemitechPowerManager::addRail(int8_t pin, uint8_t onLevel) {
+    if (_railCount >= YM_MAX_RAILS) return -1;
+    powerRail& r = _rails[_railCount];
+    r.pin        = pin;
+    r.onLevel    = onLevel;
+    r.on         = false;
+    r.onAt       = 0;
+    r.onTime     = 0;
+    r.lastOn     = 0;
+    r.powerUps   = 0;
+    if (pin >= 0) {
+        pinMode(pin, OUTPUT);
+        switchRail(_railCount, false);
+    }
+    return _railCount++;
+}
+
+
+void yosemitechPowerManager::setAdapterRail(int8_t rail) {
+    _adapterRail = rail < _railCount ? rail : -1;
+}
+
+
+int16_t yosemitechPowerManager::addSensor(yosemitech& sensor, uint8_t rail,
+                                          uint32_t warmUp, uint32_t stabilization) {
+    if (_sensorCount >= YM_MAX_POWERED || rail >= _railCount) return -1;
+    poweredSensor& s = _sensors[_sensorCount];
+    s.sensor         = &sensor;
+    s.rail           = rail;
+    s.state          = finished;
+    s.warmUp         = warmUp;
+    s.stabilization  = stabilization;
+    s.startedAt      = 0;
+    return _sensorCount++;
+}
+
+
+// This powers every rail with a sensor on it, then goes round the sensors: starting
+// each one that has warmed up, and reading and stopping each one that has stabilized.
+// When nothing is ready it waits for whatever is due next.  A rail goes off as soon
+// as its last sensor is stopped, and the adapter's with the last of them.
+uint16_t yosemitechPowerManager::takeReadings(yosemitechReading* readings) {
+    if (_sensorCount == 0) return 0;
+    yosemitechClock& clock = _sensors[0].sensor->getClock();
+
+    for (uint8_t r = 0; r < _railCount; r++) { _rails[r].lastOn = 0; }
+    if (_adapterRail >= 0) setRail(_adapterRail, true);
+    for (uint16_t i = 0; i < _sensorCount; i++) {
+        setRail(_sensors[i].rail, true);
+        _sensors[i].state = warming;
+    }
+
+    uint16_t good      = 0;
+    uint16_t remaining = _sensorCount;
+    while (remaining > 0) {
+        for (uint16_t i = 0; i < _sensorCount; i++) {
+            poweredSensor& s = _sensors[i];
+            if (s.state == warming &&
+                clock.millis() - _rails[s.rail].onAt >= s.warmUp) {
+                s.sensor->startMeasurement();
+                s.startedAt = clock.millis();
+                s.state     = measuring;
+            }
+            if (s.state == measuring &&
+                clock.millis() - s.startedAt >= s.stabilization) {
+                if (s.sensor->getReading(readings[i])) good++;
+                s.sensor->stopMeasurement();
+                s.state = finished;
+                remaining--;
+
+                // Release the rail if this was the last sensor on it
+                bool last = true;
+                for (uint16_t j = 0; j < _sensorCount && last; j++) {
+                    last = _sensors[j].rail != s.rail || _sensors[j].state == finished;
+                }
+                if (last && s.rail != _adapterRail) setRail(s.rail, false);
+            }
+        }
+
+        // Wait for whichever sensor is due next
+        uint32_t now  = clock.millis();
+        uint32_t wait = 0xFFFFFFFF;
+        for (uint16_t i = 0; i < _sensorCount && wait > 0; i++) {
+            const poweredSensor& s = _sensors[i];
+            if (s.state == finished) continue;
+            bool     warm  = s.state == warming;
+            uint32_t since = now - (warm ? _rails[s.rail].onAt : s.startedAt);
+            uint32_t need  = warm ? s.warmUp : s.stabilization;
+            uint32_t left  = since >= need ? 0 : need - since;
+            if (left < wait) wait = left;
+        }
+        if (remaining > 0 && wait > 0) clock.delay(wait);
+    }
+    if (_adapterRail >= 0) setRail(_adapterRail, false);
+    return good;
+}
+
+
+uint32_t yosemitechPowerManager::getOnTime(uint8_t rail) {
+    return rail < _railCount ? _rails[rail].onTime : 0;
+}
+
+
+uint32_t yosemitechPowerManager::getLastOnTime(uint8_t rail) {
+    return rail < _railCount ? _rails[rail].lastOn : 0;
+}
+
+
+uint32_t yosemitechPowerManager::getPowerUps(uint8_t rail) {
+    return rail < _railCount ? _rails[rail].powerUps : 0;
+}
+
+
+void yosemitechPowerManager::resetStats(void) {
+    for (uint8_t r = 0; r < _railCount; r++) {
+        _rails[r].onTime   = 0;
+        _rails[r].lastOn   = 0;
+        _rails[r].powerUps = 0;
+    }
+}
+
+
+uint8_t yosemitechPowerManager::getRailCount(void) {
+    return _railCount;
+}
+
+
+uint16_t yosemitechPowerManager::getSensorCount(void) {
+    return _sensorCount;
+}
+
+
+void yosemitechPowerManager::switchRail(uint8_t rail, bool on) {
+    const powerRail& r = _rails[rail];
+    if (r.pin < 0) return;
+    digitalWrite(r.pin, on ? r.onLevel : !r.onLevel);
+}
+
+
+// This also empties the register cache of the sensors on a rail going off, since
+// they forget their settings without power
+void yosemitechPowerManager::setRail(uint8_t rail, bool on) {
+    powerRail& r = _rails[rail];
+    if (r.on == on) return;
+    uint32_t now = _sensors[0].sensor->getClock().millis();
+    switchRail(rail, on);
+    r.on = on;
+    if (on) {
+        r.onAt = now;
+        r.powerUps++;
+    } else {
+        r.onTime += now - r.onAt;
+        r.lastOn += now - r.onAt;
+        for (uint16_t i = 0; i < _sensorCount; i++) {
+            if (_sensors[i].rail == rail) _sensors[i].sensor->clearRegisterCache();
+        }
+    }
+}
@@ -0,0 +1,216 @@
+/**
+ * @file YosemitechPowerManager.h
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the power manager declarations, used to power sensors only for as
+ * long as it takes to get a reading from them.
+ */
+
+#ifndef YosemitechPowerManager_h
+#define YosemitechPowerManager_h
+
+#include "YosemitechModbus.h"
+
+/**
+ * @brief The most power rails one power manager switches.
+ */
+#ifndef YM_MAX_RAILS
+#define YM_MAX_RAILS 4
+#endif
+
+/**
+ * @brief The most sensors one power manager powers; a whole bus on a host build.
+ */
+#ifndef YM_MAX_POWERED
+#ifdef YM_HOST_BUILD
+#define YM_MAX_POWERED 247
+#else
+#define YM_MAX_POWERED 16
+#endif
+#endif
+
+/**
+ * @brief Powers sensors for a reading and switches their power off again as soon as
+ * they are done.
+ *
+ * Each sensor is on a power rail, a pin switching the power to one or more sensors,
+ * and has a profile: how long after power up it takes to answer (its warm up) and how
+ * long after starting to measure its values are stable.  takeReadings() switches every
+ * rail on together, starts each sensor measuring as soon as it has warmed up, reads
+ * it and stops it as soon as it is stable, and switches each rail off as soon as the
+ * last sensor on it has stopped.  So a rail of quick sensors isn't kept on while a
+ * slow one stabilizes on another rail.
+ *
+ * A rail can also be set as the adapter's, like the power to the RS485 adapter: it is
+ * on whenever any other rail is.  The manager adds up how long each rail is on, for
+ * working out the energy the sensors use.
+ *
+ * The waits go through the clock of the first sensor, so with a
+ * #yosemitechSleepClock the board sleeps through them.  The enable pin given to
+ * yosemitech::begin() is still switched by each sensor object for each command.
+ *
+ * @code{.cpp}
+ * yosemitechPowerManager power;
+ * uint8_t adapter = power.addRail(22);
+ * uint8_t probes  = power.addRail(10);
+ * power.setAdapterRail(adapter);
+ * power.addSensor(turbidity, probes, 500, 22000);  // Y511: brush cycle, then stable
+ * power.addSensor(oxygen, probes, 300, 8000);      // Y504
+ *
+ * yosemitechReading readings[2];
+ * power.takeReadings(readings);
+ * @endcode
+ */
+class yosemitechPowerManager {
+
+ public:
+    yosemitechPowerManager();
+    virtual ~yosemitechPowerManager() {}
+
+    /**
+     * @brief Adds a power rail and switches it off.
+     *
+     * @param pin The pin switching the rail, or -1 for a rail that is always on
+     * @param onLevel The level of the pin that switches the rail on.  Optional with a
+     * default value of HIGH.
+     * @return *int8_t* The number of the rail, or -1 if there are already
+     * #YM_MAX_RAILS.
+     */
+    int8_t addRail(int8_t pin, uint8_t onLevel = HIGH);
+
+    /**
+     * @brief Sets the rail that is on whenever any other rail is on.
+     *
+     * @param rail The number of the rail, or -1 for none
+     */
+    void setAdapterRail(int8_t rail);
+
+    /**
+     * @brief Adds a sensor.
+     *
+     * @param sensor The sensor; it must already be started with begin()
+     * @param rail The number of the rail that powers it
+     * @param warmUp The time from power up until it answers, in milliseconds
+     * @param stabilization The time from starting to measure until its values are
+     * stable, in milliseconds
+     * @return *int16_t* The position of the sensor's readings in takeReadings(), or
+     * -1 if the rail doesn't exist or there are already #YM_MAX_POWERED sensors.
+     */
+    int16_t addSensor(yosemitech& sensor, uint8_t rail, uint32_t warmUp,
+                      uint32_t stabilization);
+
+    /**
+     * @brief Powers every sensor up, takes a reading from each and powers them down
+     * again.
+     *
+     * @param readings The readings to fill in, one for each sensor in the order they
+     * were added
+     * @return *uint16_t* The number of sensors read successfully
+     */
+    uint16_t takeReadings(yosemitechReading* readings);
+
+    /**
+     * @brief Gets the total time a rail has been on.
+     *
+     * @param rail The number of the rail
+     * @return *uint32_t* The time in milliseconds
+     */
+    uint32_t getOnTime(uint8_t rail);
+    /**
+     * @brief Gets the time a rail was on in the last call to takeReadings().
+     *
+     * @param rail The number of the rail
+     * @return *uint32_t* The time in milliseconds
+     */
+    uint32_t getLastOnTime(uint8_t rail);
+    /**
+     * @brief Gets the number of times a rail has been switched on.
+     *
+     * @param rail The number of the rail
+     * @return *uint32_t* The number of power ups
+     */
+    uint32_t getPowerUps(uint8_t rail);
+    /**
+     * @brief Sets the on times and power ups of every rail back to 0.
+     */
+    void resetStats(void);
+
+    /**
+     * @brief Gets the number of rails.
+     *
+     * @return *uint8_t* The number of rails added
+     */
+    uint8_t getRailCount(void);
+    /**
+     * @brief Gets the number of sensors.
+     *
+     * @return *uint16_t* The number of sensors added
+     */
+    uint16_t getSensorCount(void);
+
+ protected:
+    /**
+     * @brief Switches the power of a rail.
+     *
+     * This writes the rail's pin; a subclass can switch power some other way, like a
+     * simulation switching its simulated sensors.
+     *
+     * @param rail The number of the rail
+     * @param on True to switch it on, false to switch it off
+     */
+    virtual void switchRail(uint8_t rail, bool on);
+
+ private:
+    /**
+     * @brief Switches a rail on or off, keeping count of its time on.
+     *
+     * @param rail The number of the rail
+     * @param on True to switch it on, false to switch it off
+     */
+    void setRail(uint8_t rail, bool on);
+
+    /**
+     * @brief What a sensor is doing in takeReadings().
+     */
+    typedef enum poweredState {
+        warming = 0,  ///< powered, waiting to warm up
+        measuring,    ///< measuring, waiting to stabilize
+        finished      ///< read and stopped
+    } poweredState;
+
+    /**
+     * @brief A rail and how long it has been on.
+     */
+    typedef struct powerRail {
+        int8_t   pin;       ///< the pin switching it, or -1
+        uint8_t  onLevel;   ///< the level of the pin that switches it on
+        bool     on;        ///< whether it is on
+        uint32_t onAt;      ///< the millis() value when it was last switched on
+        uint32_t onTime;    ///< the total time on, in milliseconds
+        uint32_t lastOn;    ///< the time on in the last takeReadings()
+        uint32_t powerUps;  ///< the number of times it was switched on
+    } powerRail;
+
+    /**
+     * @brief A sensor and its profile.
+     */
+    typedef struct poweredSensor {
+        yosemitech*  sensor;         ///< the sensor
+        uint8_t      rail;           ///< the rail powering it
+        poweredState state;          ///< what it is doing in takeReadings()
+        uint32_t     warmUp;         ///< the time to answer after power up
+        uint32_t     stabilization;  ///< the time to stabilize after starting
+        uint32_t     startedAt;      ///< the millis() value when it started measuring
+    } poweredSensor;
+
+    powerRail     _rails[YM_MAX_RAILS];      ///< The rails
+    uint8_t       _railCount;                ///< The number of rails added
+    int8_t        _adapterRail;              ///< The rail on while any other is, or -1
+    poweredSensor _sensors[YM_MAX_POWERED];  ///< The sensors
+    uint16_t      _sensorCount;              ///< The number of sensors added
+};
+
+#endif
@@ -0,0 +1,142 @@
+/**
+ * @file YosemitechReadingQueue.h
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the reading queue, used to pass readings from the code polling the
+ * sensors to the code storing or sending them without locks.
+ */
+
+#ifndef YosemitechReadingQueue_h
+#define YosemitechReadingQueue_h
+
+#include "YosemitechModbus.h"
+
+/**
+ * @brief The alignment that keeps the two ends of a queue out of each other's cache
+ * line on a host build; boards have no data cache to share.
+ */
+#ifndef YM_CACHE_LINE
+#ifdef YM_HOST_BUILD
+#define YM_CACHE_LINE 64
+#else
+#define YM_CACHE_LINE 1
+#endif
+#endif
+
+/**
+ * @brief The type of the queue positions.
+ *
+ * The positions are loaded and stored atomically, so on 8-bit AVR boards, which can
+ * only do that for single bytes, they are one byte and a queue holds at most 128
+ * readings.
+ */
+#ifdef __AVR__
+typedef uint8_t yosemitechQueueIndex;
+#else
+typedef uint16_t yosemitechQueueIndex;
+#endif
+
+/**
+ * @brief A fixed size, lock-free queue of readings for exactly one producer and one
+ * consumer.
+ *
+ * The producer (the code calling yosemitech::getReading()) and the consumer (the code
+ * logging or sending the readings) can be different threads, different cores, or an
+ * interrupt and the main loop.  Neither ever waits for the other: push() fails at
+ * once when the queue is full and pop() fails at once when it is empty.  Nothing is
+ * allocated after construction.
+ *
+ * Only the producer may call push() and getDropped() and only the consumer may call
+ * pop(); size() is safe from either side.
+ *
+ * @code{.cpp}
+ * yosemitechReadingQueue<16> readings;
+ *
+ * // producer
+ * yosemitechReading reading;
+ * if (sensor.getReading(reading)) readings.push(reading);
+ *
+ * // consumer
+ * while (readings.pop(reading)) { logReading(reading); }
+ * @endcode
+ *
+ * @tparam Capacity The number of readings the queue holds; a power of 2 no larger
+ * than 32768 (128 on AVR boards).
+ */
+template <uint16_t Capacity>
+class yosemitechReadingQueue {
+
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "The capacity of a reading queue must be a power of 2");
+    static_assert(Capacity <= ((yosemitechQueueIndex)-1 >> 1) + 1,
+                  "The capacity of a reading queue is too large for this board");
+
+ public:
+    yosemitechReadingQueue() : _head(0), _dropped(0), _tail(0) {}
+
+    /**
+     * @brief Adds a reading to the queue; producer only.
+     *
+     * @param reading The reading to add
+     * @return *bool* True if the reading was added, false if the queue was full.
+     */
+    bool push(const yosemitechReading& reading) {
+        yosemitechQueueIndex head = _head;  // only the producer changes the head
+        yosemitechQueueIndex tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+        if ((yosemitechQueueIndex)(head - tail) == Capacity) {
+            _dropped++;
+            return false;
+        }
+        _readings[head & (Capacity - 1)] = reading;
+        // Publish the head only after the reading is in place
+        __atomic_store_n(&_head, (yosemitechQueueIndex)(head + 1), __ATOMIC_RELEASE);
+        return true;
+    }
+
+    /**
+     * @brief Takes the oldest reading off the queue; consumer only.
+     *
+     * @param reading The reading to fill in
+     * @return *bool* True if there was a reading, false if the queue was empty.
+     */
+    bool pop(yosemitechReading& reading) {
+        yosemitechQueueIndex tail = _tail;  // only the consumer changes the tail
+        if (__atomic_load_n(&_head, __ATOMIC_ACQUIRE) == tail) return false;
+        reading = _readings[tail & (Capacity - 1)];
+        // Free the slot only after the reading has been copied out
+        __atomic_store_n(&_tail, (yosemitechQueueIndex)(tail + 1), __ATOMIC_RELEASE);
+        return true;
+    }
+
+    /**
+     * @brief Gets the number of readings waiting in the queue.
+     *
+     * @return *uint16_t* The number of readings
+     */
+    uint16_t size(void) {
+        return (yosemitechQueueIndex)(__atomic_load_n(&_head, __ATOMIC_ACQUIRE) -
+                                      __atomic_load_n(&_tail, __ATOMIC_ACQUIRE));
+    }
+
+    /**
+     * @brief Gets the number of readings push() had to drop because the queue was
+     * full; producer only.
+     *
+     * @return *uint32_t* The number of dropped readings
+     */
+    uint32_t getDropped(void) {
+        return _dropped;
+    }
+
+ private:
+    // The producer's and consumer's positions are kept apart, and from the readings
+    alignas(YM_CACHE_LINE) yosemitechQueueIndex _head;  ///< The next slot to fill
+    uint32_t _dropped;                                  ///< Readings push() dropped
+    alignas(YM_CACHE_LINE) yosemitechQueueIndex _tail;  ///< The next slot to empty
+    alignas(YM_CACHE_LINE) yosemitechReading _readings[Capacity];  ///< The readings
+};
+
+#endif
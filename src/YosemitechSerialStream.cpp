@@ -0,0 +1,142 @@
+/**
+ * @file YosemitechSerialStream.cpp
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the definitions of a Stream on a serial port device.
+ */
+
+#include "YosemitechSerialStream.h"
+
+#ifdef YM_HOST_BUILD
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+
+// This converts a baud rate to its termios speed, or 0 if it isn't a standard one
+static speed_t termiosSpeed(uint32_t baudRate) {
+    switch (baudRate) {
+        case 1200: return B1200;
+        case 2400: return B2400;
+        case 4800: return B4800;
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        default: return 0;
+    }
+}
+
+
+yosemitechSerialStream::yosemitechSerialStream(const char* device)
+    : _device(device),
+      _fd(-1),
+      _peeked(-1) {}
+
+yosemitechSerialStream::~yosemitechSerialStream() {
+    end();
+}
+
+
+// This opens the port in raw, non-blocking 8N1 mode
+bool yosemitechSerialStream::begin(uint32_t baudRate) {
+    end();
+    speed_t speed = termiosSpeed(baudRate);
+    if (speed == 0) return false;
+
+    _fd = open(_device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (_fd < 0) return false;
+
+    struct termios settings;
+    if (tcgetattr(_fd, &settings) != 0) {
+        end();
+        return false;
+    }
+    cfmakeraw(&settings);
+    settings.c_cflag |= CLOCAL | CREAD;
+    settings.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+    settings.c_iflag &= ~(IXON | IXOFF | IXANY);
+    settings.c_cc[VMIN]  = 0;
+    settings.c_cc[VTIME] = 0;
+    cfsetispeed(&settings, speed);
+    cfsetospeed(&settings, speed);
+    if (tcsetattr(_fd, TCSANOW, &settings) != 0) {
+        end();
+        return false;
+    }
+    // Drop anything left over from before the port was opened
+    tcflush(_fd, TCIOFLUSH);
+    return true;
+}
+
+
+void yosemitechSerialStream::end(void) {
+    if (_fd >= 0) close(_fd);
+    _fd     = -1;
+    _peeked = -1;
+}
+
+
+int yosemitechSerialStream::available(void) {
+    if (_fd < 0) return 0;
+    int waiting = 0;
+    if (ioctl(_fd, FIONREAD, &waiting) != 0) waiting = 0;
+    return waiting + (_peeked >= 0 ? 1 : 0);
+}
+
+
+int yosemitechSerialStream::read(void) {
+    if (_peeked >= 0) {
+        int value = _peeked;
+        _peeked   = -1;
+        return value;
+    }
+    if (_fd < 0) return -1;
+    uint8_t value;
+    return ::read(_fd, &value, 1) == 1 ? value : -1;
+}
+
+
+int yosemitechSerialStream::peek(void) {
+    if (_peeked < 0) _peeked = read();
+    return _peeked;
+}
+
+
+size_t yosemitechSerialStream::write(uint8_t value) {
+    return write(&value, 1);
+}
+
+
+// This writes a whole buffer, waiting out a full output queue if it has to
+size_t yosemitechSerialStream::write(const uint8_t* buffer, size_t size) {
+    if (_fd < 0) return 0;
+    size_t written = 0;
+    while (written < size) {
+        ssize_t sent = ::write(_fd, buffer + written, size - written);
+        if (sent > 0) {
+            written += sent;
+        } else if (sent < 0 && errno != EAGAIN && errno != EINTR) {
+            break;
+        }
+    }
+    return written;
+}
+
+
+void yosemitechSerialStream::flush(void) {
+    if (_fd >= 0) tcdrain(_fd);
+}
+
+#endif
+
+// cspell: ignore termios NOCTTY CLOCAL CREAD CSTOPB PARENB CRTSCTS IXON IXOFF IXANY
+// cspell: ignore VMIN VTIME TCSANOW TCIOFLUSH FIONREAD tcdrain tcflush cfmakeraw
+// cspell: ignore tcgetattr tcsetattr cfsetispeed cfsetospeed
@@ -0,0 +1,80 @@
+/**
+ * @file YosemitechSerialStream.h
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the declarations of a Stream on a serial port device, for talking
+ * to sensors from a host build through a USB-RS485 adapter.
+ */
+
+#ifndef YosemitechSerialStream_h
+#define YosemitechSerialStream_h
+
+#include "YosemitechModbus.h"
+
+#ifdef YM_HOST_BUILD
+
+/**
+ * @brief A Stream on a POSIX serial port device, like `/dev/ttyUSB0`.
+ *
+ * The port is put in raw 8N1 mode with no flow control and is never blocked on, so
+ * it behaves like a hardware serial port to the modbusMaster.  Most USB-RS485
+ * adapters switch between sending and receiving on their own, so use a DE/RE pin of
+ * -1 with the sensor.
+ *
+ * @code{.cpp}
+ * yosemitechSerialStream port("/dev/ttyUSB0");
+ * yosemitech             sensor;
+ * port.begin(9600);
+ * sensor.begin(UNKNOWN, 0x01, port);
+ * sensor.setBaudRate(9600);
+ * @endcode
+ */
+class yosemitechSerialStream : public Stream {
+
+ public:
+    /**
+     * @brief Constructs a new serial stream; the port isn't opened until begin().
+     *
+     * @param device The path of the serial port device
+     */
+    explicit yosemitechSerialStream(const char* device);
+    ~yosemitechSerialStream();
+    yosemitechSerialStream(const yosemitechSerialStream&)            = delete;
+    yosemitechSerialStream& operator=(const yosemitechSerialStream&) = delete;
+
+    /**
+     * @brief Opens and configures the port.
+     *
+     * @param baudRate The baud rate; one of the standard rates from 1200 to 115200.
+     * @return *bool* True if the port was opened, false if not.
+     */
+    bool begin(uint32_t baudRate);
+    /**
+     * @brief Closes the port.
+     */
+    void end(void);
+
+    int    available(void) override;
+    int    read(void) override;
+    int    peek(void) override;
+    size_t write(uint8_t value) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    /**
+     * @brief Waits until everything written has left the port.
+     */
+    void flush(void) override;
+
+    using Print::write;
+
+ private:
+    const char* _device;  ///< The path of the serial port device
+    int         _fd;      ///< The open port, or -1
+    int         _peeked;  ///< A byte taken by peek() but not yet read, or -1
+};
+
+#endif
+
+#endif
@@ -0,0 +1,346 @@
+/**
+ * @file YosemitechSeriesCodec.cpp
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the time series encoder and decoder definitions.
+ *
+ * The series is a 6 byte header followed by a stream of bits, most significant bit
+ * first:
+ *   header     "YTS", version (1), slave ID, number of values
+ *   reading 1  time (32 bits), error code (8 bits), each value (32 bits)
+ *   reading n  time code, error code, each value code
+ *   end        the end time code, then 0 bits to finish the last byte
+ *
+ * Time codes, for the change in interval (delta-of-delta) since the last reading:
+ *   0                        no change
+ *   10    + 7 bits           -63 to 64, stored as change + 63
+ *   110   + 9 bits           -255 to 256, stored as change + 255
+ *   1110  + 12 bits          -2047 to 2048, stored as change + 2047
+ *   11110 + 32 bits          any other change
+ *   11111                    the end of the series
+ *
+ * Error codes:
+ *   0                        the same as the last reading
+ *   1     + 8 bits           the new error code
+ *
+ * Value codes, for the XOR of the value with the last value of its channel:
+ *   0                        the same as the last value
+ *   10    + bits             the XOR fits the window of leading and trailing zeros
+ *                            last used for the channel; only the bits inside it
+ *   11    + 5 + 6 + bits     a new window: leading zeros, number of bits, the bits
+ */
+
+#include "YosemitechSeriesCodec.h"
+
+// The version of the series format
+#define YM_SERIES_VERSION 0x01
+
+// A window that hasn't been set yet
+#define YM_NO_WINDOW 0xFF
+
+
+// These count the zeros at either end of a non-zero 32-bit number
+static uint8_t leadingZeros(uint32_t value) {
+    return sizeof(unsigned int) >= 4 ? __builtin_clz(value) : __builtin_clzl(value);
+}
+static uint8_t trailingZeros(uint32_t value) {
+    return sizeof(unsigned int) >= 4 ? __builtin_ctz(value) : __builtin_ctzl(value);
+}
+
+// These get and set the bits of a float, without breaking aliasing rules
+static uint32_t floatBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    return bits;
+}
+static float bitsFloat(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, 4);
+    return value;
+}
+
+
+//----------------------------------------------------------------------------
+//                                  ENCODER
+//----------------------------------------------------------------------------
+
+yosemitechSeriesEncoder::yosemitechSeriesEncoder(Print& out)
+    : _out(out),
+      _numValues(0),
+      _readings(0),
+      _byte(0),
+      _bitCount(0),
+      _bytes(0) {}
+
+
+void yosemitechSeriesEncoder::begin(byte slaveID, uint8_t numValues) {
+    _numValues = numValues < YM_MAX_VALUES ? numValues : YM_MAX_VALUES;
+    _readings  = 0;
+    _lastDelta = 0;
+    _byte      = 0;
+    _bitCount  = 0;
+    for (uint8_t i = 0; i < YM_MAX_VALUES; i++) { _leading[i] = YM_NO_WINDOW; }
+    _bytes = _out.write((const uint8_t*)"YTS", 3);
+    _bytes += _out.write((uint8_t)YM_SERIES_VERSION);
+    _bytes += _out.write(slaveID);
+    _bytes += _out.write(_numValues);
+}
+
+
+// This adds the lowest bits of a number to the stream, filling a byte at a time
+void yosemitechSeriesEncoder::writeBits(uint32_t value, uint8_t count) {
+    while (count > 0) {
+        uint8_t room  = 8 - _bitCount;
+        uint8_t taken = count < room ? count : room;
+        count -= taken;
+        _byte = (_byte << taken) | ((value >> count) & ((1 << taken) - 1));
+        _bitCount += taken;
+        if (_bitCount == 8) {
+            _bytes += _out.write(_byte);
+            _byte     = 0;
+            _bitCount = 0;
+        }
+    }
+}
+
+
+// This writes the XOR of a value with the last one in the smallest window that fits
+void yosemitechSeriesEncoder::writeValue(uint8_t channel, float value) {
+    uint32_t bits = floatBits(value);
+    uint32_t xord = bits ^ _lastBits[channel];
+    _lastBits[channel] = bits;
+    if (xord == 0) {
+        writeBits(0, 1);
+        return;
+    }
+    uint8_t leading  = leadingZeros(xord);
+    uint8_t trailing = trailingZeros(xord);
+    if (_leading[channel] != YM_NO_WINDOW && leading >= _leading[channel] &&
+        trailing >= _trailing[channel]) {
+        writeBits(0x2, 2);
+        writeBits(xord >> _trailing[channel],
+                  32 - _leading[channel] - _trailing[channel]);
+        return;
+    }
+    uint8_t length     = 32 - leading - trailing;
+    _leading[channel]  = leading;
+    _trailing[channel] = trailing;
+    writeBits(0x3, 2);
+    writeBits(leading, 5);
+    writeBits(length - 1, 6);
+    writeBits(xord >> trailing, length);
+}
+
+
+void yosemitechSeriesEncoder::encode(const yosemitechReading& reading) {
+    if (_readings == 0) {
+        writeBits(reading.time, 32);
+        writeBits(reading.errorCode, 8);
+        for (uint8_t i = 0; i < _numValues; i++) {
+            _lastBits[i] = floatBits(reading.values[i]);
+            writeBits(_lastBits[i], 32);
+        }
+    } else {
+        // Work modulo 2^32 so the series survives millis() rolling over
+        uint32_t delta = reading.time - _lastTime;
+        int32_t  dod   = (int32_t)(delta - _lastDelta);
+        if (dod == 0) {
+            writeBits(0, 1);
+        } else if (dod >= -63 && dod <= 64) {
+            writeBits(0x2, 2);
+            writeBits(dod + 63, 7);
+        } else if (dod >= -255 && dod <= 256) {
+            writeBits(0x6, 3);
+            writeBits(dod + 255, 9);
+        } else if (dod >= -2047 && dod <= 2048) {
+            writeBits(0xE, 4);
+            writeBits(dod + 2047, 12);
+        } else {
+            writeBits(0x1E, 5);
+            writeBits((uint32_t)dod, 32);
+        }
+        _lastDelta = delta;
+
+        if (reading.errorCode == _lastError) {
+            writeBits(0, 1);
+        } else {
+            writeBits(1, 1);
+            writeBits(reading.errorCode, 8);
+        }
+        for (uint8_t i = 0; i < _numValues; i++) { writeValue(i, reading.values[i]); }
+    }
+    _lastTime  = reading.time;
+    _lastError = reading.errorCode;
+    _readings++;
+}
+
+
+void yosemitechSeriesEncoder::end(void) {
+    writeBits(0x1F, 5);
+    if (_bitCount > 0) writeBits(0, 8 - _bitCount);
+}
+
+
+uint32_t yosemitechSeriesEncoder::getBytes(void) {
+    return _bytes;
+}
+
+
+//----------------------------------------------------------------------------
+//                                  DECODER
+//----------------------------------------------------------------------------
+
+yosemitechSeriesDecoder::yosemitechSeriesDecoder(Stream& in)
+    : _in(in),
+      _slaveID(0),
+      _numValues(0),
+      _readings(0),
+      _ended(true),
+      _bitCount(0) {}
+
+
+bool yosemitechSeriesDecoder::begin(void) {
+    byte header[6];
+    _ended = true;
+    if (_in.readBytes(header, 6) != 6 || memcmp(header, "YTS", 3) != 0 ||
+        header[3] != YM_SERIES_VERSION || header[5] > YM_MAX_VALUES) {
+        return false;
+    }
+    _slaveID   = header[4];
+    _numValues = header[5];
+    _readings  = 0;
+    _ended     = false;
+    _lastDelta = 0;
+    _bitCount  = 0;
+    for (uint8_t i = 0; i < YM_MAX_VALUES; i++) { _leading[i] = YM_NO_WINDOW; }
+    return true;
+}
+
+
+// This takes the next bits from the stream, returning false if it runs out
+bool yosemitechSeriesDecoder::readBits(uint8_t count, uint32_t& value) {
+    value = 0;
+    while (count > 0) {
+        if (_bitCount == 0) {
+            int next = _in.read();
+            if (next < 0) return false;
+            _byte     = next;
+            _bitCount = 8;
+        }
+        uint8_t taken = count < _bitCount ? count : _bitCount;
+        _bitCount -= taken;
+        count -= taken;
+        value = (value << taken) | ((_byte >> _bitCount) & ((1 << taken) - 1));
+    }
+    return true;
+}
+
+
+bool yosemitechSeriesDecoder::readValue(uint8_t channel, float& value) {
+    uint32_t code, xord;
+    if (!readBits(1, code)) return false;
+    if (code == 1) {
+        if (!readBits(1, code)) return false;
+        if (code == 1) {
+            uint32_t leading, length;
+            if (!readBits(5, leading) || !readBits(6, length)) return false;
+            _leading[channel]  = leading;
+            _trailing[channel] = 32 - leading - (length + 1);
+        } else if (_leading[channel] == YM_NO_WINDOW) {
+            return false;  // corrupt: there is no window to reuse
+        }
+        uint8_t trailing = _trailing[channel];
+        if (!readBits(32 - _leading[channel] - trailing, xord)) return false;
+        _lastBits[channel] ^= xord << trailing;
+    }
+    value = bitsFloat(_lastBits[channel]);
+    return true;
+}
+
+
+// This stops decoding a series that ends without its end code
+bool yosemitechSeriesDecoder::truncated(void) {
+    _ended = true;
+    return false;
+}
+
+
+bool yosemitechSeriesDecoder::decode(yosemitechReading& reading) {
+    if (_ended) return false;
+    uint32_t bits;
+    reading.slaveID   = _slaveID;
+    reading.numValues = _numValues;
+    for (uint8_t i = _numValues; i < YM_MAX_VALUES; i++) { reading.values[i] = -9999; }
+
+    if (_readings == 0) {
+        if (!readBits(32, _lastTime) || !readBits(8, bits)) return truncated();
+        _lastError = bits;
+        for (uint8_t i = 0; i < _numValues; i++) {
+            if (!readBits(32, _lastBits[i])) return truncated();
+        }
+    } else {
+        // Count the leading 1 bits of the time code, up to 5
+        uint8_t ones = 0;
+        while (ones < 5) {
+            if (!readBits(1, bits)) return truncated();
+            if (bits == 0) break;
+            ones++;
+        }
+        int32_t dod = 0;
+        switch (ones) {
+            case 0: break;
+            case 1:
+                if (!readBits(7, bits)) return truncated();
+                dod = (int32_t)bits - 63;
+                break;
+            case 2:
+                if (!readBits(9, bits)) return truncated();
+                dod = (int32_t)bits - 255;
+                break;
+            case 3:
+                if (!readBits(12, bits)) return truncated();
+                dod = (int32_t)bits - 2047;
+                break;
+            case 4:
+                if (!readBits(32, bits)) return truncated();
+                dod = (int32_t)bits;
+                break;
+            default: _ended = true; return false;  // the end code
+        }
+        _lastDelta += dod;
+        _lastTime += _lastDelta;
+
+        if (!readBits(1, bits)) return truncated();
+        if (bits == 1) {
+            if (!readBits(8, bits)) return truncated();
+            _lastError = bits;
+        }
+        for (uint8_t i = 0; i < _numValues; i++) {
+            float value;
+            if (!readValue(i, value)) return truncated();
+        }
+    }
+
+    reading.time      = _lastTime;
+    reading.errorCode = _lastError;
+    for (uint8_t i = 0; i < _numValues; i++) {
+        reading.values[i] = bitsFloat(_lastBits[i]);
+    }
+    _readings++;
+    return true;
+}
+
+
+byte yosemitechSeriesDecoder::getSlaveID(void) {
+    return _slaveID;
+}
+
+
+uint8_t yosemitechSeriesDecoder::getNumValues(void) {
+    return _numValues;
+}
+
+// cspell: ignore xord
@@ -0,0 +1,166 @@
+/**
+ * @file YosemitechSeriesCodec.h
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the time series encoder and decoder declarations, used to store
+ * readings compactly on a logger's flash or SD card.
+ */
+
+#ifndef YosemitechSeriesCodec_h
+#define YosemitechSeriesCodec_h
+
+#include "YosemitechModbus.h"
+
+/**
+ * @brief Compresses a series of readings from one sensor as they are taken.
+ *
+ * The encoding follows the Gorilla time series format:
+ *
+ * - The first reading is stored in full.
+ * - Each time is stored as the change in the interval since the last reading
+ * (delta-of-delta), which is a single 0 bit for a steady interval.
+ * - The error code is a single 0 bit when it hasn't changed.
+ * - Each value is XORed with the last value of the same channel.  An unchanged
+ * value is a single 0 bit; a changed one stores only the bits between the leading
+ * and trailing zeros of the XOR.
+ *
+ * The encoded series starts with a header of "YTS", the format version, the slave
+ * ID and the number of values in each reading, and ends with an end code.  It is
+ * written to the Print a byte at a time as the bits fill up, so the encoder only
+ * needs a few bytes of RAM for each channel.
+ *
+ * @code{.cpp}
+ * File                    file = SD.open("series.yts", FILE_WRITE);
+ * yosemitechSeriesEncoder encoder(file);
+ * encoder.begin(reading.slaveID, reading.numValues);
+ * // for every reading
+ * encoder.encode(reading);
+ * // when the file is closed
+ * encoder.end();
+ * @endcode
+ */
+class yosemitechSeriesEncoder {
+
+ public:
+    /**
+     * @brief Constructs a new encoder.
+     *
+     * @param out Where to write the encoded series
+     */
+    explicit yosemitechSeriesEncoder(Print& out);
+
+    /**
+     * @brief Starts a new series by writing its header.
+     *
+     * @param slaveID The modbus slave ID of the sensor
+     * @param numValues The number of values in each reading
+     */
+    void begin(byte slaveID, uint8_t numValues);
+
+    /**
+     * @brief Adds a reading to the series.
+     *
+     * @param reading The reading; only the first numValues values are stored
+     */
+    void encode(const yosemitechReading& reading);
+
+    /**
+     * @brief Ends the series, writing the end code and any bits left over.
+     */
+    void end(void);
+
+    /**
+     * @brief Gets the number of bytes written so far, including the header.
+     *
+     * @return *uint32_t* The number of bytes
+     */
+    uint32_t getBytes(void);
+
+ private:
+    void writeBits(uint32_t value, uint8_t count);
+    void writeValue(uint8_t channel, float value);
+
+    Print&   _out;                      ///< Where the series is written
+    uint8_t  _numValues;                ///< Values in each reading
+    uint32_t _readings;                 ///< Readings encoded
+    uint32_t _lastTime;                 ///< The time of the last reading
+    uint32_t _lastDelta;                ///< The interval before the last reading
+    byte     _lastError;                ///< The last error code
+    uint32_t _lastBits[YM_MAX_VALUES];  ///< The last value of each channel
+    uint8_t  _leading[YM_MAX_VALUES];   ///< Leading zeros of each channel's window
+    uint8_t  _trailing[YM_MAX_VALUES];  ///< Trailing zeros of each channel's window
+    uint8_t  _byte;                     ///< Bits waiting to be written
+    uint8_t  _bitCount;                 ///< The number of bits waiting
+    uint32_t _bytes;                    ///< Bytes written
+};
+
+
+/**
+ * @brief Expands a series written by a #yosemitechSeriesEncoder, a reading at a time.
+ *
+ * This works from any Stream, reading only as many bytes as each reading needs, so
+ * it can expand a file of any size on a board or a host.
+ */
+class yosemitechSeriesDecoder {
+
+ public:
+    /**
+     * @brief Constructs a new decoder.
+     *
+     * @param in Where to read the encoded series
+     */
+    explicit yosemitechSeriesDecoder(Stream& in);
+
+    /**
+     * @brief Reads the header of a series.
+     *
+     * @return *bool* True if the stream holds a series, false if not.
+     */
+    bool begin(void);
+
+    /**
+     * @brief Reads the next reading of the series.
+     *
+     * @param reading The reading to fill in
+     * @return *bool* True if there was a reading, false at the end of the series.
+     */
+    bool decode(yosemitechReading& reading);
+
+    /**
+     * @brief Gets the slave ID from the header.
+     *
+     * @return *byte* The modbus slave ID of the sensor
+     */
+    byte getSlaveID(void);
+
+    /**
+     * @brief Gets the number of values in each reading, from the header.
+     *
+     * @return *uint8_t* The number of values
+     */
+    uint8_t getNumValues(void);
+
+ private:
+    bool readBits(uint8_t count, uint32_t& value);
+    bool readValue(uint8_t channel, float& value);
+    bool truncated(void);
+
+    Stream&  _in;                       ///< Where the series is read
+    byte     _slaveID;                  ///< The slave ID from the header
+    uint8_t  _numValues;                ///< Values in each reading
+    uint32_t _readings;                 ///< Readings decoded
+    bool     _ended;                    ///< Whether the end has been reached
+    uint32_t _lastTime;                 ///< The time of the last reading
+    uint32_t _lastDelta;                ///< The interval before the last reading
+    byte     _lastError;                ///< The last error code
+    uint32_t _lastBits[YM_MAX_VALUES];  ///< The last value of each channel
+    uint8_t  _leading[YM_MAX_VALUES];   ///< Leading zeros of each channel's window
+    uint8_t  _trailing[YM_MAX_VALUES];  ///< Trailing zeros of each channel's window
+    uint8_t  _byte;                     ///< The byte being read
+    uint8_t  _bitCount;                 ///< The bits left in it
+};
+
+#endif
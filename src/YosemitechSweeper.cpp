@@ -0,0 +1,216 @@
+/**
+ * @file YosemitechSweeper.cpp
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the register map sweeper definitions.
+ */
+
+#include "YosemitechSweeper.h"
+
+// The version of the map format written by the sweeper
+#define YM_MAP_VERSION 0x01
+
+
+yosemitechSweeper::yosemitechSweeper(yosemitech& sensor)
+    : _sensor(sensor),
+      _readableRegisters(0),
+      _requests(0) {}
+
+
+// This sweeps a range of registers a block at a time from the lowest address up.  A
+// block that can't be read is tried again at half the size, down to the minimum span,
+// and a block that can be read doubles the size of the next one, up to the largest
+// read.  Splitting each refused block down to single registers in both halves would
+// send two requests for every missing register; this way a run of missing registers
+// costs one request each, and a run of readable ones only a few.  Splitting is the
+// retry, so each block is sent once with a short timeout; the sensor's own retries,
+// timeout and learned round trip time are saved and put back at the end, so the
+// sweep's misses don't back off the timeout of the reads that follow it.
+bool yosemitechSweeper::sweep(uint16_t firstRegister, uint16_t lastRegister,
+                              Print& out, uint8_t minSpan) {
+    _readableRegisters = 0;
+    _requests          = 0;
+    if (minSpan < 1) minSpan = 1;
+    if (minSpan > YM_SWEEP_MAX_REGISTERS) minSpan = YM_SWEEP_MAX_REGISTERS;
+
+    // Write the header
+    out.write((const uint8_t*)"YMAP", 4);
+    out.write((uint8_t)YM_MAP_VERSION);
+    out.write(_sensor._slaveID);
+    out.write((uint8_t)_sensor._model);
+
+    uint8_t                 retries  = _sensor._commandRetries;
+    uint32_t                timeout  = _sensor._commandTimeout;
+    bool                    adaptive = _sensor._adaptiveTimeout;
+    yosemitech::rttEstimate rtt      = _sensor._rtt[yosemitech::metadataRead];
+    _sensor._commandRetries          = 0;
+    _sensor._commandTimeout          = YM_SWEEP_TIMEOUT;
+    _sensor._adaptiveTimeout         = false;
+
+    uint32_t next     = firstRegister;  // the first register not yet mapped
+    uint16_t span     = YM_SWEEP_MAX_REGISTERS;
+    bool     finished = true;
+
+    while (next <= lastRegister) {
+        uint32_t left  = lastRegister - next + 1;
+        uint8_t  count = left < span ? left : span;
+        uint16_t start = next;
+
+        _requests++;
+        if (_sensor.readRegisters(start, count)) {
+            out.write((uint8_t)(start >> 8));
+            out.write((uint8_t)(start & 0xFF));
+            out.write(count);
+            out.write(_sensor.modbus.responseBuffer + 3, count * 2);
+            _readableRegisters += count;
+            next += count;
+            span *= 2;
+            if (span > YM_SWEEP_MAX_REGISTERS) span = YM_SWEEP_MAX_REGISTERS;
+        } else if (_sensor.getLastError() == YM_DEADLINE_EXPIRED) {
+            finished = false;
+            break;
+        } else if (count > minSpan) {
+            // Try again with half as many
+            span = count / 2 > minSpan ? count / 2 : minSpan;
+        } else {
+            // This block is unreadable
+            next += count;
+        }
+    }
+
+    _sensor._commandRetries                = retries;
+    _sensor._commandTimeout                = timeout;
+    _sensor._adaptiveTimeout               = adaptive;
+    _sensor._rtt[yosemitech::metadataRead] = rtt;
+
+    // Write the end of the map
+    out.write((uint8_t)0xFF);
+    out.write((uint8_t)0xFF);
+    out.write((uint8_t)0x00);
+    return finished;
+}
+
+
+uint32_t yosemitechSweeper::getReadableRegisters(void) {
+    return _readableRegisters;
+}
+
+
+uint32_t yosemitechSweeper::getRequests(void) {
+    return _requests;
+}
+
+
+// Reads a map one register at a time, without buffering it
+class mapReader {
+
+ public:
+    explicit mapReader(Stream& stream) : _stream(stream), _left(0), _done(false) {}
+
+    // Checks the header and reads the first register, returning false if this isn't
+    // a map
+    bool begin(void) {
+        byte header[7];
+        if (_stream.readBytes(header, 7) != 7 || memcmp(header, "YMAP", 4) != 0 ||
+            header[4] != YM_MAP_VERSION) {
+            _done = true;
+            return false;
+        }
+        advance();
+        return true;
+    }
+
+    // Moves to the next register, returning false at the end of the map
+    bool advance(void) {
+        if (_done) return false;
+        if (_left == 0) {
+            byte blockHeader[3];
+            if (_stream.readBytes(blockHeader, 3) != 3 || blockHeader[2] == 0) {
+                _done = true;
+                return false;
+            }
+            _register = ((uint16_t)blockHeader[0] << 8) | blockHeader[1];
+            _left     = blockHeader[2];
+        } else {
+            _register++;
+        }
+        _left--;
+        if (_stream.readBytes(_value, 2) != 2) {
+            _done = true;
+            return false;
+        }
+        return true;
+    }
+
+    bool done(void) {
+        return _done;
+    }
+    uint16_t reg(void) {
+        return _register;
+    }
+    const byte* value(void) {
+        return _value;
+    }
+
+ private:
+    Stream&  _stream;
+    uint16_t _register;
+    uint8_t  _left;
+    byte     _value[2];
+    bool     _done;
+};
+
+
+// Prints a register address or value in fixed width hexadecimal
+static void printHex(Print& out, uint16_t value, uint8_t digits) {
+    for (int8_t shift = (digits - 1) * 4; shift >= 0; shift -= 4) {
+        out.print((value >> shift) & 0x0F, HEX);
+    }
+}
+
+static void printValue(Print& out, mapReader& map) {
+    printHex(out, ((uint16_t)map.value()[0] << 8) | map.value()[1], 4);
+}
+
+
+// This compares two maps register by register, walking both in order of address
+bool yosemitechSweeper::diff(Stream& before, Stream& after, Print& out) {
+    mapReader a(before);
+    mapReader b(after);
+    if (!a.begin() || !b.begin()) {
+        out.println(F("Not a register map"));
+        return false;
+    }
+    bool same = true;
+    while (!a.done() || !b.done()) {
+        bool     inA = !a.done() && (b.done() || a.reg() <= b.reg());
+        bool     inB = !b.done() && (a.done() || b.reg() <= a.reg());
+        uint16_t reg = inA ? a.reg() : b.reg();
+        if (!(inA && inB && memcmp(a.value(), b.value(), 2) == 0)) {
+            same = false;
+            out.print(F("0x"));
+            printHex(out, reg, 4);
+            out.print(F(": "));
+            if (inA) {
+                printValue(out, a);
+            } else {
+                out.print(F("unreadable"));
+            }
+            out.print(F(" -> "));
+            if (inB) {
+                printValue(out, b);
+            } else {
+                out.print(F("unreadable"));
+            }
+            out.println();
+        }
+        if (inA) a.advance();
+        if (inB) b.advance();
+    }
+    return same;
+}
+
+// cspell: ignore YMAP
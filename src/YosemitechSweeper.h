@@ -0,0 +1,136 @@
+/**
+ * @file YosemitechSweeper.h
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the register map sweeper declarations, used to find out which
+ * registers an undocumented sensor will answer.
+ */
+
+#ifndef YosemitechSweeper_h
+#define YosemitechSweeper_h
+
+#include "YosemitechModbus.h"
+
+/**
+ * @brief The largest number of registers the sweeper asks for at once.
+ *
+ * Modbus allows up to 125, but the response must also fit in the modbusMaster
+ * response buffer.
+ */
+#ifndef YM_SWEEP_MAX_REGISTERS
+#define YM_SWEEP_MAX_REGISTERS \
+    ((RESPONSE_BUFFER_SIZE - 5) / 2 < 125 ? (RESPONSE_BUFFER_SIZE - 5) / 2 : 125)
+#endif
+
+/**
+ * @brief How long in milliseconds the sweeper waits for each block to be answered.
+ *
+ * A sensor answers a read in a few tens of milliseconds, and the sweeper doesn't
+ * retry, so a block that gets no answer in this time is tried again at half the
+ * size.
+ */
+#ifndef YM_SWEEP_TIMEOUT
+#define YM_SWEEP_TIMEOUT 100
+#endif
+
+/**
+ * @brief Maps the readable holding registers of a sensor.
+ *
+ * The sweeper asks for the largest blocks of registers it can, from the lowest
+ * address up.  When a block is refused (with a Modbus exception) or gets no answer,
+ * it is tried again at half the size, until it is down to the minimum span and
+ * marked unreadable; each block that is read doubles the size of the next.  A run of
+ * missing registers costs one request each at a span of 1, and a run of readable
+ * ones a request for every #YM_SWEEP_MAX_REGISTERS of them.  To keep the
+ * time spent on registers that don't answer to a minimum, each block is sent only
+ * once, with a short fixed timeout (#YM_SWEEP_TIMEOUT) in place of the sensor's
+ * retries and learned timeout, which are put back afterwards.  The reads still go
+ * through the yosemitech object, so they fast-fail on exceptions and stop at its
+ * deadline.
+ *
+ * The result is written as a compact binary map, in order of register address:
+ *
+ * | Bytes     | Contents                                                      |
+ * | --------- | ------------------------------------------------------------- |
+ * | 4         | "YMAP"                                                        |
+ * | 1         | map format version (1)                                        |
+ * | 1         | slave ID                                                      |
+ * | 1         | #yosemitechModel                                              |
+ * | then, for every readable block:                                           |
+ * | 2         | first register (high byte first)                              |
+ * | 1         | number of registers, n                                        |
+ * | 2n        | the raw register bytes, exactly as sent by the sensor         |
+ * | and last: |                                                               |
+ * | 3         | 0xFF 0xFF 0x00 - the end of the map                           |
+ *
+ * Two maps can be compared with yosemitechSweeper::diff().
+ *
+ * @note Many Yosemitech sensors don't answer at all for registers that aren't in
+ * their manual, so every missing register costs a timeout.  Sweep the smallest range
+ * that will do, or raise the minimum span.
+ */
+class yosemitechSweeper {
+
+ public:
+    /**
+     * @brief Constructs a new sweeper for a sensor.
+     *
+     * @param sensor The sensor to sweep; it must already be started with begin().
+     */
+    explicit yosemitechSweeper(yosemitech& sensor);
+
+    /**
+     * @brief Sweeps a range of holding registers and writes the map.
+     *
+     * @param firstRegister The first register to sweep
+     * @param lastRegister The last register to sweep (inclusive)
+     * @param out Where to write the binary map (a file, serial port, etc.)
+     * @param minSpan The smallest block to split down to; a refused block this size
+     * or smaller is marked unreadable.  Optional with a default value of 1.
+     * @return *bool* True if the whole range was swept, false if the sweep stopped
+     * early because the sensor's deadline passed.
+     */
+    bool sweep(uint16_t firstRegister, uint16_t lastRegister, Print& out,
+               uint8_t minSpan = 1);
+
+    /**
+     * @brief Gets the number of readable registers found by the last sweep.
+     *
+     * @return *uint32_t* The number of readable registers
+     */
+    uint32_t getReadableRegisters(void);
+
+    /**
+     * @brief Gets the number of read requests sent by the last sweep.
+     *
+     * @return *uint32_t* The number of requests
+     */
+    uint32_t getRequests(void);
+
+    /**
+     * @brief Compares two register maps and prints the differences.
+     *
+     * Each difference is printed on its own line, like:
+     * @code
+     * 0x2600: 1A2B -> 1A2C
+     * 0x3000: 0100 -> unreadable
+     * 0x3400: unreadable -> 0000
+     * @endcode
+     *
+     * @param before The older map
+     * @param after The newer map
+     * @param out Where to print the differences
+     * @return *bool* True if the maps were both valid and the same, false if not.
+     */
+    static bool diff(Stream& before, Stream& after, Print& out);
+
+ private:
+    yosemitech& _sensor;              ///< The sensor being swept
+    uint32_t    _readableRegisters;  ///< Registers read in the last sweep
+    uint32_t    _requests;           ///< Requests sent in the last sweep
+};
+
+#endif
@@ -0,0 +1,229 @@
+/**
+ * @file YosemitechTCPStream.cpp
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the definitions of a Stream on a TCP connection.
+ */
+
+#include "YosemitechTCPStream.h"
+
+#ifdef YM_HOST_BUILD
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Linux asks for no SIGPIPE on each send, macOS on the socket
+#ifdef MSG_NOSIGNAL
+#define YM_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define YM_SEND_FLAGS 0
+#endif
+
+
+yosemitechTCPStream::yosemitechTCPStream(const char* host, uint16_t port)
+    : _host(host),
+      _port(port),
+      _fd(-1),
+      _wanted(false),
+      _reconnectInterval(5000),
+      _lastAttempt(0),
+      _reconnects(0),
+      _outLength(0),
+      _inStart(0),
+      _inEnd(0) {}
+
+yosemitechTCPStream::~yosemitechTCPStream() {
+    end();
+}
+
+
+bool yosemitechTCPStream::begin(void) {
+    end();
+    _wanted     = true;
+    _reconnects = 0;
+    return connectNow();
+}
+
+
+void yosemitechTCPStream::end(void) {
+    _wanted = false;
+    disconnect();
+}
+
+
+bool yosemitechTCPStream::connected(void) {
+    return _fd >= 0;
+}
+
+
+void yosemitechTCPStream::setReconnectInterval(uint32_t interval) {
+    _reconnectInterval = interval;
+}
+
+
+uint32_t yosemitechTCPStream::getReconnects(void) {
+    return _reconnects;
+}
+
+
+// This tries each address of the device server in turn, giving each one
+// YM_TCP_CONNECT_TIMEOUT to answer
+bool yosemitechTCPStream::connectNow(void) {
+    disconnect();
+    _lastAttempt = millis();
+
+    char service[6];
+    snprintf(service, sizeof(service), "%u", _port);
+    struct addrinfo  hints = {};
+    struct addrinfo* found = nullptr;
+    hints.ai_family        = AF_UNSPEC;
+    hints.ai_socktype      = SOCK_STREAM;
+    if (getaddrinfo(_host, service, &hints, &found) != 0) return false;
+
+    for (struct addrinfo* address = found; address != nullptr && _fd < 0;
+         address = address->ai_next) {
+        int fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd < 0) continue;
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        int result = connect(fd, address->ai_addr, address->ai_addrlen);
+        if (result != 0 && errno == EINPROGRESS) {
+            struct pollfd ready = {fd, POLLOUT, 0};
+            int           error = 0;
+            socklen_t     size  = sizeof(error);
+            if (poll(&ready, 1, YM_TCP_CONNECT_TIMEOUT) == 1 &&
+                getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &size) == 0) {
+                result = error == 0 ? 0 : -1;
+            }
+        }
+        if (result == 0) {
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+#ifdef SO_NOSIGPIPE
+            setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+            _fd = fd;
+        } else {
+            close(fd);
+        }
+    }
+    freeaddrinfo(found);
+    return _fd >= 0;
+}
+
+
+void yosemitechTCPStream::disconnect(void) {
+    if (_fd >= 0) close(_fd);
+    _fd        = -1;
+    _outLength = 0;
+    _inStart   = 0;
+    _inEnd     = 0;
+}
+
+
+// This takes whatever has arrived without waiting, and notices a dropped connection
+void yosemitechTCPStream::receive(void) {
+    if (_fd < 0) return;
+    if (_inStart == _inEnd) _inStart = _inEnd = 0;
+    if (_inEnd == sizeof(_in)) {
+        if (_inStart == 0) return;  // full; read some first
+        memmove(_in, _in + _inStart, _inEnd - _inStart);
+        _inEnd -= _inStart;
+        _inStart = 0;
+    }
+    ssize_t got = recv(_fd, _in + _inEnd, sizeof(_in) - _inEnd, 0);
+    if (got > 0) {
+        _inEnd += got;
+    } else if (got == 0 ||
+               (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        disconnect();
+    }
+}
+
+
+// This gives up the processor when nothing has come yet, since the library polls
+// available() in a tight loop while waiting for a response; on a host with one core
+// that spinning would otherwise hold off whatever is answering on the same machine
+int yosemitechTCPStream::available(void) {
+    if (_outLength > 0) flush();
+    receive();
+    if (_inStart == _inEnd) sched_yield();
+    return _inEnd - _inStart;
+}
+
+
+int yosemitechTCPStream::read(void) {
+    if (_inStart == _inEnd && available() == 0) return -1;
+    return _in[_inStart++];
+}
+
+
+int yosemitechTCPStream::peek(void) {
+    if (_inStart == _inEnd && available() == 0) return -1;
+    return _in[_inStart];
+}
+
+
+size_t yosemitechTCPStream::write(uint8_t value) {
+    return write(&value, 1);
+}
+
+
+// This starts a new request, dropping anything left from the last response and
+// reconnecting if the connection has dropped, or adds to the one being written
+size_t yosemitechTCPStream::write(const uint8_t* buffer, size_t size) {
+    if (_outLength == 0) {
+        if (_fd < 0 && _wanted && millis() - _lastAttempt >= _reconnectInterval &&
+            connectNow()) {
+            _reconnects++;
+        }
+        do {
+            _inStart = _inEnd = 0;
+            receive();
+        } while (_inEnd > 0);
+    }
+    if (_fd < 0) return 0;
+    size_t written = 0;
+    while (written < size) {
+        // A request longer than any RTU frame goes out in pieces
+        if (_outLength == sizeof(_out)) flush();
+        size_t room  = sizeof(_out) - _outLength;
+        size_t taken = size - written < room ? size - written : room;
+        memcpy(_out + _outLength, buffer + written, taken);
+        _outLength += taken;
+        written += taken;
+    }
+    return written;
+}
+
+
+void yosemitechTCPStream::flush(void) {
+    uint16_t sent = 0;
+    while (_fd >= 0 && sent < _outLength) {
+        ssize_t result = send(_fd, _out + sent, _outLength - sent, YM_SEND_FLAGS);
+        if (result > 0) {
+            sent += result;
+        } else if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd ready = {_fd, POLLOUT, 0};
+            poll(&ready, 1, 100);
+        } else if (result < 0 && errno != EINTR) {
+            disconnect();
+        }
+    }
+    _outLength = 0;
+}
+
+#endif
+
+// cspell: ignore NOSIGNAL NOSIGPIPE NODELAY KEEPALIVE SETFL EINPROGRESS addrinfo
+// cspell: ignore getaddrinfo freeaddrinfo socktype addrlen
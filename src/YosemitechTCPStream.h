@@ -0,0 +1,133 @@
+/**
+ * @file YosemitechTCPStream.h
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the declarations of a Stream on a TCP connection, for talking to
+ * sensors from a host build through an Ethernet to RS485 device server.
+ */
+
+#ifndef YosemitechTCPStream_h
+#define YosemitechTCPStream_h
+
+#include "YosemitechModbus.h"
+
+#ifdef YM_HOST_BUILD
+
+/**
+ * @brief How long to wait for a device server to accept a connection, in
+ * milliseconds.
+ */
+#ifndef YM_TCP_CONNECT_TIMEOUT
+#define YM_TCP_CONNECT_TIMEOUT 1000
+#endif
+
+/**
+ * @brief A Stream on a raw TCP connection to a serial device server (Modbus RTU over
+ * TCP), used instead of a serial port.
+ *
+ * The RTU frames are sent over the connection exactly as they would be on the
+ * serial line, CRC and all.  To keep the device server from splitting a request
+ * into pieces with gaps between them on the RS485 side, everything written is held
+ * until flush() (or the first read after it) and then sent in one segment, with
+ * Nagle's algorithm turned off so it goes straight away.  Anything left unread from
+ * the last response, like a late answer to a request that timed out, is dropped when
+ * the next request is written, so it can't be mistaken for the new response.
+ *
+ * If the connection drops, the next request reconnects, at most once per reconnect
+ * interval; until then requests simply go unanswered, which the library reports as
+ * #YM_NO_RESPONSE.
+ *
+ * Like a serial bus, several sensors can be begun on one stream and take turns using
+ * the connection; only one request can be in flight on it at a time.
+ *
+ * @code{.cpp}
+ * yosemitechTCPStream server("192.168.1.50", 4001);
+ * yosemitech          sensor1;
+ * yosemitech          sensor2;
+ * server.begin();
+ * sensor1.begin(Y511, 0x01, server);
+ * sensor2.begin(Y4000, 0x05, server);
+ * @endcode
+ */
+class yosemitechTCPStream : public Stream {
+
+ public:
+    /**
+     * @brief Constructs a new TCP stream; it doesn't connect until begin().
+     *
+     * @param host The name or address of the device server
+     * @param port The TCP port of the serial port on the device server
+     */
+    yosemitechTCPStream(const char* host, uint16_t port);
+    ~yosemitechTCPStream();
+    yosemitechTCPStream(const yosemitechTCPStream&)            = delete;
+    yosemitechTCPStream& operator=(const yosemitechTCPStream&) = delete;
+
+    /**
+     * @brief Connects to the device server.
+     *
+     * @return *bool* True if the connection was made, false if not.
+     */
+    bool begin(void);
+    /**
+     * @brief Closes the connection; it won't be reopened until begin() is called.
+     */
+    void end(void);
+    /**
+     * @brief Checks whether the stream is connected.
+     *
+     * @return *bool* True if connected, false if not.
+     */
+    bool connected(void);
+
+    /**
+     * @brief Sets the shortest time between attempts to reconnect after the
+     * connection drops.
+     *
+     * @param interval The time in milliseconds; the default is 5000.
+     */
+    void setReconnectInterval(uint32_t interval);
+    /**
+     * @brief Gets the number of times the connection has been remade since begin().
+     *
+     * @return *uint32_t* The number of reconnections
+     */
+    uint32_t getReconnects(void);
+
+    int    available(void) override;
+    int    read(void) override;
+    int    peek(void) override;
+    size_t write(uint8_t value) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    /**
+     * @brief Sends everything written since the last flush in one TCP segment.
+     */
+    void flush(void) override;
+
+    using Print::write;
+
+ private:
+    bool connectNow(void);
+    void disconnect(void);
+    void receive(void);
+
+    const char* _host;               ///< The name or address of the device server
+    uint16_t    _port;               ///< The TCP port on the device server
+    int         _fd;                 ///< The open connection, or -1
+    bool        _wanted;             ///< True between begin() and end()
+    uint32_t    _reconnectInterval;  ///< The shortest time between reconnections
+    uint32_t    _lastAttempt;        ///< When the last connection attempt was made
+    uint32_t    _reconnects;         ///< Reconnections since begin()
+    byte        _out[256];           ///< The request being written
+    uint16_t    _outLength;          ///< The bytes of it written so far
+    byte        _in[256];            ///< Bytes received and not yet read
+    uint16_t    _inStart;            ///< The next byte of _in to read
+    uint16_t    _inEnd;              ///< The end of the bytes in _in
+};
+
+#endif
+
+#endif
@@ -0,0 +1,115 @@
+/**
+ * @file YosemitechTrace.cpp
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the transaction trace definitions.
+ */
+
+#include "YosemitechTrace.h"
+
+#ifdef YM_TRACE
+
+// The version of the dump format
+#define YM_TRACE_VERSION 0x01
+
+yosemitechTraceRecord yosemitechTrace::_records[YM_TRACE_RECORDS];
+uint16_t              yosemitechTrace::_next  = 0;
+uint32_t              yosemitechTrace::_total = 0;
+
+
+void yosemitechTrace::record(const yosemitechTraceRecord& record) {
+    _records[_next] = record;
+    if (++_next >= YM_TRACE_RECORDS) _next = 0;
+    _total++;
+}
+
+
+// This fills in a record for a transaction that has just ended
+void yosemitechTrace::transaction(uint8_t op, uint8_t slaveID, uint16_t regNum,
+                                  uint8_t length, uint8_t result, uint32_t start) {
+    transaction(op, slaveID, regNum, length, result, start, millis());
+}
+
+
+void yosemitechTrace::transaction(uint8_t op, uint8_t slaveID, uint16_t regNum,
+                                  uint8_t length, uint8_t result, uint32_t start,
+                                  uint32_t end) {
+    yosemitechTraceRecord traced;
+    traced.time    = start;
+    traced.op      = op;
+    traced.slaveID = slaveID;
+    traced.regNum  = regNum;
+    traced.length  = length;
+    traced.result  = result;
+    traced.latency = end - start;
+    record(traced);
+}
+
+
+uint16_t yosemitechTrace::count(void) {
+    return _total < YM_TRACE_RECORDS ? _total : YM_TRACE_RECORDS;
+}
+
+
+uint32_t yosemitechTrace::dropped(void) {
+    return _total - count();
+}
+
+
+// This finds a record counting from the oldest still in the buffer
+bool yosemitechTrace::get(uint16_t index, yosemitechTraceRecord& record) {
+    uint16_t stored = count();
+    if (index >= stored) return false;
+    uint16_t slot = _next + YM_TRACE_RECORDS - stored + index;
+    if (slot >= YM_TRACE_RECORDS) slot -= YM_TRACE_RECORDS;
+    record = _records[slot];
+    return true;
+}
+
+
+// This writes a number little-endian, whatever the byte order of the board
+static size_t writeLE(Print& out, uint32_t value, uint8_t bytes) {
+    size_t written = 0;
+    for (uint8_t i = 0; i < bytes; i++) {
+        written += out.write((uint8_t)(value >> (8 * i)));
+    }
+    return written;
+}
+
+
+// This writes the header and every record, oldest first
+size_t yosemitechTrace::dump(Print& out) {
+    uint16_t stored  = count();
+    size_t   written = out.write((const uint8_t*)"YTRC", 4);
+    written += writeLE(out, YM_TRACE_VERSION, 1);
+    written += writeLE(out, recordSize, 1);
+    written += writeLE(out, stored, 2);
+    written += writeLE(out, dropped(), 4);
+
+    yosemitechTraceRecord record = {};
+    for (uint16_t i = 0; i < stored; i++) {
+        if (!get(i, record)) break;
+        written += writeLE(out, record.time, 4);
+        written += writeLE(out, record.op, 1);
+        written += writeLE(out, record.slaveID, 1);
+        written += writeLE(out, record.regNum, 2);
+        written += writeLE(out, record.length, 1);
+        written += writeLE(out, record.result, 1);
+        written += writeLE(out, record.latency, 2);
+    }
+    clear();
+    return written;
+}
+
+
+void yosemitechTrace::clear(void) {
+    _next  = 0;
+    _total = 0;
+}
+
+#endif
+
+// cspell: ignore YTRC
@@ -0,0 +1,164 @@
+/**
+ * @file YosemitechTrace.h
+ * @copyright Stroud Water Research Center
+ * Part of the EnviroDIY YosemitechModbus library for Arduino.
+ * @license This library is published under the BSD-3 license.
+ * @author Sara Geleskie Damiano <sdamiano@stroudcenter.org>
+ *
+ * @brief Contains the transaction trace declarations, a compact binary alternative
+ * to the modbusMaster's text debugging stream.
+ *
+ * Tracing is only built when `YM_TRACE` is defined for the whole build (for example
+ * with `build_flags = -D YM_TRACE` in PlatformIO).  Without it this header declares
+ * nothing and the trace points in the library compile away to nothing.
+ */
+
+#ifndef YosemitechTrace_h
+#define YosemitechTrace_h
+
+#include <Arduino.h>
+
+#ifdef YM_TRACE
+
+/**
+ * @brief The number of transactions kept in the trace buffer.
+ *
+ * Each takes 12 bytes of RAM.  Once the buffer is full the oldest transactions are
+ * overwritten.
+ */
+#ifndef YM_TRACE_RECORDS
+#define YM_TRACE_RECORDS 32
+#endif
+
+/**
+ * @brief One traced transaction.
+ */
+typedef struct yosemitechTraceRecord {
+    uint32_t time;     ///< The value of millis() when the transaction started
+    uint8_t  op;       ///< The modbus function code (0x03, 0x10, ...)
+    uint8_t  slaveID;  ///< The slave ID the command was sent to
+    uint16_t regNum;   ///< The first register
+    uint8_t  length;   ///< The number of registers
+    uint8_t  result;   ///< The #yosemitechError the transaction ended with
+    uint16_t latency;  ///< The time until the response, or the timeout, in ms
+} yosemitechTraceRecord;
+
+/**
+ * @brief A RAM ring buffer of the most recent transactions with all sensors.
+ *
+ * Recording a transaction only copies 12 bytes, so tracing can stay on in the field
+ * without changing the bus timing the way a text debugging stream does.  Dump the
+ * buffer whenever it is convenient and turn it into a readable log with the
+ * TraceDecoder utility.
+ *
+ * The dump is written as:
+ *
+ * | Bytes | Contents                                                   |
+ * | ----- | ---------------------------------------------------------- |
+ * | 4     | "YTRC"                                                     |
+ * | 1     | trace format version (1)                                   |
+ * | 1     | record size (12)                                           |
+ * | 2     | number of records, n                                       |
+ * | 4     | number of older records that were overwritten              |
+ * | 12n   | the records, oldest first, in the order of the struct      |
+ *
+ * All numbers are little-endian.
+ */
+class yosemitechTrace {
+
+ public:
+    /**
+     * @brief The size of one record in a dump, in bytes.
+     */
+    static const uint8_t recordSize = 12;
+
+    /**
+     * @brief Adds a transaction to the buffer, overwriting the oldest if it is full.
+     *
+     * @param record The transaction
+     */
+    static void record(const yosemitechTraceRecord& record);
+
+    /**
+     * @brief Adds a transaction that started at a given time and has just ended.
+     *
+     * @param op The modbus function code
+     * @param slaveID The slave ID the command was sent to
+     * @param regNum The first register
+     * @param length The number of registers
+     * @param result The #yosemitechError the transaction ended with
+     * @param start The value of millis() when the transaction started
+     */
+    static void transaction(uint8_t op, uint8_t slaveID, uint16_t regNum,
+                            uint8_t length, uint8_t result, uint32_t start);
+    /**
+     * @brief Adds a transaction that started and ended at given times, for a sensor
+     * keeping time with a clock other than millis().
+     *
+     * @param op The modbus function code
+     * @param slaveID The slave ID the command was sent to
+     * @param regNum The first register
+     * @param length The number of registers
+     * @param result The #yosemitechError the transaction ended with
+     * @param start The time in milliseconds when the transaction started
+     * @param end The time in milliseconds when it ended
+     */
+    static void transaction(uint8_t op, uint8_t slaveID, uint16_t regNum,
+                            uint8_t length, uint8_t result, uint32_t start,
+                            uint32_t end);
+
+    /**
+     * @brief Gets the number of transactions in the buffer.
+     *
+     * @return *uint16_t* The number of transactions
+     */
+    static uint16_t count(void);
+
+    /**
+     * @brief Gets the number of transactions that were overwritten before being
+     * dumped.
+     *
+     * @return *uint32_t* The number of lost transactions
+     */
+    static uint32_t dropped(void);
+
+    /**
+     * @brief Gets one transaction from the buffer.
+     *
+     * @param index The transaction to get, 0 being the oldest
+     * @param record The record to fill in
+     * @return *bool* True if there was a transaction at that index, false if not.
+     */
+    static bool get(uint16_t index, yosemitechTraceRecord& record);
+
+    /**
+     * @brief Writes the buffer, in binary, and empties it.
+     *
+     * @param out Where to write the trace (a serial port, a file, etc.)
+     * @return *size_t* The number of bytes written
+     */
+    static size_t dump(Print& out);
+
+    /**
+     * @brief Empties the buffer.
+     */
+    static void clear(void);
+
+ private:
+    static yosemitechTraceRecord _records[YM_TRACE_RECORDS];  ///< The ring buffer
+    static uint16_t              _next;   ///< Where the next record goes
+    static uint32_t              _total;  ///< Records added since the last clear
+};
+
+/**
+ * @brief Records a transaction in the trace buffer.
+ */
+#define YM_TRACE_TRANSACTION(...) yosemitechTrace::transaction(__VA_ARGS__)
+
+#else
+
+#define YM_TRACE_TRANSACTION(...)
+
+#endif
+
+#endif